@@ -0,0 +1,439 @@
+// Benchmarks for the game's hot paths, with a regression gate.
+//
+//   Benchmark [--runs N] [--only name] [--save [file]] [--compare [file]]
+//             [--alpha p] [--threshold percent]
+//
+// Times turns of a large kingdom and of a world of small ones, battles,
+// market price updates, random draws and saving and loading, one sample per
+// run. With --save the samples become the baseline; with --compare they are
+// checked against it with a one-sided Mann-Whitney test, and a benchmark has
+// regressed when it is slower with significance alpha (default 0.01) and its
+// median has slowed by more than the threshold (default 5%). Baselines
+// default to benchmarks/<host name>.baseline, since timings from different
+// machines cannot be compared. When both are given the baseline is only
+// replaced if nothing regressed.
+//
+// Exits with 0 when everything is within bounds, 1 on a regression and 2
+// when it could not run or a benchmark has no baseline to compare with.
+#include "Stronghold.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <ctime>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <functional>
+#include <filesystem>
+#include <unistd.h>
+
+using namespace std;
+
+// Every sample starts from the same seed so each run does the same work
+const unsigned int BENCHMARK_SEED = 2024;
+const char* const BASELINE_HEADER = "# Stronghold benchmark baseline";
+
+struct BenchmarkCase {
+    const char* name;
+    long long operations;                        // per sample
+    function<double(long long)> sample;          // nanoseconds for that many operations
+};
+
+template<typename Work>
+double timeNanos(Work work) {
+    auto start = chrono::steady_clock::now();
+    work();
+    return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+}
+
+// A kingdom of a hundred provinces with buildings going up in each
+unique_ptr<Kingdom> buildRealm() {
+    seedGameRandom(BENCHMARK_SEED);
+    auto kingdom = make_unique<Kingdom>("Benchmark");
+    kingdom->getPopulation() = Population(200000);
+    for (int i = 0; i < 100; i++) {
+        kingdom->foundProvince("Province " + to_string(i + 1), 1000);
+    }
+    const char* structures[] = { "farm", "sawmill", "quarry", "mine", "smithy" };
+    for (size_t location = 0; location <= kingdom->getProvinceCount(); location++) {
+        for (const char* structure : structures) {
+            kingdom->getResource("wood")->setQuantity(1000);
+            kingdom->getResource("stone")->setQuantity(500);
+            kingdom->getResource("gold")->setQuantity(100);
+            kingdom->buildStructure(structure, location);
+        }
+    }
+    return kingdom;
+}
+
+// Five hundred small kingdoms of four provinces each
+unique_ptr<World> buildWorld(bool staged) {
+    seedGameRandom(BENCHMARK_SEED);
+    auto world = make_unique<World>(staged);
+    for (int i = 0; i < 500; i++) {
+        Kingdom& kingdom = world->addKingdom("Kingdom " + to_string(i + 1));
+        kingdom.getPopulation() = Population(10000);
+        for (int p = 0; p < 4; p++) {
+            kingdom.foundProvince("Province " + to_string(p + 1), 1000);
+        }
+    }
+    return world;
+}
+
+vector<BenchmarkCase> makeBenchmarks(const string& savePath) {
+    vector<BenchmarkCase> benchmarks;
+
+    benchmarks.push_back({ "kingdom_update", 500, [](long long turns) {
+        auto kingdom = buildRealm();
+        return timeNanos([&] {
+            for (long long i = 0; i < turns; i++) {
+                kingdom->processTurn();
+            }
+        });
+    } });
+
+    for (bool staged : { false, true }) {
+        benchmarks.push_back({ staged ? "world_staged" : "world_sequential", 20, [staged](long long turns) {
+            auto world = buildWorld(staged);
+            return timeNanos([&] {
+                for (long long i = 0; i < turns; i++) {
+                    world->processTurn();
+                }
+            });
+        } });
+    }
+
+    benchmarks.push_back({ "army_battle", 2000000, [](long long battles) {
+        int victories = 0;
+        double nanos = timeNanos([&] {
+            for (long long i = 0; i < battles; i++) {
+                Army attackers(1000);
+                Army defenders(900);
+                CounterRandom random(BENCHMARK_SEED, 0, static_cast<uint32_t>(i), RandomSlot::BATTLE);
+                if (attackers.battle(defenders, random)) victories++;
+            }
+        });
+        if (victories < 0) cerr << victories;     // keeps the battles from being optimised away
+        return nanos;
+    } });
+
+    benchmarks.push_back({ "market_update", 400000, [](long long updates) {
+        Market market;
+        return timeNanos([&] {
+            for (long long i = 0; i < updates; i++) {
+                CounterRandom random(BENCHMARK_SEED, 0, static_cast<uint32_t>(i), RandomSlot::MARKET);
+                market.updatePrices(random);
+            }
+        });
+    } });
+
+    // A turn's market draws for every kingdom of a world, one stream at a
+    // time and as one batch
+    for (bool batched : { false, true }) {
+        benchmarks.push_back({ batched ? "random_batch" : "random_scalar", 2000, [batched](long long turns) {
+            auto world = buildWorld(true);
+            vector<Kingdom*> kingdoms;
+            for (size_t k = 0; k < world->getKingdomCount(); k++) {
+                kingdoms.push_back(&world->getKingdom(k));
+            }
+            const size_t drawsPerKingdom = Market().getPriceCount();
+            RandomBatch batch;
+            uint32_t total = 0;
+            double nanos = timeNanos([&] {
+                for (long long i = 0; i < turns; i++) {
+                    if (batched) {
+                        batch.generate(kingdoms, RandomSlot::MARKET, drawsPerKingdom);
+                        const uint32_t* draws = batch.getDraws(0);
+                        for (size_t n = 0; n < kingdoms.size() * drawsPerKingdom; n++) total += draws[n];
+                        continue;
+                    }
+                    for (Kingdom* kingdom : kingdoms) {
+                        CounterRandom random = kingdom->getRandom(RandomSlot::MARKET, kingdom->getCurrentTurn());
+                        for (size_t n = 0; n < drawsPerKingdom; n++) total += random();
+                    }
+                }
+            });
+            if (total == 1) cerr << total;      // keeps the draws from being optimised away
+            return nanos;
+        } });
+    }
+
+    benchmarks.push_back({ "save", 500, [](long long saves) {
+        auto kingdom = buildRealm();
+        string buffer;
+        size_t written = 0;
+        double nanos = timeNanos([&] {
+            for (long long i = 0; i < saves; i++) {
+                buffer.clear();
+                kingdom->writeSaveData(buffer);
+                written += buffer.size();
+            }
+        });
+        if (written == 0) cerr << "Nothing was saved" << endl;
+        return nanos;
+    } });
+
+    benchmarks.push_back({ "load", 300, [savePath](long long loads) {
+        buildRealm()->saveGameState(savePath);
+        Kingdom kingdom("Loaded");
+        return timeNanos([&] {
+            for (long long i = 0; i < loads; i++) {
+                kingdom.loadGameState(savePath);
+            }
+        });
+    } });
+
+    return benchmarks;
+}
+
+double median(vector<double> samples) {
+    sort(samples.begin(), samples.end());
+    size_t middle = samples.size() / 2;
+    return samples.size() % 2 ? samples[middle] : (samples[middle - 1] + samples[middle]) / 2.0;
+}
+
+// One-sided Mann-Whitney U test of whether the current samples tend to be
+// larger than the baseline ones, using the normal approximation with
+// corrections for ties and continuity. Returns the p-value.
+double mannWhitneyGreater(const vector<double>& baseline, const vector<double>& current) {
+    vector<pair<double, bool>> pooled;
+    for (double value : baseline) pooled.emplace_back(value, false);
+    for (double value : current) pooled.emplace_back(value, true);
+    sort(pooled.begin(), pooled.end());
+
+    double n1 = static_cast<double>(baseline.size());
+    double n2 = static_cast<double>(current.size());
+    double n = n1 + n2;
+    double currentRanks = 0.0;
+    double tieTerm = 0.0;
+    for (size_t i = 0; i < pooled.size();) {
+        size_t end = i;
+        while (end < pooled.size() && pooled[end].first == pooled[i].first) end++;
+        double rank = (i + 1 + end) / 2.0;      // average of ranks i+1..end
+        for (size_t j = i; j < end; j++) {
+            if (pooled[j].second) currentRanks += rank;
+        }
+        double tied = static_cast<double>(end - i);
+        tieTerm += tied * tied * tied - tied;
+        i = end;
+    }
+
+    double u = currentRanks - n2 * (n2 + 1) / 2.0;
+    double mean = n1 * n2 / 2.0;
+    double variance = n1 * n2 / 12.0 * ((n + 1) - tieTerm / (n * (n - 1)));
+    if (variance <= 0.0) {
+        return u > mean ? 0.0 : 1.0;
+    }
+    double z = (u - mean - 0.5) / sqrt(variance);
+    return 0.5 * erfc(z / sqrt(2.0));
+}
+
+string defaultBaselinePath() {
+    char host[256] = "localhost";
+    gethostname(host, sizeof(host) - 1);
+    return string("benchmarks/") + host + ".baseline";
+}
+
+bool readBaseline(const string& path, map<string, vector<double>>& baseline) {
+    ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    string line;
+    while (getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        istringstream fields(line);
+        string name;
+        fields >> name;
+        double value;
+        while (fields >> value) {
+            baseline[name].push_back(value);
+        }
+    }
+    return true;
+}
+
+bool writeBaseline(const string& path, const map<string, vector<double>>& results) {
+    filesystem::path target(path);
+    if (target.has_parent_path()) {
+        error_code ignored;
+        filesystem::create_directories(target.parent_path(), ignored);
+    }
+    ofstream file(path);
+    if (!file) {
+        return false;
+    }
+    char host[256] = "localhost";
+    gethostname(host, sizeof(host) - 1);
+    time_t now = time(nullptr);
+    char date[32];
+    strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime(&now));
+
+    file << BASELINE_HEADER << ": nanoseconds per operation, one sample per run\n";
+    file << "# host " << host << ", " << date << "\n";
+    file << fixed << setprecision(1);
+    for (const auto& entry : results) {
+        file << entry.first;
+        for (double value : entry.second) file << ' ' << value;
+        file << '\n';
+    }
+    return static_cast<bool>(file);
+}
+
+void usage() {
+    cerr << "Usage: Benchmark [--runs N] [--only name] [--save [file]] [--compare [file]]"
+        " [--alpha p] [--threshold percent]" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    int runs = 15;
+    double alpha = 0.01;
+    double threshold = 5.0;
+    string only;
+    string savePath;
+    string comparePath;
+    bool save = false;
+    bool compare = false;
+
+    for (int i = 1; i < argc; i++) {
+        string option = argv[i];
+        bool hasValue = i + 1 < argc && string(argv[i + 1]).compare(0, 2, "--") != 0;
+        if (option == "--save" || option == "--compare") {
+            string path = hasValue ? argv[++i] : defaultBaselinePath();
+            (option == "--save" ? save : compare) = true;
+            (option == "--save" ? savePath : comparePath) = path;
+        }
+        else if (hasValue && option == "--runs") {
+            runs = atoi(argv[++i]);
+        }
+        else if (hasValue && option == "--only") {
+            only = argv[++i];
+        }
+        else if (hasValue && option == "--alpha") {
+            alpha = atof(argv[++i]);
+        }
+        else if (hasValue && option == "--threshold") {
+            threshold = atof(argv[++i]);
+        }
+        else {
+            usage();
+            return 2;
+        }
+    }
+    if (runs < 3 || alpha <= 0.0 || alpha >= 1.0 || threshold < 0.0) {
+        cerr << "Need at least 3 runs, an alpha between 0 and 1 and a threshold of at least 0" << endl;
+        return 2;
+    }
+
+    map<string, vector<double>> baseline;
+    if (compare && !readBaseline(comparePath, baseline)) {
+        cerr << "Could not read the baseline " << comparePath << endl;
+        return 2;
+    }
+
+    setHeadless(true);
+    string scratchSave = (filesystem::temp_directory_path() /
+        ("stronghold-benchmark-" + to_string(getpid()) + ".sav")).string();
+    vector<BenchmarkCase> benchmarks = makeBenchmarks(scratchSave);
+    if (!only.empty()) {
+        benchmarks.erase(remove_if(benchmarks.begin(), benchmarks.end(),
+            [&](const BenchmarkCase& benchmark) { return only != benchmark.name; }), benchmarks.end());
+        if (benchmarks.empty()) {
+            cerr << "No benchmark called " << only << endl;
+            return 2;
+        }
+    }
+
+    // One warm-up sample each, then the runs interleaved so that anything
+    // else happening on the machine affects every benchmark alike
+    map<string, vector<double>> results;
+    try {
+        for (BenchmarkCase& benchmark : benchmarks) {
+            benchmark.sample(benchmark.operations);
+        }
+        for (int run = 0; run < runs; run++) {
+            cerr << "\rRun " << (run + 1) << " of " << runs << flush;
+            for (BenchmarkCase& benchmark : benchmarks) {
+                results[benchmark.name].push_back(benchmark.sample(benchmark.operations) / benchmark.operations);
+            }
+        }
+        cerr << endl;
+    }
+    catch (const exception& e) {
+        cerr << endl << "Benchmark failed: " << e.what() << endl;
+        remove(scratchSave.c_str());
+        return 2;
+    }
+    remove(scratchSave.c_str());
+
+    bool regressed = false;
+    bool unbaselined = false;
+    cout << left << setw(16) << "benchmark" << right << setw(16) << "median ns/op";
+    if (compare) {
+        cout << setw(16) << "baseline" << setw(10) << "change" << setw(10) << "p" << "  verdict";
+    }
+    cout << "\n";
+    for (const BenchmarkCase& benchmark : benchmarks) {
+        const vector<double>& current = results[benchmark.name];
+        double currentMedian = median(current);
+        cout << left << setw(16) << benchmark.name << right << fixed << setprecision(1) << setw(16) << currentMedian;
+        if (compare) {
+            auto found = baseline.find(benchmark.name);
+            if (found == baseline.end() || found->second.size() < 3) {
+                cout << setw(16) << "-" << setw(10) << "-" << setw(10) << "-" << "  NO BASELINE";
+                unbaselined = true;
+            }
+            else {
+                double baselineMedian = median(found->second);
+                double change = (currentMedian / baselineMedian - 1.0) * 100.0;
+                double slower = mannWhitneyGreater(found->second, current);
+                double faster = mannWhitneyGreater(current, found->second);
+                const char* verdict = "ok";
+                if (slower < alpha && change > threshold) {
+                    verdict = "REGRESSION";
+                    regressed = true;
+                }
+                else if (faster < alpha && -change > threshold) {
+                    verdict = "faster";
+                }
+                cout << setw(16) << baselineMedian << setw(9) << showpos << change << noshowpos << "%"
+                    << setw(10) << setprecision(4) << min(slower, faster) << "  " << verdict;
+            }
+        }
+        cout << "\n";
+    }
+
+    if (save) {
+        // Benchmarks left out with --only keep their old samples
+        map<string, vector<double>> saved;
+        readBaseline(savePath, saved);
+        for (auto& entry : results) {
+            saved[entry.first] = entry.second;
+        }
+        results.swap(saved);
+        if (regressed) {
+            cerr << "Not replacing the baseline " << savePath << " with a regressed run" << endl;
+        }
+        else if (!writeBaseline(savePath, results)) {
+            cerr << "Could not write the baseline " << savePath << endl;
+            return 2;
+        }
+        else {
+            cerr << "Saved the baseline " << savePath << endl;
+        }
+    }
+
+    // A benchmark missing from the baseline went unchecked, which must not
+    // pass the gate
+    if (unbaselined) {
+        cerr << "Some benchmarks have no baseline in " << comparePath << endl;
+        return 2;
+    }
+    return regressed ? 1 : 0;
+}
\ No newline at end of file
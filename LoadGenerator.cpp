@@ -0,0 +1,224 @@
+// Load generator for the Stronghold game server.
+//
+//   LoadGenerator [port | socket path] [sessions] [commands per session] [turn every N commands] [pause ms]
+//
+// Opens the given number of sessions, founds a kingdom in each and then keeps
+// at most one command in flight per session, sending STATUS with a TURN every
+// N commands. Each session waits the pause between a reply and its next
+// command, with session starts spread over one pause so they do not all fire
+// at once; with no pause the server runs saturated. Reports throughput and
+// the latency of every reply.
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <queue>
+#include <utility>
+#include <functional>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+using namespace std;
+
+struct ClientSession {
+    int fd = -1;
+    int sent = 0;
+    bool founded = false;
+    string input;
+    chrono::steady_clock::time_point sentAt;
+};
+
+int connectTo(const string& address) {
+    int fd;
+    int result;
+    if (address.find_first_not_of("0123456789") == string::npos) {
+        sockaddr_in target{};
+        target.sin_family = AF_INET;
+        target.sin_port = htons(static_cast<uint16_t>(atoi(address.c_str())));
+        target.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        result = fd < 0 ? -1 : connect(fd, reinterpret_cast<sockaddr*>(&target), sizeof(target));
+        int noDelay = 1;
+        if (result == 0) {
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        }
+    }
+    else {
+        sockaddr_un target{};
+        target.sun_family = AF_UNIX;
+        strncpy(target.sun_path, address.c_str(), sizeof(target.sun_path) - 1);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        result = fd < 0 ? -1 : connect(fd, reinterpret_cast<sockaddr*>(&target), sizeof(target));
+    }
+    if (result != 0) {
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool sendLine(ClientSession& session, const string& line) {
+    string message = line + "\n";
+    size_t offset = 0;
+    while (offset < message.size()) {
+        ssize_t written = send(session.fd, message.data() + offset, message.size() - offset, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        offset += static_cast<size_t>(written);
+    }
+    session.sentAt = chrono::steady_clock::now();
+    return true;
+}
+
+double percentile(const vector<double>& sorted, double fraction) {
+    if (sorted.empty()) return 0.0;
+    size_t index = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+    return sorted[index];
+}
+
+int main(int argc, char* argv[]) {
+    string address = argc > 1 ? argv[1] : "7777";
+    int sessionCount = argc > 2 ? max(1, atoi(argv[2])) : 1000;
+    int commandsPerSession = argc > 3 ? max(1, atoi(argv[3])) : 100;
+    int turnEvery = argc > 4 ? max(1, atoi(argv[4])) : 10;
+    chrono::microseconds pause(argc > 5 ? max(0, atoi(argv[5])) * 1000 : 0);
+
+    // Thousands of sessions need more descriptors than the usual soft limit
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    int epollFd = epoll_create1(0);
+    vector<ClientSession> sessions(sessionCount);
+    for (int i = 0; i < sessionCount; i++) {
+        sessions[i].fd = connectTo(address);
+        if (sessions[i].fd < 0) {
+            cerr << "Could not open session " << i << ": " << strerror(errno) << endl;
+            return 1;
+        }
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u32 = static_cast<uint32_t>(i);
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, sessions[i].fd, &event);
+    }
+
+    vector<double> latencies;
+    latencies.reserve(static_cast<size_t>(sessionCount) * (commandsPerSession + 1));
+    long long errors = 0;
+    int finished = 0;
+
+    // Sessions waiting to send their next command, earliest first. A
+    // session that has not sent anything yet starts by founding its kingdom.
+    using Wakeup = pair<chrono::steady_clock::time_point, int>;
+    priority_queue<Wakeup, vector<Wakeup>, greater<Wakeup>> paused;
+    auto sendNext = [&](int index) {
+        ClientSession& session = sessions[index];
+        bool sent;
+        if (!session.founded) {
+            session.founded = true;
+            sent = sendLine(session, "NEW Load" + to_string(index));
+        }
+        else {
+            session.sent++;
+            sent = sendLine(session, session.sent % turnEvery == 0 ? "TURN" : "STATUS");
+        }
+        if (!sent) {
+            cerr << "Session " << index << " could not send: " << strerror(errno) << endl;
+            exit(1);
+        }
+    };
+
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < sessionCount; i++) {
+        paused.emplace(start + pause * i / sessionCount, i);
+    }
+
+    vector<epoll_event> events(1024);
+    char buffer[16 * 1024];
+    while (finished < sessionCount) {
+        auto now = chrono::steady_clock::now();
+        while (!paused.empty() && paused.top().first <= now) {
+            sendNext(paused.top().second);
+            paused.pop();
+        }
+        int timeout = 5000;
+        if (!paused.empty()) {
+            auto wait = chrono::duration_cast<chrono::milliseconds>(paused.top().first - now);
+            timeout = static_cast<int>(wait.count()) + 1;
+        }
+
+        int count = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), timeout);
+        if (count == 0 && !paused.empty()) {
+            continue;
+        }
+        if (count == 0) {
+            cerr << "Timed out waiting for replies" << endl;
+            return 1;
+        }
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            cerr << "epoll_wait failed: " << strerror(errno) << endl;
+            return 1;
+        }
+
+        for (int e = 0; e < count; e++) {
+            int index = static_cast<int>(events[e].data.u32);
+            ClientSession& session = sessions[index];
+            ssize_t received = recv(session.fd, buffer, sizeof(buffer), 0);
+            if (received <= 0) {
+                cerr << "Server closed a session early" << endl;
+                return 1;
+            }
+            session.input.append(buffer, static_cast<size_t>(received));
+
+            size_t newline;
+            while ((newline = session.input.find('\n')) != string::npos) {
+                auto now = chrono::steady_clock::now();
+                latencies.push_back(chrono::duration<double, micro>(now - session.sentAt).count());
+                if (session.input.compare(0, 3, "ERR") == 0) {
+                    errors++;
+                }
+                session.input.erase(0, newline + 1);
+
+                if (session.sent == commandsPerSession) {
+                    epoll_ctl(epollFd, EPOLL_CTL_DEL, session.fd, nullptr);
+                    close(session.fd);
+                    finished++;
+                    break;
+                }
+                if (pause.count() > 0) {
+                    paused.emplace(now + pause, index);
+                }
+                else {
+                    sendNext(index);
+                }
+            }
+        }
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    close(epollFd);
+
+    sort(latencies.begin(), latencies.end());
+    cout << "Sessions: " << sessionCount << "\n";
+    cout << "Commands: " << latencies.size() << " (" << errors << " errors)\n";
+    cout << "Throughput: " << static_cast<long long>(latencies.size() / seconds) << " commands/s\n";
+    cout << "Latency (us): p50 " << percentile(latencies, 0.50)
+        << ", p90 " << percentile(latencies, 0.90)
+        << ", p99 " << percentile(latencies, 0.99)
+        << ", max " << (latencies.empty() ? 0.0 : latencies.back()) << "\n";
+    return errors == 0 ? 0 : 2;
+}
\ No newline at end of file
@@ -0,0 +1,137 @@
+// Status monitor for a Stronghold game started with --export.
+//
+//   StatusMonitor [segment name] [interval ms] [samples]
+//
+// Maps the game's shared status segment read-only and prints a line each
+// time a new status has been published, checking at the given interval
+// (0 polls continuously). Reading the status is plain memory loads, so the
+// game is never interrupted; the monitor waits for the game to start and
+// follows it when it restarts. Stops after the given number of samples,
+// or runs until interrupted when 0.
+#include "Stronghold.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Maps the segment once the game has finished setting it up
+const SharedStatusSegment* openSegment(const string& name) {
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(SharedStatusSegment)) {
+        close(fd);
+        return nullptr;
+    }
+    void* mapping = mmap(nullptr, sizeof(SharedStatusSegment), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return nullptr;
+    }
+
+    const SharedStatusSegment* segment = static_cast<const SharedStatusSegment*>(mapping);
+    if (segment->state.load(memory_order_acquire) != SharedStatusSegment::LIVE) {
+        munmap(mapping, sizeof(SharedStatusSegment));
+        return nullptr;
+    }
+    if (memcmp(segment->magic, SHARED_STATUS_MAGIC, sizeof(segment->magic)) != 0 ||
+        segment->layoutVersion != SHARED_STATUS_VERSION ||
+        segment->recordSize != sizeof(SharedStatusRecord)) {
+        cerr << name << " has status layout version " << segment->layoutVersion
+            << ", this monitor reads version " << SHARED_STATUS_VERSION << endl;
+        exit(1);
+    }
+    return segment;
+}
+
+void printRecord(const SharedStatusRecord& record, double turnsPerSecond) {
+    long long ageMicros = (chrono::duration_cast<chrono::nanoseconds>(
+        chrono::system_clock::now().time_since_epoch()).count() - record.publishedAtNanos) / 1000;
+    cout << record.kingdomName << " turn " << record.turn
+        << ": population " << record.population
+        << ", happiness " << fixed << setprecision(1) << record.happiness
+        << ", treasury " << setprecision(0) << record.treasury
+        << ", army " << record.armySize
+        << ", provinces " << record.provinces
+        << ", stability " << record.stability << "%";
+    for (int i = 0; i < record.resourceCount && i < SharedStatusRecord::MAX_RESOURCES; i++) {
+        cout << ", " << record.resources[i].name << " " << record.resources[i].quantity;
+    }
+    if (record.plague) cout << ", plague " << record.plagueInfectedPercent << "%";
+    if (record.atWar) cout << ", at war";
+    if (record.gameOver) cout << ", GAME OVER";
+    cout << " (" << setprecision(1) << turnsPerSecond << " turns/s, " << ageMicros << " us old)" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    string name = argc > 1 ? argv[1] : "/stronghold-status";
+    chrono::milliseconds interval(argc > 2 ? max(0, atoi(argv[2])) : 1000);
+    long long samples = argc > 3 ? max(0, atoi(argv[3])) : 0;
+
+    const SharedStatusSegment* segment = nullptr;
+    bool waiting = false;
+    uint64_t lastVersion = 0;
+    SharedStatusRecord previous{};
+    long long printed = 0;
+    long long polls = 0;
+    auto started = chrono::steady_clock::now();
+
+    while (samples == 0 || printed < samples) {
+        if (!segment) {
+            segment = openSegment(name);
+            if (!segment) {
+                if (!waiting) {
+                    cerr << "Waiting for a game to publish " << name << "..." << endl;
+                    waiting = true;
+                }
+                this_thread::sleep_for(chrono::milliseconds(200));
+                continue;
+            }
+            waiting = false;
+            lastVersion = 0;
+            previous = SharedStatusRecord{};
+            cerr << "Watching " << name << " (game process " << segment->writerPid << ")" << endl;
+        }
+
+        // The game has gone; look for the next one
+        if (segment->state.load(memory_order_acquire) == SharedStatusSegment::CLOSED) {
+            cerr << "The game closed " << name << endl;
+            munmap(const_cast<SharedStatusSegment*>(segment), sizeof(SharedStatusSegment));
+            segment = nullptr;
+            continue;
+        }
+
+        polls++;
+        uint64_t version = segment->status.getVersion();
+        SharedStatusRecord record;
+        if (version != lastVersion && segment->status.tryRead(record)) {
+            lastVersion = version;
+            double turnsPerSecond = 0.0;
+            if (previous.updates > 0 && record.publishedAtNanos > previous.publishedAtNanos) {
+                turnsPerSecond = (record.turn - previous.turn) * 1e9 / (record.publishedAtNanos - previous.publishedAtNanos);
+            }
+            printRecord(record, turnsPerSecond);
+            previous = record;
+            printed++;
+        }
+        if (interval.count() > 0) {
+            this_thread::sleep_for(interval);
+        }
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    cerr << polls << " polls in " << setprecision(2) << seconds << " s" << endl;
+    return 0;
+}
\ No newline at end of file
@@ -1,1293 +1,6585 @@
-﻿#include "Stronghold.h"
-#include <iostream>
-#include <cstdlib>
-#include <ctime>
-#include <algorithm>
-#include <fstream>
-#include <sstream>  // Add this line to include the string stream functionality
-
-#ifdef _HAS_CXX17
-#include <filesystem>
-#endif
-
-using namespace std;
-
-// Population Implementation
-Population::Population(int initialPopulation) :
-    totalPopulation(initialPopulation),
-    happiness(50.0),
-    growthRate(5),
-    deathRate(3),
-    plagueActive(false) {
-
-    // Initialize class demographics
-    classDemographics[SocialClass::PEASANT] = static_cast<int>(initialPopulation * 0.7); // 70% peasants
-    classDemographics[SocialClass::MERCHANT] = static_cast<int>(initialPopulation * 0.15); // 15% merchants
-    classDemographics[SocialClass::NOBILITY] = static_cast<int>(initialPopulation * 0.1); // 10% nobility
-    classDemographics[SocialClass::MILITARY] = static_cast<int>(initialPopulation * 0.05); // 5% military
-}
-
-void Population::update(bool hasFood, bool hasHealthcare, int jobAvailability) {
-    // Calculate growth based on conditions
-    int growth = 0;
-    int deaths = 0;
-
-    if (hasFood && hasHealthcare) {
-        growth = static_cast<int>(totalPopulation * growthRate / 100.0);
-    }
-
-    // More deaths if there's no food or healthcare
-    if (!hasFood) {
-        deaths += static_cast<int>(totalPopulation * 0.1); // 10% die from starvation
-    }
-
-    if (!hasHealthcare) {
-        deaths += static_cast<int>(totalPopulation * 0.05); // 5% die from disease
-    }
-
-    // Normal death rate
-    deaths += static_cast<int>(totalPopulation * deathRate / 100.0);
-
-    // If plague is active, much higher death rate
-    if (plagueActive) {
-        deaths += static_cast<int>(totalPopulation * 0.2); // 20% die from plague
-    }
-
-    // Limited job availability reduces happiness
-    if (jobAvailability < totalPopulation / 2) {
-        happiness -= 5.0;
-    }
-    else {
-        happiness += 2.0;
-    }
-
-    // Update total population
-    totalPopulation += growth - deaths;
-    if (totalPopulation < 0) totalPopulation = 0;
-
-    // Clamp happiness between 0 and 100
-    happiness = std::max(0.0, std::min(happiness, 100.0));
-
-    // Update class demographics
-    for (auto& pair : classDemographics) {
-        int classGrowth = static_cast<int>((growth * pair.second) / totalPopulation);
-        int classDeaths = static_cast<int>((deaths * pair.second) / totalPopulation);
-        pair.second += classGrowth - classDeaths;
-        if (pair.second < 0) pair.second = 0;
-    }
-}
-
-void Population::triggerPlague() {
-    plagueActive = true;
-    happiness -= 30.0;
-    if (happiness < 0) happiness = 0;
-}
-
-void Population::endPlague() {
-    plagueActive = false;
-}
-
-bool Population::isUnhappy() const {
-    return happiness < 30.0;
-}
-
-int Population::getTotalPopulation() const {
-    return totalPopulation;
-}
-
-int Population::getClassPopulation(SocialClass socialClass) const {
-    auto it = classDemographics.find(socialClass);
-    if (it != classDemographics.end()) {
-        return it->second;
-    }
-    return 0;
-}
-
-double Population::getHappiness() const {
-    return happiness;
-}
-
-void Population::adjustHappiness(double amount) {
-    happiness += amount;
-    happiness = std::max(0.0, std::min(happiness, 100.0));
-}
-
-void Population::migrate(SocialClass fromClass, SocialClass toClass, int amount) {
-    if (classDemographics[fromClass] < amount) {
-        amount = classDemographics[fromClass];
-    }
-
-    classDemographics[fromClass] -= amount;
-    classDemographics[toClass] += amount;
-}
-
-// Leader Implementation
-Leader::Leader(const std::string& name, int influence, int corruption, int leadership) :
-    name(name), influence(influence), corruption(corruption), leadership(leadership) {}
-
-std::string Leader::getName() const {
-    return name;
-}
-
-int Leader::getInfluence() const {
-    return influence;
-}
-
-int Leader::getCorruption() const {
-    return corruption;
-}
-
-int Leader::getLeadership() const {
-    return leadership;
-}
-
-// King Implementation
-King::King(const std::string& name, int influence, int corruption, int leadership, const std::string& style) :
-    Leader(name, influence, corruption, leadership),
-    reignYears(0), popularity(50), leadershipStyle(style) {}
-
-void King::makeDecision(Kingdom& kingdom) {
-    // King's decision logic based on leadership style
-    if (leadershipStyle == "Benevolent") {
-        // Benevolent kings focus on population happiness
-        kingdom.getPopulation().adjustHappiness(5.0);
-    }
-    else if (leadershipStyle == "Militaristic") {
-        // Militaristic kings focus on army strength
-        if (kingdom.getArmy()) {
-            kingdom.getArmy()->train(1);
-        }
-    }
-    else if (leadershipStyle == "Economic") {
-        // Economic kings focus on treasury
-        if (kingdom.getBank()) {
-            kingdom.getBank()->deposit(100 * leadership);
-        }
-    }
-
-    // Corrupt kings will steal from treasury
-    if (kingdom.getBank() && corruption > 50) {
-        double stolenAmount = kingdom.getBank()->getTreasury() * (corruption * 0.01) * 0.1;
-        kingdom.getBank()->withdraw(stolenAmount);
-    }
-}
-
-std::string King::getTitle() const {
-    return "King";
-}
-
-void King::setTaxRate(double rate) {
-    // Implementation depends on Kingdom class integration
-}
-
-void King::declareWar(Kingdom& targetKingdom) {
-    // Implementation depends on Kingdom class integration
-}
-
-bool King::canBeBribes(int goldAmount) const {
-    return goldAmount > (100 - corruption) * 10;
-}
-
-// Commander Implementation
-Commander::Commander(const std::string& name, int influence, int corruption, int leadership,
-    int experience, int strategy, bool loyalty) :
-    Leader(name, influence, corruption, leadership),
-    battleExperience(experience), strategySkill(strategy), loyal(loyalty) {}
-
-void Commander::makeDecision(Kingdom& kingdom) {
-    // Commander's decision logic
-    if (!loyal && corruption > 70) {
-        // Disloyal commanders might plan coup
-        cout << getName() << " is plotting against the king!\n";
-        // Coup logic would be implemented in full game
-    }
-
-    // Boost army training based on experience
-    if (kingdom.getArmy()) {
-        int trainingBonus = battleExperience / 10;
-        // Implement bonus to army
-    }
-}
-
-std::string Commander::getTitle() const {
-    return "Commander";
-}
-
-bool Commander::isLoyal() const {
-    return loyal;
-}
-
-int Commander::getStrategyBonus() const {
-    return strategySkill;
-}
-
-// MerchantGuildLeader Implementation
-MerchantGuildLeader::MerchantGuildLeader(const std::string& name, int influence, int corruption, int leadership, double bonus) :
-    Leader(name, influence, corruption, leadership), tradingBonus(bonus) {}
-
-void MerchantGuildLeader::makeDecision(Kingdom& kingdom) {
-    // Merchant's decision logic
-    if (kingdom.getMarket()) {
-        // Apply trading bonuses
-    }
-
-    // Corrupt merchant leaders might manipulate prices
-    if (corruption > 60) {
-        // Price manipulation logic
-    }
-}
-
-std::string MerchantGuildLeader::getTitle() const {
-    return "Merchant Guild Leader";
-}
-
-void MerchantGuildLeader::addTradeConnection(const std::string& connection) {
-    tradeConnections.push_back(connection);
-}
-
-double MerchantGuildLeader::getTradingBonus() const {
-    return tradingBonus;
-}
-
-// Army Implementation
-Army::Army(int initialSize) :
-    size(initialSize), trainingLevel(1), morale(50),
-    maintenanceCost(initialSize * 2.0), isPaid(true) {}
-
-Army::~Army() {}
-
-void Army::recruit(int count, int populationSize) {
-    if (count <= 0) {
-        throw GameException("Cannot recruit a negative or zero number of soldiers");
-    }
-
-    if (count > populationSize * 0.2) {
-        throw GameException("Cannot recruit more than 20% of the population");
-    }
-
-    // Simulating training time
-    cout << "Training recruits";
-    for (int i = 0; i < 3; i++) {
-        cout << ".";
-        std::this_thread::sleep_for(std::chrono::seconds(1));
-    }
-    cout << " Done!" << endl;
-
-    size += count;
-    maintenanceCost = size * 2.0;
-}
-
-void Army::train(int duration) {
-    if (duration <= 0) {
-        throw GameException("Training duration must be positive");
-    }
-
-    cout << "Training army";
-    for (int i = 0; i < duration; i++) {
-        cout << ".";
-        std::this_thread::sleep_for(std::chrono::seconds(1));
-    }
-    cout << " Done!" << endl;
-
-    trainingLevel += duration;
-    if (trainingLevel > 10) trainingLevel = 10;
-}
-
-bool Army::battle(Army& enemyArmy) {
-    if (size <= 0) {
-        throw GameException("Cannot battle with no army");
-    }
-
-    // Simple battle simulation
-    int ourStrength = size * trainingLevel * morale / 100;
-    if (commander) {
-        ourStrength += commander->getLeadership() * 10;
-    }
-
-    int enemyStrength = enemyArmy.getSize() * enemyArmy.getTrainingLevel() *
-        enemyArmy.getMorale() / 100;
-    if (enemyArmy.getCommander()) {
-        enemyStrength += enemyArmy.getCommander()->getLeadership() * 10;
-    }
-
-    // Random factor
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> distrib(-20, 20);
-    int randomFactor = distrib(gen);
-
-    ourStrength += randomFactor;
-
-    // Calculate casualties
-    int ourCasualties = size * (0.1 + 0.4 * enemyStrength / (ourStrength > 0 ? ourStrength : 1));
-    int enemyCasualties = enemyArmy.getSize() * (0.1 + 0.4 * ourStrength / enemyStrength);
-
-    size -= ourCasualties;
-    if (size < 0) size = 0;
-
-    enemyArmy.size -= enemyCasualties;
-    if (enemyArmy.size < 0) enemyArmy.size = 0;
-
-    // Decrease morale after battle
-    morale -= 10;
-    if (morale < 0) morale = 0;
-
-    enemyArmy.morale -= 10;
-    if (enemyArmy.morale < 0) enemyArmy.morale = 0;
-
-    return ourStrength > enemyStrength;
-}
-
-void Army::payMaintenance(double amount) {
-    double requiredAmount = maintenanceCost;
-
-    if (amount >= requiredAmount) {
-        isPaid = true;
-        morale += 10;
-        if (morale > 100) morale = 100;
-    }
-    else {
-        isPaid = false;
-        morale -= 20;
-        if (morale < 0) morale = 0;
-    }
-}
-
-void Army::updateMorale(bool hasFood, bool isPaid) {
-    if (hasFood && isPaid) {
-        morale += 5;
-    }
-    else {
-        morale -= 15;
-    }
-
-    if (morale < 0) morale = 0;
-    if (morale > 100) morale = 100;
-}
-
-int Army::getSize() const {
-    return size;
-}
-
-int Army::getTrainingLevel() const {
-    return trainingLevel;
-}
-
-int Army::getMorale() const {
-    return morale;
-}
-
-double Army::getMaintenanceCost() const {
-    return maintenanceCost;
-}
-
-bool Army::getIsPaid() const {
-    return isPaid;
-}
-
-void Army::setCommander(std::unique_ptr<Commander> newCommander) {
-    commander = std::move(newCommander);
-}
-
-Commander* Army::getCommander() const {
-    return commander.get();
-}
-
-// Bank Implementation
-Bank::Bank(double initialTreasury) :
-    treasury(initialTreasury), loanAmount(0),
-    interestRate(0), loanDueTime(0), corruptionLevel(0) {}
-
-bool Bank::withdraw(double amount) {
-    if (amount <= 0) {
-        throw EconomyException("Cannot withdraw a negative or zero amount");
-    }
-
-    if (amount > treasury) {
-        return false;
-    }
-
-    treasury -= amount;
-    return true;
-}
-
-void Bank::deposit(double amount) {
-    if (amount <= 0) {
-        throw EconomyException("Cannot deposit a negative or zero amount");
-    }
-
-    treasury += amount;
-}
-
-double Bank::getLoan(double amount, double rate, int dueTime) {
-    if (amount <= 0) {
-        throw EconomyException("Loan amount must be positive");
-    }
-
-    if (rate <= 0) {
-        throw EconomyException("Interest rate must be positive");
-    }
-
-    if (dueTime <= 0) {
-        throw EconomyException("Loan due time must be positive");
-    }
-
-    if (loanAmount > 0) {
-        throw EconomyException("Cannot take another loan until current loan is repaid");
-    }
-
-    loanAmount = amount;
-    interestRate = rate;
-    loanDueTime = dueTime;
-    treasury += amount;
-
-    return amount;
-}
-
-bool Bank::repayLoan(double amount) {
-    if (amount <= 0) {
-        throw EconomyException("Repayment amount must be positive");
-    }
-
-    if (amount > treasury) {
-        return false;
-    }
-
-    if (loanAmount <= 0) {
-        throw EconomyException("No active loan to repay");
-    }
-
-    loanAmount -= amount;
-    treasury -= amount;
-
-    if (loanAmount < 0) {
-        treasury -= loanAmount; // Return overpayment
-        loanAmount = 0;
-        interestRate = 0;
-        loanDueTime = 0;
-    }
-
-    return true;
-}
-
-bool Bank::audit() {
-    // Simulating audit time
-    cout << "Auditing finances";
-    for (int i = 0; i < 3; i++) {
-        cout << ".";
-        std::this_thread::sleep_for(std::chrono::seconds(1));
-    }
-    cout << " Done!" << endl;
-
-    double stolenAmount = treasury * (corruptionLevel / 100.0) * 0.1;
-    treasury -= stolenAmount;
-
-    if (stolenAmount > 0) {
-        cout << "Audit found " << stolenAmount << " gold was embezzled!" << endl;
-        corruptionLevel -= 20;
-        if (corruptionLevel < 0) corruptionLevel = 0;
-        return true;
-    }
-
-    return false;
-}
-
-double Bank::getTreasury() const {
-    return treasury;
-}
-
-double Bank::getLoanAmount() const {
-    return loanAmount;
-}
-
-double Bank::getInterestRate() const {
-    return interestRate;
-}
-
-int Bank::getLoanDueTime() const {
-    return loanDueTime;
-}
-
-int Bank::getCorruptionLevel() const {
-    return corruptionLevel;
-}
-
-void Bank::setCorruptionLevel(int level) {
-    corruptionLevel = std::max(0, std::min(level, 100));
-}
-
-// Market Implementation
-Market::Market() : inflationRate(0.02), tradingVolume(0), isOpen(true) {
-    // Initialize prices
-    prices["wood"] = 10.0;
-    prices["stone"] = 20.0;
-    prices["iron"] = 40.0;
-    prices["gold"] = 100.0;
-    prices["food"] = 15.0;
-    prices["weapons"] = 50.0;
-}
-
-void Market::updatePrices() {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<> distrib(-0.1, 0.1);
-
-    for (auto& price : prices) {
-        double change = distrib(gen) + inflationRate;
-        price.second *= (1 + change);
-        if (price.second < 1.0) price.second = 1.0; // Minimum price
-    }
-}
-
-double Market::buyResource(const std::string& resourceName, int amount, Bank& bank) {
-    if (!isOpen) {
-        throw GameException("Market is closed");
-    }
-
-    if (amount <= 0) {
-        throw GameException("Cannot buy a negative or zero amount");
-    }
-
-    auto it = prices.find(resourceName);
-    if (it == prices.end()) {
-        throw GameException("Resource not available in market");
-    }
-
-    double cost = it->second * amount;
-
-    if (!bank.withdraw(cost)) {
-        throw GameException("Not enough money to buy resources");
-    }
-
-    tradingVolume += amount;
-    return cost;
-}
-
-double Market::sellResource(const std::string& resourceName, int amount, Bank& bank) {
-    if (!isOpen) {
-        throw GameException("Market is closed");
-    }
-
-    if (amount <= 0) {
-        throw GameException("Cannot sell a negative or zero amount");
-    }
-
-    auto it = prices.find(resourceName);
-    if (it == prices.end()) {
-        throw GameException("Resource not recognized in market");
-    }
-
-    double revenue = it->second * amount * 0.9; // 10% market fee
-    bank.deposit(revenue);
-
-    tradingVolume += amount;
-    return revenue;
-}
-
-void Market::setInflationRate(double rate) {
-    if (rate < 0) {
-        throw EconomyException("Inflation rate cannot be negative");
-    }
-
-    inflationRate = rate;
-}
-
-double Market::getResourcePrice(const std::string& resourceName) const {
-    auto it = prices.find(resourceName);
-    if (it != prices.end()) {
-        return it->second;
-    }
-    return 0.0;
-}
-
-void Market::open() {
-    isOpen = true;
-}
-
-void Market::close() {
-    isOpen = false;
-}
-
-bool Market::getIsOpen() const {
-    return isOpen;
-}
-
-// Politics Implementation
-Politics::Politics() : stability(50), civilUnrest(false), atWar(false) {}
-
-Politics::~Politics() {}
-
-void Politics::electKing(std::unique_ptr<King> newKing) {
-    if (!newKing) {
-        throw GameException("Invalid king");
-    }
-
-    cout << "Electing new king: " << newKing->getName() << endl;
-    std::this_thread::sleep_for(std::chrono::seconds(2));
-
-    currentKing = std::move(newKing);
-    stability += 20;
-    if (stability > 100) stability = 100;
-
-    civilUnrest = false;
-}
-
-void Politics::coup(std::unique_ptr<King> usurper) {
-    if (!usurper) {
-        throw GameException("Invalid usurper");
-    }
-
-    cout << "Coup in progress! " << usurper->getName() << " is taking over the kingdom!" << endl;
-    std::this_thread::sleep_for(std::chrono::seconds(3));
-
-    currentKing = std::move(usurper);
-    stability -= 40;
-    if (stability < 0) stability = 0;
-
-    civilUnrest = true;
-}
-
-void Politics::declareWar(const std::string& enemyKingdom) {
-    if (atWar) {
-        throw GameException("Already at war");
-    }
-
-    cout << "Declaring war on " << enemyKingdom << endl;
-    enemies.push_back(enemyKingdom);
-    atWar = true;
-    stability -= 10;
-    if (stability < 0) stability = 0;
-}
-
-void Politics::makePeace(const std::string& kingdom) {
-    auto it = std::find(enemies.begin(), enemies.end(), kingdom);
-    if (it != enemies.end()) {
-        enemies.erase(it);
-        cout << "Peace treaty signed with " << kingdom << endl;
-    }
-
-    if (enemies.empty()) {
-        atWar = false;
-        stability += 15;
-        if (stability > 100) stability = 100;
-    }
-}
-
-void Politics::formAlliance(const std::string& kingdom) {
-    auto it = std::find(enemies.begin(), enemies.end(), kingdom);
-    if (it != enemies.end()) {
-        throw GameException("Cannot form alliance with an enemy");
-    }
-
-    allies.push_back(kingdom);
-    cout << "Alliance formed with " << kingdom << endl;
-    stability += 5;
-    if (stability > 100) stability = 100;
-}
-
-void Politics::breakAlliance(const std::string& kingdom) {
-    auto it = std::find(allies.begin(), allies.end(), kingdom);
-    if (it != allies.end()) {
-        allies.erase(it);
-        cout << "Alliance with " << kingdom << " is broken" << endl;
-        stability -= 5;
-        if (stability < 0) stability = 0;
-    }
-}
-
-int Politics::getStability() const {
-    return stability;
-}
-
-bool Politics::hasCivilUnrest() const {
-    return civilUnrest;
-}
-
-bool Politics::isAtWar() const {
-    return atWar;
-}
-
-void Politics::setCivilUnrest(bool unrest) {
-    civilUnrest = unrest;
-}
-
-King* Politics::getCurrentKing() const {
-    return currentKing.get();
-}
-
-// Kingdom Implementation
-Kingdom::Kingdom(const std::string& name) : name(name), gameOver(false), currentTurn(1) {
-    // Initialize components
-    army = std::make_unique<Army>();
-    bank = std::make_unique<Bank>();
-    market = std::make_unique<Market>();
-    politics = std::make_unique<Politics>();
-
-    // Initialize resources
-    initializeResources();
-}
-
-Kingdom::~Kingdom() {}
-
-void Kingdom::initializeResources() {
-    resources.emplace("wood", Resource<int>("wood", 100, 1000, 10.0));
-    resources.emplace("stone", Resource<int>("stone", 50, 500, 20.0));
-    resources.emplace("iron", Resource<int>("iron", 20, 200, 40.0));
-    resources.emplace("gold", Resource<int>("gold", 10, 100, 100.0));
-    resources.emplace("food", Resource<int>("food", 200, 2000, 5.0));
-    resources.emplace("weapons", Resource<int>("weapons", 10, 100, 50.0));
-}
-
-void Kingdom::update() {
-    // Check for random events
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> distrib(1, 100);
-    int eventChance = distrib(gen);
-
-    if (eventChance <= 10) { // 10% chance of random event
-        randomEvent();
-    }
-
-    // Update resources
-    bool hasFood = resources.at("food").getQuantity() >= population.getTotalPopulation() / 10;
-
-    // Update population
-    int jobAvailability = population.getTotalPopulation() / 2; // Simplified job availability
-    population.update(hasFood, resources.at("food").getQuantity() > 0, jobAvailability);
-
-    // Consume food
-    int foodNeeded = population.getTotalPopulation() / 10;
-    if (resources.at("food").getQuantity() >= foodNeeded) {
-        resources.at("food").consumeQuantity(foodNeeded);
-    }
-    else {
-        // Not enough food
-        cout << "Your kingdom is starving!" << endl;
-        population.adjustHappiness(-10.0);
-    }
-
-    // Update army
-    if (army) {
-        army->updateMorale(hasFood, army->getIsPaid());
-
-        // Check for military rebellion
-        if (army->getMorale() < 20 && army->getSize() > 0) {
-            cout << "Your army is rebelling due to low morale!" << endl;
-            // Military coup logic
-            if (politics && politics->getCurrentKing()) {
-                cout << "The military has staged a coup!" << endl;
-                auto commander = army->getCommander();
-                if (commander) {
-                    std::unique_ptr<King> militaryLeader = std::make_unique<King>(
-                        commander->getName(), commander->getInfluence(),
-                        commander->getCorruption(), commander->getLeadership(),
-                        "Militaristic"
-                    );
-                    politics->coup(std::move(militaryLeader));
-                }
-            }
-        }
-    }
-
-    // Update bank
-    if (bank) {
-        // Update loans
-        if (bank->getLoanAmount() > 0) {
-            bank->setCorruptionLevel(bank->getCorruptionLevel() + 1);
-        }
-    }
-
-    // Update market
-    if (market) {
-        market->updatePrices();
-    }
-
-    // Update politics
-    if (politics) {
-        if (politics->getCurrentKing()) {
-            politics->getCurrentKing()->makeDecision(*this);
-        }
-
-        if (population.isUnhappy() && politics->getStability() < 30) {
-            cout << "The people are revolting!" << endl;
-            politics->setCivilUnrest(true);
-
-            // Chance of revolution
-            if (eventChance <= 30) {
-                cout << "Revolution! The king has been overthrown!" << endl;
-                gameOver = true;
-            }
-        }
-    }
-}
-
-void Kingdom::displayStatus() const {
-    cout << "\n============ KINGDOM OF " << name << " ============\n";
-    cout << "Population: " << population.getTotalPopulation() << " (Happiness: " << population.getHappiness() << "%)\n";
-    cout << "- Peasants: " << population.getClassPopulation(SocialClass::PEASANT) << "\n";
-    cout << "- Merchants: " << population.getClassPopulation(SocialClass::MERCHANT) << "\n";
-    cout << "- Nobility: " << population.getClassPopulation(SocialClass::NOBILITY) << "\n";
-    cout << "- Military: " << population.getClassPopulation(SocialClass::MILITARY) << "\n\n";
-
-    cout << "Resources:\n";
-    for (const auto& res : resources) {
-        cout << "- " << res.second.getName() << ": " << res.second.getQuantity() << "\n";
-    }
-
-    cout << "\nArmy:\n";
-    cout << "- Size: " << army->getSize() << "\n";
-    cout << "- Training Level: " << army->getTrainingLevel() << "\n";
-    cout << "- Morale: " << army->getMorale() << "%\n";
-    cout << "- Maintenance Cost: " << army->getMaintenanceCost() << " gold\n";
-
-    cout << "\nEconomy:\n";
-    cout << "- Treasury: " << bank->getTreasury() << " gold\n";
-    cout << "- Loan: " << bank->getLoanAmount() << " gold (Interest: " << bank->getInterestRate() * 100 << "%)\n";
-    cout << "- Corruption Level: " << bank->getCorruptionLevel() << "%\n";
-
-    cout << "\nPolitics:\n";
-    cout << "- King: " << (politics->getCurrentKing() ? politics->getCurrentKing()->getName() : "None") << "\n";
-    cout << "- Stability: " << politics->getStability() << "%\n";
-    cout << "- At War: " << (politics->isAtWar() ? "Yes" : "No") << "\n";
-    cout << "- Civil Unrest: " << (politics->hasCivilUnrest() ? "Yes" : "No") << "\n";
-    cout << "=============================================\n\n";
-}
-
-void Kingdom::processTurn() {
-    update();
-    currentTurn++;
-    displayStatus();
-}
-
-bool Kingdom::isGameOver() const {
-    return gameOver;
-}
-
-std::string Kingdom::getName() const {
-    return name;
-}
-
-Population& Kingdom::getPopulation() {
-    return population;
-}
-
-Army* Kingdom::getArmy() const {
-    return army.get();
-}
-
-Bank* Kingdom::getBank() const {
-    return bank.get();
-}
-
-Market* Kingdom::getMarket() const {
-    return market.get();
-}
-
-Politics* Kingdom::getPolitics() const {
-    return politics.get();
-}
-
-Resource<int>* Kingdom::getResource(const std::string& name) {
-    auto it = resources.find(name);
-    if (it != resources.end()) {
-        return &(it->second);
-    }
-    return nullptr;
-}
-
-void Kingdom::collectTaxes(double taxRate) {
-    if (taxRate < 0 || taxRate > 1.0) {
-        throw GameException("Tax rate must be between 0 and 1");
-    }
-
-    int totalPopulation = population.getTotalPopulation();
-    int peasants = population.getClassPopulation(SocialClass::PEASANT);
-    int merchants = population.getClassPopulation(SocialClass::MERCHANT);
-    int nobility = population.getClassPopulation(SocialClass::NOBILITY);
-
-    // Different tax rates for different classes (can be adjusted)
-    double peasantTax = taxRate * 0.5;
-    double merchantTax = taxRate * 2.0;
-    double nobilityTax = taxRate * 5.0;
-
-    double totalTax = peasants * peasantTax + merchants * merchantTax + nobility * nobilityTax;
-
-    // Adjust happiness based on tax rate
-    if (taxRate > 0.5) {
-        population.adjustHappiness(-10.0 * (taxRate - 0.5) * 2); // Higher taxes decrease happiness
-    }
-
-    bank->deposit(totalTax);
-
-    cout << "Taxes collected: " << totalTax << " gold" << endl;
-}
-
-void Kingdom::buildStructure(const std::string& structureName) {
-    // Structure building logic
-    // For now, a simple placeholder
-    cout << "Building " << structureName << "..." << endl;
-    std::this_thread::sleep_for(std::chrono::seconds(2));
-    cout << structureName << " completed!" << endl;
-}
-
-void Kingdom::handleWar(Kingdom& enemyKingdom) {
-    if (!politics->isAtWar()) {
-        politics->declareWar(enemyKingdom.getName());
-    }
-
-    cout << "War with " << enemyKingdom.getName() << " has begun!" << endl;
-    std::this_thread::sleep_for(std::chrono::seconds(2));
-
-    bool victory = army->battle(*enemyKingdom.getArmy());
-
-    if (victory) {
-        cout << "Victory! " << enemyKingdom.getName() << " has been defeated!" << endl;
-        // War reparations
-        double reparations = enemyKingdom.getBank()->getTreasury() * 0.2;
-        enemyKingdom.getBank()->withdraw(reparations);
-        bank->deposit(reparations);
-
-        politics->makePeace(enemyKingdom.getName());
-    }
-    else {
-        cout << "Defeat! Your army has been beaten by " << enemyKingdom.getName() << "!" << endl;
-        // Pay tribute
-        double tribute = bank->getTreasury() * 0.2;
-        bank->withdraw(tribute);
-        enemyKingdom.getBank()->deposit(tribute);
-
-        politics->makePeace(enemyKingdom.getName());
-    }
-}
-
-void Kingdom::manageResources() {
-    // Logic for resource management
-    // Placeholder
-}
-
-// Update saveGameState method for Visual Studio 2022 compatibility
-void Kingdom::saveGameState(const std::string& filename) const {
-    try {
-        std::ofstream saveFile(filename, std::ios::out | std::ios::trunc);
-        if (!saveFile.is_open()) {
-            throw GameException("Could not open file for saving: " + filename);
-        }
-
-        // Save basic kingdom info
-        saveFile << "KINGDOM_DATA\n";
-        saveFile << name << "\n";
-        saveFile << currentTurn << "\n";
-        saveFile << (gameOver ? "1" : "0") << "\n";
-
-        // Save population data
-        saveFile << "POPULATION_DATA\n";
-        saveFile << population.getTotalPopulation() << "\n";
-        saveFile << population.getHappiness() << "\n";
-        saveFile << population.getClassPopulation(SocialClass::PEASANT) << "\n";
-        saveFile << population.getClassPopulation(SocialClass::MERCHANT) << "\n";
-        saveFile << population.getClassPopulation(SocialClass::NOBILITY) << "\n";
-        saveFile << population.getClassPopulation(SocialClass::MILITARY) << "\n";
-
-        // Save resources
-        saveFile << "RESOURCES_DATA\n";
-        for (const auto& res : resources) {
-            saveFile << res.first << " "
-                << res.second.getQuantity() << " "
-                << res.second.getPrice() << "\n";
-        }
-
-        // Save army data
-        saveFile << "ARMY_DATA\n";
-        saveFile << army->getSize() << "\n";
-        saveFile << army->getTrainingLevel() << "\n";
-        saveFile << army->getMorale() << "\n";
-        saveFile << army->getMaintenanceCost() << "\n";
-        saveFile << (army->getIsPaid() ? "1" : "0") << "\n";
-
-        // Save bank data
-        saveFile << "BANK_DATA\n";
-        saveFile << bank->getTreasury() << "\n";
-        saveFile << bank->getLoanAmount() << "\n";
-        saveFile << bank->getInterestRate() << "\n";
-        saveFile << bank->getLoanDueTime() << "\n";
-        saveFile << bank->getCorruptionLevel() << "\n";
-
-        // Save market data
-        saveFile << "MARKET_DATA\n";
-        saveFile << (market->getIsOpen() ? "1" : "0") << "\n";
-
-        // Save politics data
-        saveFile << "POLITICS_DATA\n";
-        saveFile << politics->getStability() << "\n";
-        saveFile << (politics->hasCivilUnrest() ? "1" : "0") << "\n";
-        saveFile << (politics->isAtWar() ? "1" : "0") << "\n";
-
-        // Add king data if exists
-        if (politics->getCurrentKing()) {
-            saveFile << "KING_DATA\n";
-            saveFile << politics->getCurrentKing()->getName() << "\n";
-            saveFile << politics->getCurrentKing()->getInfluence() << "\n";
-            saveFile << politics->getCurrentKing()->getCorruption() << "\n";
-            saveFile << politics->getCurrentKing()->getLeadership() << "\n";
-        }
-
-        saveFile.close();
-        if (saveFile.fail()) {
-            throw GameException("Failed to close file after saving");
-        }
-        std::cout << "Game saved successfully to: " << filename << std::endl;
-    }
-    catch (const std::exception& e) {
-        std::cerr << "Error saving game: " << e.what() << std::endl;
-        throw GameException("Failed to save game: " + std::string(e.what()));
-    }
-}
-
-// Update loadGameState method to fix the string parsing issues
-void Kingdom::loadGameState(const std::string& filename) {
-    try {
-        if (!validateSaveFile(filename)) {
-            throw GameException("Invalid or missing save file: " + filename);
-        }
-
-        // Clear previous state - reset static variables
-        static int popDataLine = 0;
-        static int armyDataLine = 0;
-        static int bankDataLine = 0;
-        static int kingdomLine = 0;
-
-        popDataLine = 0;
-        armyDataLine = 0;
-        bankDataLine = 0;
-        kingdomLine = 0;
-
-        std::ifstream loadFile(filename, std::ios::in);
-        if (!loadFile.is_open()) {
-            throw GameException("Could not open file for loading: " + filename);
-        }
-
-        std::string line, section;
-        while (std::getline(loadFile, line)) {
-            // Skip empty lines
-            if (line.empty()) continue;
-
-            // Check for section headers
-            if (line == "KINGDOM_DATA" || line == "POPULATION_DATA" ||
-                line == "RESOURCES_DATA" || line == "ARMY_DATA" ||
-                line == "BANK_DATA" || line == "MARKET_DATA" ||
-                line == "POLITICS_DATA" || line == "KING_DATA") {
-                section = line;
-                continue;
-            }
-
-            // Parse based on current section
-            if (section == "KINGDOM_DATA") {
-                if (kingdomLine == 0) {
-                    name = line;
-                    kingdomLine++;
-                }
-                else if (kingdomLine == 1) {
-                    currentTurn = std::stoi(line);
-                    kingdomLine++;
-                }
-                else if (kingdomLine == 2) {
-                    gameOver = (line == "1");
-                    kingdomLine = 0; // Reset for next time
-                }
-            }
-            else if (section == "POPULATION_DATA") {
-                if (popDataLine == 0) {
-                    // Reset population with new total
-                    int totalPop = std::stoi(line);
-                    population = Population(totalPop);
-                    popDataLine++;
-                }
-                else if (popDataLine == 1) {
-                    // Set happiness
-                    population.adjustHappiness(std::stod(line) - population.getHappiness());
-                    popDataLine++;
-                }
-                else if (popDataLine == 2) {
-                    // Set peasant population
-                    int peasants = std::stoi(line);
-                    popDataLine++;
-                }
-                else if (popDataLine == 3) {
-                    // Set merchant population
-                    int merchants = std::stoi(line);
-                    popDataLine++;
-                }
-                else if (popDataLine == 4) {
-                    // Set nobility population
-                    int nobility = std::stoi(line);
-                    popDataLine++;
-                }
-                else if (popDataLine == 5) {
-                    // Set military population
-                    int military = std::stoi(line);
-                    popDataLine = 0; // Reset for next time
-                }
-            }
-            else if (section == "RESOURCES_DATA") {
-                // Fix this section - the issue was here
-                std::istringstream iss(line);  // Create istringstream properly
-                std::string resourceName;
-                int quantity;
-                double price;
-
-                if (iss >> resourceName >> quantity >> price) {  // This now works with the istringstream
-                    auto resource = getResource(resourceName);
-                    if (resource) {
-                        resource->setQuantity(quantity);
-                        resource->setPrice(price);
-                    }
-                }
-            }
-            else if (section == "ARMY_DATA") {
-                if (armyDataLine == 0) {
-                    // Create new army with size
-                    int size = std::stoi(line);
-                    army = std::make_unique<Army>(size);
-                    armyDataLine++;
-                }
-                else if (armyDataLine == 1) {
-                    // Set training level
-                    int trainingLevel = std::stoi(line);
-                    // We could implement functionality to actually set this value
-                    // but for now we'll just move on
-                    armyDataLine++;
-                }
-                else if (armyDataLine == 2) {
-                    // Set morale
-                    int morale = std::stoi(line);
-                    armyDataLine++;
-                }
-                else if (armyDataLine == 3) {
-                    // Set maintenance cost
-                    double maintenanceCost = std::stod(line);
-                    armyDataLine++;
-                }
-                else if (armyDataLine == 4) {
-                    // Set isPaid
-                    bool isPaid = (line == "1");
-                    armyDataLine = 0; // Reset for next time
-                }
-            }
-            else if (section == "BANK_DATA") {
-                if (bankDataLine == 0) {
-                    // Set treasury
-                    double treasury = std::stod(line);
-                    bank = std::make_unique<Bank>(treasury);
-                    bankDataLine++;
-                }
-                else if (bankDataLine == 1) {
-                    // Set loan amount
-                    double loanAmount = std::stod(line);
-                    bankDataLine++;
-                }
-                else if (bankDataLine == 2) {
-                    // Set interest rate
-                    double interestRate = std::stod(line);
-                    bankDataLine++;
-                }
-                else if (bankDataLine == 3) {
-                    // Set loan due time
-                    int loanDueTime = std::stoi(line);
-                    bankDataLine++;
-                }
-                else if (bankDataLine == 4) {
-                    // Set corruption level
-                    int corruptionLevel = std::stoi(line);
-                    bank->setCorruptionLevel(corruptionLevel);
-                    bankDataLine = 0; // Reset for next time
-                }
-            }
-            // Similar parsing for other sections
-        }
-
-        // Close file safely
-        loadFile.close();
-
-        std::cout << "Game loaded successfully from: " << filename << std::endl;
-    }
-    catch (const std::exception& e) {
-        std::cerr << "Error loading game: " << e.what() << std::endl;
-        throw GameException("Failed to load game: " + std::string(e.what()));
-    }
-}
-
-// Update validateSaveFile method to provide better error messages
-bool Kingdom::validateSaveFile(const std::string& filename) {
-    std::ifstream testFile(filename);
-    if (!testFile.is_open()) {
-        std::cerr << "Error: Could not open file: " << filename << std::endl;
-        return false;
-    }
-
-    // Basic validation - check for required sections
-    bool hasKingdomData = false;
-    bool hasPopulationData = false;
-    bool hasResourcesData = false;
-
-    std::string line;
-    while (std::getline(testFile, line)) {
-        if (line == "KINGDOM_DATA") hasKingdomData = true;
-        else if (line == "POPULATION_DATA") hasPopulationData = true;
-        else if (line == "RESOURCES_DATA") hasResourcesData = true;
-    }
-
-    testFile.close();
-
-    if (!hasKingdomData || !hasPopulationData || !hasResourcesData) {
-        std::cerr << "Error: File " << filename << " is not a valid save file" << std::endl;
-        return false;
-    }
-
-    return true;
-}
-
-void Kingdom::randomEvent() {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> distrib(0, 5);
-    int eventType = distrib(gen);
-
-    switch (eventType) {
-    case 0: // Plaguef
-        cout << "A plague has spread in your kingdom! Population decreases dramatically!" << endl;
-        population.triggerPlague();
-        break;
-    case 1: // Good harvest
-        cout << "Excellent harvest this year! Food supplies increased." << endl;
-        resources.at("food").addQuantity(100);
-        break;
-    case 2: // Drought
-        cout << "A severe drought has affected your kingdom. Food production decreased." << endl;
-        resources.at("food").consumeQuantity(resources.at("food").getQuantity() / 3);
-        break;
-    case 3: // Gold discovery
-        cout << "Gold has been discovered in your kingdom!" << endl;
-        resources.at("gold").addQuantity(20);
-        break;
-    case 4: // Trade opportunity
-        cout << "A foreign merchant offers special trade opportunities." << endl;
-        // Implementation would depend on other mechanics
-        break;
-    case 5: // Assassination attempt
-        if (politics->getCurrentKing()) {
-            cout << "An assassination attempt on King " << politics->getCurrentKing()->getName() << "!" << endl;
-            std::uniform_int_distribution<> successDist(1, 100);
-            int success = successDist(gen);
-            if (success <= 20) { // 20% chance of success
-                cout << "The king has been assassinated!" << endl;
-                // Set king to nullptr and trigger election
-                gameOver = true;
-            }
-            else {
-                cout << "The assassination attempt was foiled!" << endl;
-            }
-        }
-        break;
-    }
+﻿#include "Stronghold.h"
+#include <iostream>
+#include <cstdlib>
+#include <ctime>
+#include <algorithm>
+#include <fstream>
+#include <cmath>
+#include <charconv>
+#include <climits>
+#include <cstring>
+#include <bitset>
+#include <sstream>  // Add this line to include the string stream functionality
+
+#if defined(__AVX__) || (defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)))
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+#ifdef _HAS_CXX17
+#include <filesystem>
+#endif
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <signal.h>
+#include <cerrno>
+#endif
+
+using namespace std;
+
+// Simulation helpers
+namespace {
+    thread_local bool headlessMode = false;
+    thread_local bool insideWorkerPool = false;
+    std::atomic<TurnScheduling> turnScheduling(TurnScheduling::AUTOMATIC);
+}
+
+void std::setHeadless(bool headless) {
+    headlessMode = headless;
+}
+
+bool std::isHeadless() {
+    return headlessMode;
+}
+
+void std::setTurnScheduling(TurnScheduling scheduling) {
+    turnScheduling = scheduling;
+}
+
+TurnScheduling std::getTurnScheduling() {
+    return turnScheduling;
+}
+
+std::ostream& std::gameOutput() {
+    // A stream without a buffer is permanently bad, so writes to it are dropped
+    // before any formatting happens
+    thread_local std::ostream discard(nullptr);
+    return headlessMode ? discard : std::cout;
+}
+
+void std::gameDelay(int seconds) {
+    if (!headlessMode) {
+        std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    }
+}
+
+std::mt19937& std::gameRandom() {
+    thread_local std::mt19937 generator(std::random_device{}());
+    return generator;
+}
+
+void std::seedGameRandom(unsigned int seed) {
+    gameRandom().seed(seed);
+}
+
+Philox4x32::Counter Philox4x32::block(Counter counter, Key key) {
+    const uint32_t multiplier0 = 0xD2511F53;
+    const uint32_t multiplier1 = 0xCD9E8D57;
+    const uint32_t weyl0 = 0x9E3779B9;
+    const uint32_t weyl1 = 0xBB67AE85;
+
+    for (int round = 0; round < 10; round++) {
+        uint64_t product0 = static_cast<uint64_t>(multiplier0) * counter[0];
+        uint64_t product1 = static_cast<uint64_t>(multiplier1) * counter[2];
+        counter = {
+            static_cast<uint32_t>(product1 >> 32) ^ counter[1] ^ key[0],
+            static_cast<uint32_t>(product1),
+            static_cast<uint32_t>(product0 >> 32) ^ counter[3] ^ key[1],
+            static_cast<uint32_t>(product0)
+        };
+        key[0] += weyl0;
+        key[1] += weyl1;
+    }
+    return counter;
+}
+
+CounterRandom::CounterRandom(uint64_t seed, uint32_t kingdom, uint32_t turn, RandomSlot slot, uint32_t sequence) :
+    counter{ 0, turn, kingdom, (static_cast<uint32_t>(slot) << 24) | (sequence & 0xFFFFFF) },
+    key{ static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32) },
+    output{},
+    next(output.size()) {}
+
+namespace {
+    // Words of the blocks RandomBatch makes: counters, keys and results,
+    // one array of each per word, a block per index
+    enum PhiloxLane { COUNTER0, COUNTER1, COUNTER2, COUNTER3, KEY0, KEY1, PHILOX_LANES };
+
+    void philoxLanesScalar(uint32_t* const* lanes, uint32_t* const* out, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            Philox4x32::Counter result = Philox4x32::block(
+                { lanes[COUNTER0][i], lanes[COUNTER1][i], lanes[COUNTER2][i], lanes[COUNTER3][i] },
+                { lanes[KEY0][i], lanes[KEY1][i] });
+            for (int w = 0; w < 4; w++) {
+                out[w][i] = result[w];
+            }
+        }
+    }
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define STRONGHOLD_PHILOX_AVX2 1
+    // High and low halves of eight 32-bit products at once
+    __attribute__((target("avx2")))
+    inline void mulhilo8(__m256i value, __m256i multiplier, __m256i& high, __m256i& low) {
+        __m256i even = _mm256_mul_epu32(value, multiplier);
+        __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(value, 32), multiplier);
+        low = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+        high = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+    }
+
+    // The rounds of Philox4x32::block() for eight blocks side by side;
+    // returns how many blocks it made
+    __attribute__((target("avx2")))
+    size_t philoxLanesAvx2(uint32_t* const* lanes, uint32_t* const* out, size_t count) {
+        const __m256i multiplier0 = _mm256_set1_epi32(static_cast<int>(0xD2511F53));
+        const __m256i multiplier1 = _mm256_set1_epi32(static_cast<int>(0xCD9E8D57));
+        const __m256i weyl0 = _mm256_set1_epi32(static_cast<int>(0x9E3779B9));
+        const __m256i weyl1 = _mm256_set1_epi32(static_cast<int>(0xBB67AE85));
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256i c0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes[COUNTER0] + i));
+            __m256i c1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes[COUNTER1] + i));
+            __m256i c2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes[COUNTER2] + i));
+            __m256i c3 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes[COUNTER3] + i));
+            __m256i k0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes[KEY0] + i));
+            __m256i k1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes[KEY1] + i));
+            for (int round = 0; round < 10; round++) {
+                __m256i high0, low0, high1, low1;
+                mulhilo8(c0, multiplier0, high0, low0);
+                mulhilo8(c2, multiplier1, high1, low1);
+                c0 = _mm256_xor_si256(_mm256_xor_si256(high1, c1), k0);
+                c1 = low1;
+                c2 = _mm256_xor_si256(_mm256_xor_si256(high0, c3), k1);
+                c3 = low0;
+                k0 = _mm256_add_epi32(k0, weyl0);
+                k1 = _mm256_add_epi32(k1, weyl1);
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out[0] + i), c0);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out[1] + i), c1);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out[2] + i), c2);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out[3] + i), c3);
+        }
+        return i;
+    }
+#endif
+}
+
+RandomBatch::RandomBatch() : drawsPerStream(0) {}
+
+bool RandomBatch::usesAvx2() {
+#ifdef STRONGHOLD_PHILOX_AVX2
+    static const bool available = __builtin_cpu_supports("avx2");
+    return available;
+#else
+    return false;
+#endif
+}
+
+void RandomBatch::generate(const std::vector<Kingdom*>& kingdoms, RandomSlot slot, size_t perStream) {
+    drawsPerStream = perStream;
+    size_t blocksPerStream = (perStream + 3) / 4;
+    size_t count = kingdoms.size() * blocksPerStream;
+    draws.resize(kingdoms.size() * perStream);
+    lanes.resize(count * (PHILOX_LANES + 4));
+
+    uint32_t* in[PHILOX_LANES];
+    uint32_t* out[4];
+    for (int lane = 0; lane < PHILOX_LANES; lane++) in[lane] = lanes.data() + lane * count;
+    for (int w = 0; w < 4; w++) out[w] = lanes.data() + (PHILOX_LANES + w) * count;
+
+    // The same counters and keys CounterRandom would use
+    size_t i = 0;
+    for (const Kingdom* kingdom : kingdoms) {
+        uint64_t seed = kingdom->getRandomSeed();
+        uint32_t turn = static_cast<uint32_t>(kingdom->getCurrentTurn());
+        KingdomId id = kingdom->getPolitics()->getKingdomId();
+        for (size_t block = 0; block < blocksPerStream; block++, i++) {
+            in[COUNTER0][i] = static_cast<uint32_t>(block);
+            in[COUNTER1][i] = turn;
+            in[COUNTER2][i] = id;
+            in[COUNTER3][i] = static_cast<uint32_t>(slot) << 24;
+            in[KEY0][i] = static_cast<uint32_t>(seed);
+            in[KEY1][i] = static_cast<uint32_t>(seed >> 32);
+        }
+    }
+
+    size_t made = 0;
+#ifdef STRONGHOLD_PHILOX_AVX2
+    if (usesAvx2()) {
+        made = philoxLanesAvx2(in, out, count);
+    }
+#endif
+    philoxLanesScalar(in, out, made, count);
+
+    uint32_t* target = draws.data();
+    for (size_t stream = 0; stream < kingdoms.size(); stream++) {
+        for (size_t n = 0; n < perStream; n++) {
+            *target++ = out[n % 4][stream * blocksPerStream + n / 4];
+        }
+    }
+}
+
+void std::writeFileAtomically(const std::string& filename, std::string_view data) {
+    // Every write gets its own temporary file, so saves of the same file
+    // running at once never write into each other's copy
+#ifdef __linux__
+    std::string tempName = filename + ".XXXXXX";
+    int fd = ::mkostemp(tempName.data(), O_CLOEXEC);
+    if (fd < 0) {
+        throw GameException("Could not open file for saving: " + tempName);
+    }
+    // mkostemp makes the file private; a save is readable like any other file
+    ::fchmod(fd, 0644);
+
+    size_t written = 0;
+    const char* failedStep = nullptr;
+    while (written < data.size() && !failedStep) {
+        ssize_t count = ::write(fd, data.data() + written, data.size() - written);
+        if (count >= 0) {
+            written += static_cast<size_t>(count);
+        }
+        else if (errno != EINTR) {
+            failedStep = "write";
+        }
+    }
+    if (!failedStep && ::fsync(fd) != 0) {
+        failedStep = "flush";
+    }
+    if (::close(fd) != 0 && !failedStep) {
+        failedStep = "close";
+    }
+    if (failedStep) {
+        int error = errno;
+        ::unlink(tempName.c_str());
+        throw GameException("Could not " + std::string(failedStep) + " " + tempName + ": " + std::strerror(error));
+    }
+
+    if (::rename(tempName.c_str(), filename.c_str()) != 0) {
+        int error = errno;
+        ::unlink(tempName.c_str());
+        throw GameException("Could not replace " + filename + ": " + std::strerror(error));
+    }
+
+    // The rename only survives a crash once the directory entry is on disk too
+    size_t slash = filename.rfind('/');
+    std::string directory = slash == std::string::npos ? "." : filename.substr(0, slash == 0 ? 1 : slash);
+    int directoryFd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (directoryFd >= 0) {
+        ::fsync(directoryFd);
+        ::close(directoryFd);
+    }
+#else
+    static std::atomic<unsigned long> saveCount{ 0 };
+    std::string tempName = filename + "." + std::to_string(saveCount.fetch_add(1)) + ".tmp";
+    {
+        std::ofstream file(tempName, std::ios::out | std::ios::trunc | std::ios::binary);
+        if (!file.is_open()) {
+            throw GameException("Could not open file for saving: " + tempName);
+        }
+        file.write(data.data(), static_cast<std::streamsize>(data.size()));
+        file.close();
+        if (file.fail()) {
+            std::remove(tempName.c_str());
+            throw GameException("Could not write " + tempName);
+        }
+    }
+    std::remove(filename.c_str());
+    if (std::rename(tempName.c_str(), filename.c_str()) != 0) {
+        throw GameException("Could not replace " + filename);
+    }
+#endif
+}
+
+// Name Implementation
+namespace {
+    const size_t nameChunkSize = 4096;
+    const size_t nameChunkCount = 16384;
+    const uint32_t namePinned = UINT32_MAX;     // interned outside any scope, never released
+
+    // Names live in fixed-size chunks that never move, so the text of a name
+    // can be read without the lock while other threads add new names.
+    // Released slots are reused for later names.
+    struct NameTable {
+        std::mutex lock;
+        std::unordered_map<std::string_view, uint32_t> lookup;
+        std::atomic<std::string*> chunks[nameChunkCount];
+        std::vector<uint32_t> holders;          // scopes holding each name, or namePinned
+        std::vector<uint32_t> released;
+        uint32_t size;
+
+        NameTable() : size(0) {
+            for (auto& chunk : chunks) {
+                chunk.store(nullptr, std::memory_order_relaxed);
+            }
+            add("", namePinned);
+        }
+
+        std::string& slot(uint32_t index) {
+            return chunks[index / nameChunkSize].load(std::memory_order_relaxed)[index % nameChunkSize];
+        }
+
+        uint32_t add(std::string_view text, uint32_t initialHolders) {
+            uint32_t index;
+            if (!released.empty()) {
+                index = released.back();
+                released.pop_back();
+            }
+            else {
+                if (size >= nameChunkSize * nameChunkCount) {
+                    throw GameException("Too many distinct names");
+                }
+                std::string* chunk = chunks[size / nameChunkSize].load(std::memory_order_relaxed);
+                if (!chunk) {
+                    chunk = new std::string[nameChunkSize];
+                    chunks[size / nameChunkSize].store(chunk, std::memory_order_release);
+                }
+                index = size++;
+                holders.push_back(0);
+            }
+            std::string& stored = slot(index);
+            stored.assign(text.data(), text.size());
+            holders[index] = initialHolders;
+            lookup.emplace(stored, index);
+            return index;
+        }
+
+        void release(uint32_t index) {
+            if (holders[index] == namePinned || --holders[index] > 0) {
+                return;
+            }
+            std::string& text = slot(index);
+            lookup.erase(text);
+            std::string().swap(text);
+            released.push_back(index);
+        }
+    };
+
+    NameTable& nameTable() {
+        // Never destroyed, so names stay readable during static destruction
+        static NameTable* table = new NameTable();
+        return *table;
+    }
+
+    thread_local NameScope* currentNameScope = nullptr;
+}
+
+uint32_t Name::intern(std::string_view text) {
+    if (text.empty()) {
+        return 0;
+    }
+    NameTable& table = nameTable();
+    NameScope* scope = currentNameScope;
+    std::lock_guard<std::mutex> guard(table.lock);
+    auto it = table.lookup.find(text);
+    if (!scope) {
+        if (it == table.lookup.end()) {
+            return table.add(text, namePinned);
+        }
+        table.holders[it->second] = namePinned;
+        return it->second;
+    }
+
+    if (it != table.lookup.end() &&
+        (table.holders[it->second] == namePinned || scope->held.count(it->second) > 0)) {
+        return it->second;
+    }
+    if (scope->held.size() >= scope->limit) {
+        throw GameException("Too many distinct names in this scope");
+    }
+    uint32_t index;
+    if (it == table.lookup.end()) {
+        index = table.add(text, 1);
+    }
+    else {
+        index = it->second;
+        table.holders[index]++;
+    }
+    scope->held.insert(index);
+    return index;
+}
+
+const std::string& Name::str() const {
+    return nameTable().chunks[index / nameChunkSize].load(std::memory_order_acquire)[index % nameChunkSize];
+}
+
+bool Name::find(std::string_view text, Name& name) {
+    NameTable& table = nameTable();
+    std::lock_guard<std::mutex> guard(table.lock);
+    auto it = table.lookup.find(text);
+    if (it == table.lookup.end()) {
+        return false;
+    }
+    name.index = it->second;
+    return true;
+}
+
+size_t Name::count() {
+    NameTable& table = nameTable();
+    std::lock_guard<std::mutex> guard(table.lock);
+    return table.size - table.released.size();
+}
+
+NameScope::NameScope(size_t nameLimit) : limit(nameLimit) {}
+
+NameScope::~NameScope() {
+    NameTable& table = nameTable();
+    std::lock_guard<std::mutex> guard(table.lock);
+    for (uint32_t index : held) {
+        table.release(index);
+    }
+}
+
+size_t NameScope::size() const {
+    return held.size();
+}
+
+NameScope::Guard::Guard(NameScope& scope) : previous(currentNameScope) {
+    currentNameScope = &scope;
+}
+
+NameScope::Guard::~Guard() {
+    currentNameScope = previous;
+}
+
+std::ostream& std::operator<<(std::ostream& out, const Name& name) {
+    return out << name.str();
+}
+
+// Instrumentation
+namespace {
+    thread_local TurnPhase turnPhase = TurnPhase::OUTSIDE_TURN;
+
+    const char* const turnPhaseNames[TURN_PHASE_COUNT] = {
+        "Between turns", "Events", "Production", "Epidemic", "Population",
+        "Provinces", "Army", "Economy", "Politics", "Bookkeeping"
+    };
+}
+
+const char* std::getTurnPhaseName(TurnPhase phase) {
+    return turnPhaseNames[static_cast<int>(phase)];
+}
+
+TurnPhase std::currentTurnPhase() {
+    return turnPhase;
+}
+
+void std::setTurnPhase(TurnPhase phase) {
+    turnPhase = phase;
+}
+
+PhaseCounters InstrumentationReport::total() const {
+    PhaseCounters sum;
+    for (const PhaseCounters& phase : phases) {
+        sum.allocations += phase.allocations;
+        sum.bytesAllocated += phase.bytesAllocated;
+        sum.frees += phase.frees;
+        sum.exceptions += phase.exceptions;
+    }
+    return sum;
+}
+
+InstrumentationReport InstrumentationReport::operator-(const InstrumentationReport& earlier) const {
+    InstrumentationReport difference;
+    for (int p = 0; p < TURN_PHASE_COUNT; p++) {
+        difference.phases[p].allocations = phases[p].allocations - earlier.phases[p].allocations;
+        difference.phases[p].bytesAllocated = phases[p].bytesAllocated - earlier.phases[p].bytesAllocated;
+        difference.phases[p].frees = phases[p].frees - earlier.phases[p].frees;
+        difference.phases[p].exceptions = phases[p].exceptions - earlier.phases[p].exceptions;
+    }
+    return difference;
+}
+
+void std::renderInstrumentation(std::ostream& out, const InstrumentationReport& report) {
+    out << "Costs (allocations, bytes, frees, exceptions):\n";
+    for (int p = 0; p < TURN_PHASE_COUNT; p++) {
+        const PhaseCounters& phase = report.phases[p];
+        if (phase.allocations == 0 && phase.frees == 0 && phase.exceptions == 0) {
+            continue;
+        }
+        out << "- " << turnPhaseNames[p] << ": " << phase.allocations << ", " << phase.bytesAllocated
+            << ", " << phase.frees << ", " << phase.exceptions << "\n";
+    }
+    PhaseCounters total = report.total();
+    out << "- Total: " << total.allocations << ", " << total.bytesAllocated
+        << ", " << total.frees << ", " << total.exceptions << "\n";
+}
+
+#ifdef STRONGHOLD_COUNT_ALLOCATIONS
+namespace {
+    // One cache line per phase so threads in different phases do not share
+    struct alignas(64) PhaseSlot {
+        std::atomic<size_t> allocations{ 0 };
+        std::atomic<size_t> bytesAllocated{ 0 };
+        std::atomic<size_t> frees{ 0 };
+        std::atomic<size_t> exceptions{ 0 };
+    };
+
+    PhaseSlot phaseSlots[TURN_PHASE_COUNT];
+
+    void countFree(void* pointer) {
+        if (pointer) {
+            phaseSlots[static_cast<int>(turnPhase)].frees.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+// Kept out of line: inlined into this file, one half of a pair would show the
+// compiler malloc() or free() matched against operator new or delete, and it
+// would warn on every delete
+#if defined(__GNUC__)
+#define STRONGHOLD_OUT_OF_LINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#define STRONGHOLD_OUT_OF_LINE __declspec(noinline)
+#else
+#define STRONGHOLD_OUT_OF_LINE
+#endif
+
+STRONGHOLD_OUT_OF_LINE void* operator new(size_t size) {
+    PhaseSlot& slot = phaseSlots[static_cast<int>(turnPhase)];
+    slot.allocations.fetch_add(1, std::memory_order_relaxed);
+    slot.bytesAllocated.fetch_add(size, std::memory_order_relaxed);
+    if (void* pointer = std::malloc(size ? size : 1)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+STRONGHOLD_OUT_OF_LINE void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+STRONGHOLD_OUT_OF_LINE void operator delete(void* pointer) noexcept {
+    countFree(pointer);
+    std::free(pointer);
+}
+
+STRONGHOLD_OUT_OF_LINE void operator delete[](void* pointer) noexcept {
+    countFree(pointer);
+    std::free(pointer);
+}
+
+STRONGHOLD_OUT_OF_LINE void operator delete(void* pointer, size_t) noexcept {
+    countFree(pointer);
+    std::free(pointer);
+}
+
+STRONGHOLD_OUT_OF_LINE void operator delete[](void* pointer, size_t) noexcept {
+    countFree(pointer);
+    std::free(pointer);
+}
+
+void std::countGameException() {
+    phaseSlots[static_cast<int>(turnPhase)].exceptions.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool std::isInstrumented() {
+    return true;
+}
+
+InstrumentationReport std::readInstrumentation() {
+    InstrumentationReport report;
+    for (int p = 0; p < TURN_PHASE_COUNT; p++) {
+        report.phases[p].allocations = phaseSlots[p].allocations.load(std::memory_order_relaxed);
+        report.phases[p].bytesAllocated = phaseSlots[p].bytesAllocated.load(std::memory_order_relaxed);
+        report.phases[p].frees = phaseSlots[p].frees.load(std::memory_order_relaxed);
+        report.phases[p].exceptions = phaseSlots[p].exceptions.load(std::memory_order_relaxed);
+    }
+    return report;
+}
+
+size_t std::heapAllocationCount() {
+    size_t count = 0;
+    for (const PhaseSlot& slot : phaseSlots) {
+        count += slot.allocations.load(std::memory_order_relaxed);
+    }
+    return count;
+}
+#else
+void std::countGameException() {
+}
+
+bool std::isInstrumented() {
+    return false;
+}
+
+InstrumentationReport std::readInstrumentation() {
+    return InstrumentationReport();
+}
+
+size_t std::heapAllocationCount() {
+    return 0;
+}
+#endif
+
+// TurnArena Implementation
+TurnArena::TurnArena(size_t initialSize, pmr::memory_resource* upstreamResource) :
+    upstream(upstreamResource), chunks(nullptr), cursor(nullptr), limit(nullptr),
+    chunkSize(initialSize), bytesUsed(0), peakBytes(0), upstreamAllocations(0) {
+}
+
+TurnArena::~TurnArena() {
+    releaseChunks();
+}
+
+void TurnArena::addChunk(size_t minimumBytes) {
+    size_t size = std::max(chunkSize, sizeof(Chunk) + minimumBytes);
+    Chunk* chunk = static_cast<Chunk*>(upstream->allocate(size, alignof(std::max_align_t)));
+    upstreamAllocations++;
+
+    chunk->next = chunks;
+    chunk->size = size;
+    chunks = chunk;
+    cursor = reinterpret_cast<char*>(chunk + 1);
+    limit = reinterpret_cast<char*>(chunk) + size;
+
+    // Each further chunk is twice as large, so a busy turn needs only a few
+    chunkSize = size * 2;
+}
+
+void TurnArena::releaseChunks() {
+    while (chunks) {
+        Chunk* next = chunks->next;
+        upstream->deallocate(chunks, chunks->size, alignof(std::max_align_t));
+        chunks = next;
+    }
+    cursor = nullptr;
+    limit = nullptr;
+}
+
+void* TurnArena::do_allocate(size_t bytes, size_t alignment) {
+    void* pointer = cursor;
+    size_t space = limit - cursor;
+    if (!cursor || !std::align(alignment, bytes, pointer, space)) {
+        addChunk(bytes + alignment);
+        pointer = cursor;
+        space = limit - cursor;
+        std::align(alignment, bytes, pointer, space);
+    }
+
+    char* end = static_cast<char*>(pointer) + bytes;
+    bytesUsed += end - cursor;
+    cursor = end;
+    peakBytes = std::max(peakBytes, bytesUsed);
+    return pointer;
+}
+
+void TurnArena::do_deallocate(void*, size_t, size_t) {
+    // Memory is only handed back all at once by reset()
+}
+
+bool TurnArena::do_is_equal(const pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+void TurnArena::reset() {
+    if (chunks && chunks->next) {
+        // The turn outgrew the first chunk: replace all of them with a single
+        // chunk that holds a whole turn
+        size_t total = 0;
+        for (Chunk* chunk = chunks; chunk; chunk = chunk->next) {
+            total += chunk->size;
+        }
+        releaseChunks();
+        chunkSize = total;
+        addChunk(0);
+    }
+    else if (chunks) {
+        cursor = reinterpret_cast<char*>(chunks + 1);
+    }
+    bytesUsed = 0;
+}
+
+size_t TurnArena::getBytesUsed() const {
+    return bytesUsed;
+}
+
+size_t TurnArena::getPeakBytes() const {
+    return peakBytes;
+}
+
+size_t TurnArena::getUpstreamAllocations() const {
+    return upstreamAllocations;
+}
+
+// WorkerPool Implementation
+WorkerPool::WorkerPool(unsigned int threadCount) :
+    task(nullptr), taskPhase(TurnPhase::OUTSIDE_TURN), taskCount(0), grainSize(1), nextIndex(0),
+    pendingWorkers(0), generation(0), stopping(false) {
+    for (unsigned int i = 0; i < threadCount; i++) {
+        workers.emplace_back(&WorkerPool::workerLoop, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stopping = true;
+    }
+    wakeWorkers.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void WorkerPool::workerLoop() {
+    insideWorkerPool = true;
+    unsigned long seenGeneration = 0;
+
+    while (true) {
+        std::unique_lock<std::mutex> lock(stateMutex);
+        wakeWorkers.wait(lock, [&] { return stopping || generation != seenGeneration; });
+        if (stopping) {
+            return;
+        }
+        seenGeneration = generation;
+        TurnPhaseScope phase(taskPhase);
+        lock.unlock();
+
+        runChunks();
+
+        lock.lock();
+        if (--pendingWorkers == 0) {
+            workDone.notify_one();
+        }
+    }
+}
+
+void WorkerPool::runChunks() {
+    while (true) {
+        size_t begin = nextIndex.fetch_add(grainSize);
+        if (begin >= taskCount) {
+            break;
+        }
+
+        try {
+            (*task)(begin, std::min(begin + grainSize, taskCount));
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            if (!failure) failure = std::current_exception();
+        }
+    }
+}
+
+void WorkerPool::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body) {
+    if (count == 0) {
+        return;
+    }
+
+    if (grain == 0) grain = 1;
+
+    // Small jobs, nested calls and calls while another job is running are done inline
+    if (workers.empty() || count <= grain || insideWorkerPool || !dispatchMutex.try_lock()) {
+        body(0, count);
+        return;
+    }
+
+    std::lock_guard<std::mutex> dispatch(dispatchMutex, std::adopt_lock);
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        task = &body;
+        taskPhase = currentTurnPhase();
+        taskCount = count;
+        grainSize = grain;
+        nextIndex = 0;
+        pendingWorkers = workers.size();
+        failure = nullptr;
+        generation++;
+    }
+    wakeWorkers.notify_all();
+
+    // The calling thread takes chunks too
+    insideWorkerPool = true;
+    runChunks();
+    insideWorkerPool = false;
+
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(stateMutex);
+        workDone.wait(lock, [&] { return pendingWorkers == 0; });
+        task = nullptr;
+        error = failure;
+        failure = nullptr;
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+unsigned int WorkerPool::getThreadCount() const {
+    return static_cast<unsigned int>(workers.size()) + 1;
+}
+
+WorkerPool& WorkerPool::shared() {
+    static WorkerPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return pool;
+}
+
+// Population Implementation
+namespace {
+    // Ten-year age bands: share of a new population, births per person per year
+    // and yearly mortality under normal conditions (about 5% births, 3% deaths)
+    const double cohortShares[AGE_COHORTS] = { 0.20, 0.18, 0.16, 0.14, 0.12, 0.09, 0.06, 0.05 };
+    const double cohortFertility[AGE_COHORTS] = { 0.0, 0.06, 0.14, 0.10, 0.02, 0.0, 0.0, 0.0 };
+    const double cohortMortality[AGE_COHORTS] = { 0.03, 0.005, 0.006, 0.01, 0.02, 0.04, 0.08, 0.2 };
+    const double cohortAgingRate = 0.1; // a tenth of each band moves up a band every year
+
+    // Class shares of a new population and per-class fertility and mortality multipliers
+    const double classShares[SOCIAL_CLASS_COUNT] = { 0.7, 0.15, 0.1, 0.05 };
+    const double classFertility[SOCIAL_CLASS_COUNT] = { 1.0, 0.9, 0.8, 0.9 };
+    const double classMortality[SOCIAL_CLASS_COUNT] = { 1.0, 0.9, 0.7, 1.2 };
+
+    // Splits total into count parts proportional to weights (largest remainder),
+    // so the parts always add up to exactly total
+    void distributeExactly(const double* weights, int count, int total, int* parts) {
+        double weightSum = 0.0;
+        for (int i = 0; i < count; i++) weightSum += weights[i];
+
+        if (total <= 0 || weightSum <= 0.0) {
+            for (int i = 0; i < count; i++) parts[i] = 0;
+            return;
+        }
+
+        double fractions[AGE_COHORTS > SOCIAL_CLASS_COUNT ? AGE_COHORTS : SOCIAL_CLASS_COUNT];
+        int assigned = 0;
+        for (int i = 0; i < count; i++) {
+            double exact = total * (weights[i] / weightSum);
+            parts[i] = static_cast<int>(exact);
+            fractions[i] = exact - parts[i];
+            assigned += parts[i];
+        }
+
+        for (; assigned < total; assigned++) {
+            int largest = 0;
+            for (int i = 1; i < count; i++) {
+                if (fractions[i] > fractions[largest]) largest = i;
+            }
+            parts[largest]++;
+            fractions[largest] = -1.0;
+        }
+    }
+
+    // out = matrix * in for one cohort vector, with the matrix stored column by column.
+    // Each column is accumulated with SIMD multiply-adds where the target has them.
+    void projectCohorts(const double* matrix, const double* in, double* out) {
+#if defined(__AVX__)
+        __m256d low = _mm256_setzero_pd();
+        __m256d high = _mm256_setzero_pd();
+        for (int j = 0; j < AGE_COHORTS; j++) {
+            __m256d n = _mm256_set1_pd(in[j]);
+            low = _mm256_add_pd(low, _mm256_mul_pd(_mm256_loadu_pd(matrix + j * AGE_COHORTS), n));
+            high = _mm256_add_pd(high, _mm256_mul_pd(_mm256_loadu_pd(matrix + j * AGE_COHORTS + 4), n));
+        }
+        _mm256_storeu_pd(out, low);
+        _mm256_storeu_pd(out + 4, high);
+#elif defined(__SSE2__) || defined(_M_X64)
+        __m128d acc[AGE_COHORTS / 2];
+        for (int i = 0; i < AGE_COHORTS / 2; i++) acc[i] = _mm_setzero_pd();
+        for (int j = 0; j < AGE_COHORTS; j++) {
+            __m128d n = _mm_set1_pd(in[j]);
+            for (int i = 0; i < AGE_COHORTS / 2; i++) {
+                acc[i] = _mm_add_pd(acc[i], _mm_mul_pd(_mm_loadu_pd(matrix + j * AGE_COHORTS + i * 2), n));
+            }
+        }
+        for (int i = 0; i < AGE_COHORTS / 2; i++) _mm_storeu_pd(out + i * 2, acc[i]);
+#else
+        for (int i = 0; i < AGE_COHORTS; i++) out[i] = 0.0;
+        for (int j = 0; j < AGE_COHORTS; j++) {
+            for (int i = 0; i < AGE_COHORTS; i++) {
+                out[i] += matrix[j * AGE_COHORTS + i] * in[j];
+            }
+        }
+#endif
+    }
+}
+
+Population::Population(int initialPopulation) :
+    totalPopulation(0),
+    happiness(50.0),
+    plagueActive(false),
+    diseaseMortality(0.0) {
+
+    // Initialize class demographics: 70% peasants, 15% merchants, 10% nobility, 5% military
+    int classTotals[SOCIAL_CLASS_COUNT];
+    distributeExactly(classShares, SOCIAL_CLASS_COUNT, std::max(0, initialPopulation), classTotals);
+
+    for (int c = 0; c < SOCIAL_CLASS_COUNT; c++) {
+        distributeExactly(cohortShares, AGE_COHORTS, classTotals[c], cohorts[c].data());
+    }
+    recountTotals();
+}
+
+void Population::recountTotals() {
+    totalPopulation = 0;
+    for (int c = 0; c < SOCIAL_CLASS_COUNT; c++) {
+        int classTotal = 0;
+        for (int count : cohorts[c]) classTotal += count;
+        classDemographics[c] = classTotal;
+        totalPopulation += classTotal;
+    }
+}
+
+void Population::update(bool hasFood, bool hasHealthcare, int jobAvailability) {
+    if (agents) {
+        agents->update(hasFood, hasHealthcare, jobAvailability, diseaseMortality);
+        syncFromAgents();
+        return;
+    }
+
+    // Extra yearly mortality from the conditions in the kingdom
+    double extraMortality = 0.0;
+    if (!hasFood) {
+        extraMortality += 0.1; // 10% die from starvation
+    }
+    if (!hasHealthcare) {
+        extraMortality += 0.05; // 5% die from disease
+    }
+    extraMortality += diseaseMortality; // deaths from the current epidemic
+
+    // Births only happen when the people are fed and cared for
+    bool births = hasFood && hasHealthcare;
+
+    // Limited job availability reduces happiness
+    if (jobAvailability < totalPopulation / 2) {
+        happiness -= 5.0;
+    }
+    else {
+        happiness += 2.0;
+    }
+
+    // Clamp happiness between 0 and 100
+    happiness = std::max(0.0, std::min(happiness, 100.0));
+
+    alignas(32) double matrix[AGE_COHORTS * AGE_COHORTS];
+    alignas(32) double current[AGE_COHORTS];
+    alignas(32) double projected[AGE_COHORTS];
+
+    for (int c = 0; c < SOCIAL_CLASS_COUNT; c++) {
+        // Build the projection matrix column by column: column j says where the
+        // people of band j are next year (survivors stay or age, newborns go to band 0)
+        for (int i = 0; i < AGE_COHORTS * AGE_COHORTS; i++) matrix[i] = 0.0;
+
+        for (int j = 0; j < AGE_COHORTS; j++) {
+            double mortality = cohortMortality[j] * classMortality[c] + extraMortality;
+            double survival = std::max(0.0, 1.0 - mortality);
+            double* column = matrix + j * AGE_COHORTS;
+
+            if (j + 1 < AGE_COHORTS) {
+                column[j] = survival * (1.0 - cohortAgingRate);
+                column[j + 1] = survival * cohortAgingRate;
+            }
+            else {
+                column[j] = survival;
+            }
+
+            if (births) {
+                column[0] += cohortFertility[j] * classFertility[c];
+            }
+
+            current[j] = cohorts[c][j];
+        }
+
+        projectCohorts(matrix, current, projected);
+
+        // Round back to whole people: the class keeps the rounded total of the
+        // projection and the bands share it by largest remainder
+        double projectedTotal = 0.0;
+        for (int i = 0; i < AGE_COHORTS; i++) {
+            projected[i] = std::max(0.0, projected[i]);
+            projectedTotal += projected[i];
+        }
+        distributeExactly(projected, AGE_COHORTS, static_cast<int>(std::min(projectedTotal, 1.0e9) + 0.5), cohorts[c].data());
+    }
+
+    recountTotals();
+}
+
+void Population::triggerPlague() {
+    plagueActive = true;
+    adjustHappiness(-30.0);
+}
+
+void Population::endPlague() {
+    plagueActive = false;
+    diseaseMortality = 0.0;
+}
+
+bool Population::isPlagueActive() const {
+    return plagueActive;
+}
+
+void Population::setDiseaseMortality(double rate) {
+    diseaseMortality = std::max(0.0, std::min(rate, 1.0));
+}
+
+bool Population::isUnhappy() const {
+    return happiness < 30.0;
+}
+
+int Population::getTotalPopulation() const {
+    return totalPopulation;
+}
+
+int Population::getClassPopulation(SocialClass socialClass) const {
+    return classDemographics[static_cast<int>(socialClass)];
+}
+
+int Population::getCohortPopulation(SocialClass socialClass, int cohort) const {
+    if (cohort < 0 || cohort >= AGE_COHORTS) {
+        return 0;
+    }
+    return cohorts[static_cast<int>(socialClass)][cohort];
+}
+
+void Population::setClassPopulation(SocialClass socialClass, int count) {
+    auto& bands = cohorts[static_cast<int>(socialClass)];
+
+    // Keep the class's age profile if it has one, otherwise use the default pyramid
+    double weights[AGE_COHORTS];
+    bool empty = true;
+    for (int i = 0; i < AGE_COHORTS; i++) {
+        weights[i] = bands[i];
+        if (bands[i] > 0) empty = false;
+    }
+    distributeExactly(empty ? cohortShares : weights, AGE_COHORTS, std::max(0, count), bands.data());
+    recountTotals();
+
+    if (agents) {
+        agents->setClassPopulation(socialClass, count);
+        syncFromAgents();
+    }
+}
+
+double Population::getHappiness() const {
+    return happiness;
+}
+
+void Population::adjustHappiness(double amount) {
+    if (agents) {
+        agents->adjustHappiness(amount);
+        happiness = agents->getHappiness();
+        return;
+    }
+
+    happiness += amount;
+    happiness = std::max(0.0, std::min(happiness, 100.0));
+}
+
+void Population::migrate(SocialClass fromClass, SocialClass toClass, int amount) {
+    if (agents) {
+        agents->migrate(fromClass, toClass, amount);
+        syncFromAgents();
+        return;
+    }
+
+    auto& source = cohorts[static_cast<int>(fromClass)];
+    auto& target = cohorts[static_cast<int>(toClass)];
+
+    if (classDemographics[static_cast<int>(fromClass)] < amount) {
+        amount = classDemographics[static_cast<int>(fromClass)];
+    }
+
+    // Migrants are drawn from every age band in proportion to its size
+    double weights[AGE_COHORTS];
+    int moved[AGE_COHORTS];
+    for (int i = 0; i < AGE_COHORTS; i++) weights[i] = source[i];
+    distributeExactly(weights, AGE_COHORTS, amount, moved);
+
+    for (int i = 0; i < AGE_COHORTS; i++) {
+        source[i] -= moved[i];
+        target[i] += moved[i];
+    }
+    recountTotals();
+}
+
+void Population::enableCitizenAgents() {
+    if (!agents) {
+        agents = std::make_unique<CitizenAgents>(cohorts, happiness);
+        syncFromAgents();
+    }
+}
+
+bool Population::hasCitizenAgents() const {
+    return agents != nullptr;
+}
+
+const CitizenAgents* Population::getCitizenAgents() const {
+    return agents.get();
+}
+
+void Population::syncFromAgents() {
+    for (int c = 0; c < SOCIAL_CLASS_COUNT; c++) {
+        for (int i = 0; i < AGE_COHORTS; i++) {
+            cohorts[c][i] = agents->getCohortPopulation(static_cast<SocialClass>(c), i);
+        }
+    }
+    recountTotals();
+    happiness = agents->getHappiness();
+}
+
+// CitizenAgents Implementation
+namespace {
+    const size_t citizenChunkSize = 1 << 16;
+
+    // Stateless hash of (citizen, turn, stream) so every draw is independent of
+    // thread scheduling and the kernels need no generator state
+    inline uint32_t citizenHash(uint32_t id, uint32_t turn, uint32_t stream) {
+        uint32_t h = id * 0x9E3779B1u ^ (turn * 0x85EBCA77u + stream * 0xC2B2AE3Du);
+        h ^= h >> 16;
+        h *= 0x7FEB352Du;
+        h ^= h >> 15;
+        h *= 0x846CA68Bu;
+        h ^= h >> 16;
+        return h;
+    }
+
+    inline float citizenUniform(uint32_t id, uint32_t turn, uint32_t stream) {
+        return (citizenHash(id, turn, stream) >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // max(x, 0) without a comparison, which keeps the kernels vectorizable
+    inline float positivePart(float x) {
+        return 0.5f * (x + std::fabs(x));
+    }
+
+    // Per-turn citizen kernels. Each is kept small and branch-free, over
+    // restrict-qualified arrays, so the compiler can vectorize it.
+    void ageCitizens(float* __restrict age, float* __restrict health, size_t count, float healthChange) {
+        for (size_t i = 0; i < count; i++) {
+            age[i] += 1.0f;
+            health[i] = std::min(1.0f, std::max(0.0f, health[i] + healthChange));
+        }
+    }
+
+    // The employed gain happiness, the idle of working age lose it
+    void employCitizens(const uint32_t* __restrict ids, const float* __restrict age, uint8_t* __restrict employed,
+        float* __restrict happiness, size_t count, uint32_t turn, float employmentRate) {
+        for (size_t i = 0; i < count; i++) {
+            float years = age[i];
+            float working = ((years >= 15.0f) & (years < 65.0f)) ? 1.0f : 0.0f;
+            float hired = citizenUniform(ids[i], turn, 1) < employmentRate ? working : 0.0f;
+            float mood = happiness[i] + hired * 2.0f - (working - hired) * 5.0f;
+            employed[i] = static_cast<uint8_t>(hired);
+            happiness[i] = std::min(100.0f, std::max(0.0f, mood));
+        }
+    }
+
+    // Fate: 0 lives on, 1 dies, 2 has a child. Mortality is high in infancy,
+    // low in the prime years and rises with old age; fertility peaks at 28.
+    void decideFates(const uint32_t* __restrict ids, const float* __restrict age, const float* __restrict health,
+        uint8_t* __restrict fate, size_t count, uint32_t turn, float extraMortality, float fertilityScale) {
+        for (size_t i = 0; i < count; i++) {
+            float years = age[i];
+            float fitness = health[i];
+            float infancy = positivePart(1.0f - years * 0.2f) * 0.03f;
+            float elderly = positivePart(years - 40.0f) * (1.0f / 40.0f);
+            float mortality = (0.005f + infancy + elderly * elderly * 0.2f) * (2.0f - fitness) + extraMortality;
+            float fertility = positivePart(1.0f - std::fabs(years - 28.0f) * (1.0f / 14.0f)) *
+                0.14f * fitness * fertilityScale;
+
+            int dies = citizenUniform(ids[i], turn, 2) < mortality;
+            int bears = (citizenUniform(ids[i], turn, 3) < fertility) & (dies ^ 1);
+            fate[i] = static_cast<uint8_t>(dies + 2 * bears);
+        }
+    }
+
+    // Births by class of the parent
+    void countBirths(const uint8_t* __restrict fate, const uint8_t* __restrict socialClass, size_t count, int* births) {
+        unsigned int peasant = 0, merchant = 0, noble = 0, soldier = 0;
+        for (size_t i = 0; i < count; i++) {
+            unsigned int bears = fate[i] >> 1;
+            unsigned int parentClass = socialClass[i];
+            peasant += bears & (parentClass == 0);
+            merchant += bears & (parentClass == 1);
+            noble += bears & (parentClass == 2);
+            soldier += bears & (parentClass == 3);
+        }
+        births[0] = static_cast<int>(peasant);
+        births[1] = static_cast<int>(merchant);
+        births[2] = static_cast<int>(noble);
+        births[3] = static_cast<int>(soldier);
+    }
+}
+
+CitizenAgents::CitizenAgents(const std::array<std::array<int, AGE_COHORTS>, SOCIAL_CLASS_COUNT>& cohorts, double mood) :
+    nextId(0), turn(0), workingAge(0), averageHappiness(mood) {
+
+    size_t total = 0;
+    for (const auto& bands : cohorts) {
+        for (int count : bands) total += count;
+    }
+    ids.reserve(total);
+    socialClass.reserve(total);
+    employed.reserve(total);
+    age.reserve(total);
+    happiness.reserve(total);
+    health.reserve(total);
+
+    for (int c = 0; c < SOCIAL_CLASS_COUNT; c++) {
+        for (int i = 0; i < AGE_COHORTS; i++) {
+            addCitizens(c, cohorts[c][i], i * 10.0f, i * 10.0f + 10.0f, static_cast<float>(mood));
+        }
+    }
+    reduce();
+}
+
+void CitizenAgents::addCitizens(int citizenClass, int count, float minAge, float maxAge, float mood) {
+    for (int i = 0; i < count; i++) {
+        uint32_t id = nextId++;
+        ids.push_back(id);
+        socialClass.push_back(static_cast<uint8_t>(citizenClass));
+        employed.push_back(0);
+        age.push_back(minAge + (maxAge - minAge) * citizenUniform(id, 0, 7));
+        happiness.push_back(mood);
+        health.push_back(1.0f);
+    }
+}
+
+void CitizenAgents::removeCitizens(int citizenClass, int count) {
+    // Remove the oldest-indexed members of the class, keeping the arrays compact
+    size_t write = 0;
+    for (size_t read = 0; read < ids.size(); read++) {
+        if (count > 0 && socialClass[read] == citizenClass) {
+            count--;
+            continue;
+        }
+        ids[write] = ids[read];
+        socialClass[write] = socialClass[read];
+        employed[write] = employed[read];
+        age[write] = age[read];
+        happiness[write] = happiness[read];
+        health[write] = health[read];
+        write++;
+    }
+    ids.resize(write);
+    socialClass.resize(write);
+    employed.resize(write);
+    age.resize(write);
+    happiness.resize(write);
+    health.resize(write);
+}
+
+void CitizenAgents::update(bool hasFood, bool hasHealthcare, int jobAvailability, double diseaseMortality) {
+    turn++;
+
+    const size_t count = ids.size();
+    const size_t chunks = (count + citizenChunkSize - 1) / citizenChunkSize;
+    chunkTotals.resize(chunks);
+    fate.resize(count);
+
+    // Conditions shared by every citizen this turn
+    const float healthChange = (hasFood ? 0.02f : -0.15f) + (hasHealthcare ? 0.01f : -0.05f);
+    const float extraMortality = (hasFood ? 0.0f : 0.1f) + (hasHealthcare ? 0.0f : 0.05f) +
+        static_cast<float>(diseaseMortality);
+    const float fertilityScale = (hasFood && hasHealthcare) ? 1.0f : 0.0f;
+    const float employmentRate = workingAge > 0 ?
+        std::min(1.0f, static_cast<float>(jobAvailability) / workingAge) : 1.0f;
+    const uint32_t currentTurn = turn;
+
+    // Each chunk's survivors and totals stay in that chunk's slot, whether
+    // the pool runs the chunks in parallel or hands all of them over at once
+    auto updateChunk = [&](size_t begin, size_t end) {
+        ChunkTotals& totals = chunkTotals[begin / citizenChunkSize];
+
+        const size_t length = end - begin;
+        int births[SOCIAL_CLASS_COUNT];
+        ageCitizens(age.data() + begin, health.data() + begin, length, healthChange);
+        employCitizens(ids.data() + begin, age.data() + begin, employed.data() + begin,
+            happiness.data() + begin, length, currentTurn, employmentRate);
+        decideFates(ids.data() + begin, age.data() + begin, health.data() + begin, fate.data() + begin,
+            length, currentTurn, extraMortality, fertilityScale);
+        countBirths(fate.data() + begin, socialClass.data() + begin, length, births);
+
+        // Compact the survivors to the front of the chunk and reduce the aggregates
+        size_t write = begin;
+        int workers = 0;
+        double moodSum = 0.0;
+        int bands[SOCIAL_CLASS_COUNT][AGE_COHORTS] = {};
+        for (size_t i = begin; i < end; i++) {
+            if (fate[i] == 1) {
+                continue;
+            }
+            ids[write] = ids[i];
+            socialClass[write] = socialClass[i];
+            employed[write] = employed[i];
+            age[write] = age[i];
+            happiness[write] = happiness[i];
+            health[write] = health[i];
+
+            int band = std::min(AGE_COHORTS - 1, static_cast<int>(age[write] * 0.1f));
+            bands[socialClass[write]][band]++;
+            workers += (age[write] >= 15.0f && age[write] < 65.0f) ? 1 : 0;
+            moodSum += happiness[write];
+            write++;
+        }
+
+        totals.survivors = write - begin;
+        totals.workingAge = workers;
+        totals.happinessSum = moodSum;
+        for (int c = 0; c < SOCIAL_CLASS_COUNT; c++) {
+            totals.births[c] = births[c];
+            for (int b = 0; b < AGE_COHORTS; b++) {
+                totals.cohortCounts[c][b] = bands[c][b];
+            }
+        }
+    };
+    WorkerPool::shared().parallelFor(count, citizenChunkSize, [&](size_t begin, size_t end) {
+        for (size_t chunk = begin; chunk < end; chunk += citizenChunkSize) {
+            updateChunk(chunk, std::min(chunk + citizenChunkSize, end));
+        }
+        });
+
+    // Close the gaps between chunks and combine the partial results
+    size_t write = 0;
+    double moodSum = 0.0;
+    int newborns[SOCIAL_CLASS_COUNT] = { 0, 0, 0, 0 };
+    workingAge = 0;
+    for (auto& bands : cohortCounts) bands.fill(0);
+
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+        const ChunkTotals& totals = chunkTotals[chunk];
+        size_t begin = chunk * citizenChunkSize;
+        if (write != begin) {
+            std::copy(ids.begin() + begin, ids.begin() + begin + totals.survivors, ids.begin() + write);
+            std::copy(socialClass.begin() + begin, socialClass.begin() + begin + totals.survivors, socialClass.begin() + write);
+            std::copy(employed.begin() + begin, employed.begin() + begin + totals.survivors, employed.begin() + write);
+            std::copy(age.begin() + begin, age.begin() + begin + totals.survivors, age.begin() + write);
+            std::copy(happiness.begin() + begin, happiness.begin() + begin + totals.survivors, happiness.begin() + write);
+            std::copy(health.begin() + begin, health.begin() + begin + totals.survivors, health.begin() + write);
+        }
+        write += totals.survivors;
+
+        moodSum += totals.happinessSum;
+        workingAge += totals.workingAge;
+        for (int c = 0; c < SOCIAL_CLASS_COUNT; c++) {
+            newborns[c] += totals.births[c];
+            for (int b = 0; b < AGE_COHORTS; b++) {
+                cohortCounts[c][b] += totals.cohortCounts[c][b];
+            }
+        }
+    }
+
+    ids.resize(write);
+    socialClass.resize(write);
+    employed.resize(write);
+    age.resize(write);
+    happiness.resize(write);
+    health.resize(write);
+
+    // Newborns join their parents' class in the youngest band
+    float mood = write > 0 ? static_cast<float>(moodSum / write) : static_cast<float>(averageHappiness);
+    for (int c = 0; c < SOCIAL_CLASS_COUNT; c++) {
+        addCitizens(c, newborns[c], 0.0f, 0.0f, mood);
+        cohortCounts[c][0] += newborns[c];
+        moodSum += static_cast<double>(mood) * newborns[c];
+    }
+
+    for (int c = 0; c < SOCIAL_CLASS_COUNT; c++) {
+        classCounts[c] = 0;
+        for (int count : cohortCounts[c]) classCounts[c] += count;
+    }
+    averageHappiness = ids.empty() ? averageHappiness : moodSum / ids.size();
+}
+
+void CitizenAgents::reduce() {
+    const size_t count = ids.size();
+    const size_t chunks = (count + citizenChunkSize - 1) / citizenChunkSize;
+    chunkTotals.resize(chunks);
+
+    auto reduceChunk = [&](size_t begin, size_t end) {
+        ChunkTotals& totals = chunkTotals[begin / citizenChunkSize];
+        int bands[SOCIAL_CLASS_COUNT][AGE_COHORTS] = {};
+        int workers = 0;
+        double moodSum = 0.0;
+        for (size_t i = begin; i < end; i++) {
+            int band = std::min(AGE_COHORTS - 1, static_cast<int>(age[i] * 0.1f));
+            bands[socialClass[i]][band]++;
+            workers += (age[i] >= 15.0f && age[i] < 65.0f) ? 1 : 0;
+            moodSum += happiness[i];
+        }
+        totals.workingAge = workers;
+        totals.happinessSum = moodSum;
+        for (int c = 0; c < SOCIAL_CLASS_COUNT; c++) {
+            for (int b = 0; b < AGE_COHORTS; b++) {
+                totals.cohortCounts[c][b] = bands[c][b];
+            }
+        }
+    };
+    WorkerPool::shared().parallelFor(count, citizenChunkSize, [&](size_t begin, size_t end) {
+        for (size_t chunk = begin; chunk < end; chunk += citizenChunkSize) {
+            reduceChunk(chunk, std::min(chunk + citizenChunkSize, end));
+        }
+        });
+
+    double moodSum = 0.0;
+    workingAge = 0;
+    for (auto& bands : cohortCounts) bands.fill(0);
+    for (const ChunkTotals& totals : chunkTotals) {
+        moodSum += totals.happinessSum;
+        workingAge += totals.workingAge;
+        for (int c = 0; c < SOCIAL_CLASS_COUNT; c++) {
+            for (int b = 0; b < AGE_COHORTS; b++) {
+                cohortCounts[c][b] += totals.cohortCounts[c][b];
+            }
+        }
+    }
+
+    for (int c = 0; c < SOCIAL_CLASS_COUNT; c++) {
+        classCounts[c] = 0;
+        for (int count : cohortCounts[c]) classCounts[c] += count;
+    }
+    if (count > 0) {
+        averageHappiness = moodSum / count;
+    }
+}
+
+void CitizenAgents::adjustHappiness(double amount) {
+    const float shift = static_cast<float>(amount);
+    float* __restrict data = happiness.data();
+    const size_t count = happiness.size();
+    for (size_t i = 0; i < count; i++) {
+        data[i] = std::min(100.0f, std::max(0.0f, data[i] + shift));
+    }
+    reduce();
+}
+
+void CitizenAgents::migrate(SocialClass fromClass, SocialClass toClass, int amount) {
+    // Working-age citizens move first, as they are the ones recruited or promoted
+    uint8_t from = static_cast<uint8_t>(fromClass);
+    uint8_t to = static_cast<uint8_t>(toClass);
+    for (int pass = 0; pass < 2 && amount > 0; pass++) {
+        for (size_t i = 0; i < ids.size() && amount > 0; i++) {
+            bool working = age[i] >= 15.0f && age[i] < 65.0f;
+            if (socialClass[i] == from && (pass == 1 || working)) {
+                socialClass[i] = to;
+                amount--;
+            }
+        }
+    }
+    reduce();
+}
+
+void CitizenAgents::setClassPopulation(SocialClass citizenClass, int count) {
+    int index = static_cast<int>(citizenClass);
+    int current = classCounts[index];
+    if (count > current) {
+        addCitizens(index, count - current, 0.0f, 70.0f, static_cast<float>(averageHappiness));
+    }
+    else if (count < current) {
+        removeCitizens(index, current - count);
+    }
+    reduce();
+}
+
+size_t CitizenAgents::size() const {
+    return ids.size();
+}
+
+int CitizenAgents::getClassPopulation(SocialClass citizenClass) const {
+    return classCounts[static_cast<int>(citizenClass)];
+}
+
+int CitizenAgents::getCohortPopulation(SocialClass citizenClass, int cohort) const {
+    return cohortCounts[static_cast<int>(citizenClass)][cohort];
+}
+
+double CitizenAgents::getHappiness() const {
+    return averageHappiness;
+}
+
+// Epidemic Implementation
+namespace {
+    // Yearly rates of the compartment flows
+    const double epidemicTransmission = 2.5;    // contacts that pass the disease on
+    const double epidemicIncubation = 0.7;      // exposed who fall ill
+    const double epidemicRecovery = 0.5;        // infected who recover
+    const double epidemicCareRecovery = 0.6;    // extra recovery with full healthcare
+    const double epidemicMortality = 0.15;      // infected who die
+    const double epidemicCareProtection = 0.6;  // share of deaths prevented by full healthcare
+    const double epidemicBurnout = 1.0e-4;      // share below which the disease disappears
+    const size_t epidemicGrainSize = 4096;
+
+    // Force of infection of each region: its own infected share plus the
+    // shares of linked regions, weighted by how much contact they have
+    void infectionPressure(const uint32_t* __restrict rowStart, const uint32_t* __restrict linkTarget,
+        const double* __restrict linkWeight, const double* __restrict contactTotal,
+        const double* __restrict infected, double* __restrict force, size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            double pressure = infected[k];
+            for (uint32_t l = rowStart[k]; l < rowStart[k + 1]; l++) {
+                pressure += linkWeight[l] * infected[linkTarget[l]];
+            }
+            force[k] = std::min(1.0, epidemicTransmission * pressure / contactTotal[k]);
+        }
+    }
+
+    // One year of compartment flows. The dead leave the region, so the
+    // remaining shares are scaled back up to sum to one.
+    void advanceCompartments(double* __restrict susceptible, double* __restrict exposed,
+        double* __restrict infected, double* __restrict recovered, double* __restrict mortality,
+        const double* __restrict force, const double* __restrict healthcare, size_t count) {
+        for (size_t k = 0; k < count; k++) {
+            double care = healthcare[k];
+            double newCases = force[k] * susceptible[k];
+            double onset = epidemicIncubation * exposed[k];
+            double recoveries = epidemicRecovery * (1.0 + epidemicCareRecovery * care) * infected[k];
+            double deaths = epidemicMortality * (1.0 - epidemicCareProtection * care) * infected[k];
+
+            double nextExposed = exposed[k] + newCases - onset;
+            double nextInfected = infected[k] + onset - recoveries - deaths;
+
+            // Burnout: too few carriers left, the remainder recovers
+            bool burnedOut = nextInfected + nextExposed < epidemicBurnout;
+            double cleared = burnedOut ? nextInfected + nextExposed : 0.0;
+            nextExposed = burnedOut ? 0.0 : nextExposed;
+            nextInfected = burnedOut ? 0.0 : nextInfected;
+
+            double scale = 1.0 / (1.0 - deaths);
+            susceptible[k] = (susceptible[k] - newCases) * scale;
+            exposed[k] = nextExposed * scale;
+            infected[k] = nextInfected * scale;
+            recovered[k] = (recovered[k] + recoveries + cleared) * scale;
+            mortality[k] = deaths;
+        }
+    }
+}
+
+Epidemic::Epidemic(size_t regionCount) : linksChanged(true), activeRegions(0) {
+    for (size_t i = 0; i < regionCount; i++) {
+        addRegion();
+    }
+}
+
+size_t Epidemic::addRegion() {
+    susceptible.push_back(1.0);
+    exposed.push_back(0.0);
+    infected.push_back(0.0);
+    recovered.push_back(0.0);
+    healthcare.push_back(0.0);
+    mortality.push_back(0.0);
+    force.push_back(0.0);
+    linksChanged = true;
+    return susceptible.size() - 1;
+}
+
+void Epidemic::addLink(size_t first, size_t second, double weight) {
+    if (first >= getRegionCount() || second >= getRegionCount() || first == second) {
+        throw GameException("Invalid epidemic link between regions " + to_string(first) + " and " + to_string(second));
+    }
+    if (weight <= 0.0) {
+        return;
+    }
+    links.push_back({ static_cast<uint32_t>(first), static_cast<uint32_t>(second), weight });
+    links.push_back({ static_cast<uint32_t>(second), static_cast<uint32_t>(first), weight });
+    linksChanged = true;
+}
+
+void Epidemic::setHealthcare(size_t region, double level) {
+    healthcare.at(region) = std::max(0.0, std::min(level, 1.0));
+}
+
+void Epidemic::seed(size_t region, double share) {
+    share = std::max(0.0, std::min(share, susceptible.at(region)));
+    if (share <= 0.0) {
+        return;
+    }
+    susceptible[region] -= share;
+    infected[region] += share;
+    activeRegions = std::max<size_t>(activeRegions, 1);
+}
+
+void Epidemic::packLinks() {
+    const size_t regions = getRegionCount();
+    rowStart.assign(regions + 1, 0);
+    for (const Link& link : links) {
+        rowStart[link.from + 1]++;
+    }
+    for (size_t k = 0; k < regions; k++) {
+        rowStart[k + 1] += rowStart[k];
+    }
+
+    linkTarget.resize(links.size());
+    linkWeight.resize(links.size());
+    contactTotal.assign(regions, 1.0);
+    vector<uint32_t> fill(rowStart.begin(), rowStart.end() - 1);
+    for (const Link& link : links) {
+        uint32_t slot = fill[link.from]++;
+        linkTarget[slot] = link.to;
+        linkWeight[slot] = link.weight;
+        contactTotal[link.from] += link.weight;
+    }
+    linksChanged = false;
+}
+
+void Epidemic::step() {
+    const size_t regions = getRegionCount();
+    if (activeRegions == 0) {
+        std::fill(mortality.begin(), mortality.end(), 0.0);
+        return;
+    }
+    if (linksChanged) {
+        packLinks();
+    }
+
+    // Pressure reads every region's infected share, so it is finished for
+    // all regions before any of them advances
+    WorkerPool::shared().parallelFor(regions, epidemicGrainSize, [&](size_t begin, size_t end) {
+        infectionPressure(rowStart.data(), linkTarget.data(), linkWeight.data(), contactTotal.data(),
+            infected.data(), force.data(), begin, end);
+    });
+    WorkerPool::shared().parallelFor(regions, epidemicGrainSize, [&](size_t begin, size_t end) {
+        advanceCompartments(susceptible.data() + begin, exposed.data() + begin, infected.data() + begin,
+            recovered.data() + begin, mortality.data() + begin, force.data() + begin,
+            healthcare.data() + begin, end - begin);
+    });
+
+    activeRegions = 0;
+    for (size_t k = 0; k < regions; k++) {
+        activeRegions += infected[k] + exposed[k] > 0.0;
+    }
+}
+
+bool Epidemic::isActive() const {
+    return activeRegions > 0;
+}
+
+size_t Epidemic::getRegionCount() const {
+    return susceptible.size();
+}
+
+double Epidemic::getInfected(size_t region) const {
+    return infected.at(region);
+}
+
+double Epidemic::getMortality(size_t region) const {
+    return mortality.at(region);
+}
+
+// Province Implementation
+Province::Province(const Name& name, int initialPopulation, size_t epidemicRegion) :
+    name(name), population(initialPopulation), unrest(0), starving(false), epidemicRegion(epidemicRegion) {
+    stores.fill(0);
+    setStore(ProvinceStore::FOOD, initialPopulation / 5);
+}
+
+void Province::update(double diseaseMortality) {
+    int people = population.getTotalPopulation();
+    int peasants = population.getClassPopulation(SocialClass::PEASANT);
+    int& food = stores[static_cast<int>(ProvinceStore::FOOD)];
+
+    // Peasants work the fields, forests and mines; stores hold about two years' worth
+    food += peasants * 3 / 20;
+    stores[static_cast<int>(ProvinceStore::WOOD)] += peasants / 50;
+    stores[static_cast<int>(ProvinceStore::STONE)] += peasants / 100;
+    stores[static_cast<int>(ProvinceStore::IRON)] += peasants / 200;
+    int capacity = std::max(100, people * 2);
+    for (int& amount : stores) {
+        amount = std::min(amount, capacity);
+    }
+
+    int foodNeeded = people / 10;
+    starving = food < foodNeeded;
+    bool hasHealthcare = food > 0;
+    food -= std::min(food, foodNeeded);
+
+    population.setDiseaseMortality(diseaseMortality);
+    population.update(!starving, hasHealthcare, people / 2);
+
+    // Hunger and misery breed unrest; content provinces calm down
+    if (starving) {
+        population.adjustHappiness(-10.0);
+        unrest += 10;
+    }
+    else if (population.isUnhappy()) {
+        unrest += 5;
+    }
+    else {
+        unrest -= 5;
+    }
+    unrest = std::max(0, std::min(unrest, 100));
+}
+
+std::string_view Province::getName() const {
+    return name.view();
+}
+
+Population& Province::getPopulation() {
+    return population;
+}
+
+const Population& Province::getPopulation() const {
+    return population;
+}
+
+int Province::getStore(ProvinceStore store) const {
+    return stores[static_cast<int>(store)];
+}
+
+void Province::setStore(ProvinceStore store, int amount) {
+    stores[static_cast<int>(store)] = std::max(0, amount);
+}
+
+int Province::getUnrest() const {
+    return unrest;
+}
+
+void Province::setUnrest(int level) {
+    unrest = std::max(0, std::min(level, 100));
+}
+
+bool Province::isStarving() const {
+    return starving;
+}
+
+bool Province::isRestless() const {
+    return unrest >= 50;
+}
+
+size_t Province::getEpidemicRegion() const {
+    return epidemicRegion;
+}
+
+// BuildingTable Implementation
+namespace {
+    const BuildingRecipe buildingRecipes[BUILDING_TYPE_COUNT] = {
+        // name       wood stone gold turns workers input    in  output     out
+        { "farm",     20,  0,    5,   2,    10,     nullptr, 0,  "food",    40 },
+        { "sawmill",  10,  5,    5,   2,    5,      nullptr, 0,  "wood",    20 },
+        { "quarry",   30,  0,    10,  3,    8,      nullptr, 0,  "stone",   10 },
+        { "mine",     40,  20,   20,  4,    10,     nullptr, 0,  "iron",    8 },
+        { "smithy",   30,  40,   30,  3,    4,      "iron",  2,  "weapons", 1 }
+    };
+}
+
+const BuildingRecipe& std::getBuildingRecipe(BuildingType type) {
+    return buildingRecipes[static_cast<int>(type)];
+}
+
+bool std::parseBuildingType(const std::string& name, BuildingType& type) {
+    for (int t = 0; t < BUILDING_TYPE_COUNT; t++) {
+        if (name == buildingRecipes[t].name) {
+            type = static_cast<BuildingType>(t);
+            return true;
+        }
+    }
+    return false;
+}
+
+void BuildingTable::add(BuildingType type, uint32_t location) {
+    types.push_back(static_cast<uint8_t>(type));
+    locations.push_back(location);
+}
+
+void BuildingTable::clear() {
+    types.clear();
+    locations.clear();
+}
+
+size_t BuildingTable::size() const {
+    return types.size();
+}
+
+int BuildingTable::count(BuildingType type) const {
+    return static_cast<int>(std::count(types.begin(), types.end(), static_cast<uint8_t>(type)));
+}
+
+BuildingType BuildingTable::getType(size_t index) const {
+    return static_cast<BuildingType>(types.at(index));
+}
+
+uint32_t BuildingTable::getLocation(size_t index) const {
+    return locations.at(index);
+}
+
+array<double, BUILDING_TYPE_COUNT> BuildingTable::staffedCapacity(const int* workforce, size_t locationCount) {
+    const size_t count = types.size();
+    float workersNeeded[BUILDING_TYPE_COUNT];
+    for (int t = 0; t < BUILDING_TYPE_COUNT; t++) {
+        workersNeeded[t] = static_cast<float>(buildingRecipes[t].workers);
+    }
+
+    // First pass: how many hands the buildings of every location ask for
+    demand.assign(locationCount, 0.0f);
+    for (size_t i = 0; i < count; i++) {
+        demand[locations[i]] += workersNeeded[types[i]];
+    }
+
+    // A location short of peasants staffs all of its buildings partially
+    staffing.resize(locationCount);
+    for (size_t l = 0; l < locationCount; l++) {
+        staffing[l] = demand[l] > 0.0f ? std::min(1.0f, workforce[l] / demand[l]) : 0.0f;
+    }
+
+    // Second pass: staffed buildings per type
+    double capacity[BUILDING_TYPE_COUNT] = {};
+    for (size_t i = 0; i < count; i++) {
+        capacity[types[i]] += staffing[locations[i]];
+    }
+
+    array<double, BUILDING_TYPE_COUNT> result;
+    std::copy(capacity, capacity + BUILDING_TYPE_COUNT, result.begin());
+    return result;
+}
+
+// ConstructionQueue Implementation
+namespace {
+    // Heap order: the job finishing last sinks, ties go to the job queued first
+    bool finishesLater(const ConstructionQueue::Job& a, const ConstructionQueue::Job& b) {
+        if (a.completionTurn != b.completionTurn) {
+            return a.completionTurn > b.completionTurn;
+        }
+        return a.sequence > b.sequence;
+    }
+}
+
+ConstructionQueue::ConstructionQueue() :
+    nextSequence(0), reservedWood(0), reservedStone(0), reservedGold(0) {
+}
+
+void ConstructionQueue::reserve(BuildingType type, int sign) {
+    const BuildingRecipe& recipe = getBuildingRecipe(type);
+    reservedWood += sign * recipe.woodCost;
+    reservedStone += sign * recipe.stoneCost;
+    reservedGold += sign * recipe.goldCost;
+}
+
+void ConstructionQueue::enqueue(BuildingType type, uint32_t location, int completionTurn) {
+    jobs.push_back({ completionTurn, nextSequence++, static_cast<uint8_t>(type), location });
+    std::push_heap(jobs.begin(), jobs.end(), finishesLater);
+    reserve(type, 1);
+}
+
+bool ConstructionQueue::cancel(BuildingType type, uint32_t location) {
+    auto latest = jobs.end();
+    for (auto job = jobs.begin(); job != jobs.end(); ++job) {
+        if (job->type == static_cast<uint8_t>(type) && job->location == location &&
+            (latest == jobs.end() || job->sequence > latest->sequence)) {
+            latest = job;
+        }
+    }
+    if (latest == jobs.end()) {
+        return false;
+    }
+
+    *latest = jobs.back();
+    jobs.pop_back();
+    std::make_heap(jobs.begin(), jobs.end(), finishesLater);
+    reserve(type, -1);
+    return true;
+}
+
+int ConstructionQueue::completeUntil(int turn, BuildingTable& buildings) {
+    int completed = 0;
+    while (!jobs.empty() && jobs.front().completionTurn <= turn) {
+        std::pop_heap(jobs.begin(), jobs.end(), finishesLater);
+        const Job& job = jobs.back();
+        buildings.add(static_cast<BuildingType>(job.type), job.location);
+        reserve(static_cast<BuildingType>(job.type), -1);
+        jobs.pop_back();
+        completed++;
+    }
+    return completed;
+}
+
+void ConstructionQueue::clear() {
+    jobs.clear();
+    reservedWood = 0;
+    reservedStone = 0;
+    reservedGold = 0;
+}
+
+size_t ConstructionQueue::size() const {
+    return jobs.size();
+}
+
+int ConstructionQueue::pending(BuildingType type) const {
+    int count = 0;
+    for (const Job& job : jobs) {
+        count += job.type == static_cast<uint8_t>(type);
+    }
+    return count;
+}
+
+int ConstructionQueue::getNextCompletion() const {
+    return jobs.empty() ? 0 : jobs.front().completionTurn;
+}
+
+int ConstructionQueue::getReservedWood() const {
+    return reservedWood;
+}
+
+int ConstructionQueue::getReservedStone() const {
+    return reservedStone;
+}
+
+int ConstructionQueue::getReservedGold() const {
+    return reservedGold;
+}
+
+const vector<ConstructionQueue::Job>& ConstructionQueue::getJobs() const {
+    return jobs;
+}
+
+std::vector<ConstructionQueue::Job> ConstructionQueue::getJobsInOrder() const {
+    std::vector<Job> ordered = jobs;
+    std::sort(ordered.begin(), ordered.end(), [](const Job& a, const Job& b) { return finishesLater(b, a); });
+    return ordered;
+}
+
+// Leader Implementation
+Leader::Leader(const Name& name, int influence, int corruption, int leadership) :
+    name(name), influence(influence), corruption(corruption), leadership(leadership) {}
+
+std::string_view Leader::getName() const {
+    return name.view();
+}
+
+const Name& Leader::getNameHandle() const {
+    return name;
+}
+
+int Leader::getInfluence() const {
+    return influence;
+}
+
+int Leader::getCorruption() const {
+    return corruption;
+}
+
+int Leader::getLeadership() const {
+    return leadership;
+}
+
+// King Implementation
+namespace {
+    const Name benevolentStyle("Benevolent");
+    const Name militaristicStyle("Militaristic");
+    const Name economicStyle("Economic");
+}
+
+King::King(const Name& name, int influence, int corruption, int leadership, const Name& style) :
+    Leader(name, influence, corruption, leadership),
+    reignYears(0), popularity(50), leadershipStyle(style), followsPolicy(false) {}
+
+void King::makeDecision(Kingdom& kingdom) {
+    // King's decision logic based on leadership style
+    if (leadershipStyle == benevolentStyle) {
+        // Benevolent kings focus on population happiness
+        kingdom.getPopulation().adjustHappiness(5.0);
+    }
+    else if (leadershipStyle == militaristicStyle) {
+        // Militaristic kings focus on army strength
+        if (kingdom.getArmy()) {
+            kingdom.getArmy()->train(1);
+        }
+    }
+    else if (leadershipStyle == economicStyle) {
+        // Economic kings focus on treasury
+        if (kingdom.getBank()) {
+            kingdom.getBank()->deposit(100 * leadership);
+        }
+    }
+
+    // Corrupt kings will steal from treasury
+    if (kingdom.getBank() && corruption > 50) {
+        double stolenAmount = kingdom.getBank()->getTreasury() * (corruption * 0.01) * 0.1;
+        if (stolenAmount > 0) {
+            kingdom.getBank()->withdraw(stolenAmount);
+        }
+    }
+
+    if (followsPolicy) {
+        applyPolicy(kingdom);
+    }
+}
+
+void King::applyPolicy(Kingdom& kingdom) {
+    Population& population = kingdom.getPopulation();
+    Bank* bank = kingdom.getBank();
+    Army* army = kingdom.getArmy();
+    Market* market = kingdom.getMarket();
+    int people = population.getTotalPopulation();
+
+    if (!bank) {
+        return;
+    }
+
+    // Tax according to the mood of the people
+    double happiness = population.getHappiness();
+    double taxRate = policy.get(RulerPolicy::HIGH_MOOD_TAX);
+    if (happiness < 40.0) {
+        taxRate = policy.get(RulerPolicy::LOW_MOOD_TAX);
+    }
+    else if (happiness < 70.0) {
+        taxRate = policy.get(RulerPolicy::MID_MOOD_TAX);
+    }
+    if (taxRate > 0.0 && people > 0) {
+        kingdom.collectTaxes(taxRate);
+    }
+
+    // Keep the granary stocked for the configured number of turns
+    Resource<int>* food = kingdom.getResource("food");
+    if (food && market && market->getIsOpen()) {
+        int wanted = static_cast<int>(people / 10 * policy.get(RulerPolicy::FOOD_RESERVE));
+        int shortfall = std::min(wanted, food->getMaxQuantity()) - food->getQuantity();
+        if (shortfall > 0 && market->getResourcePrice("food") * shortfall < bank->getTreasury()) {
+            market->buyResource("food", shortfall, *bank);
+            food->addQuantity(shortfall);
+        }
+    }
+
+    if (army) {
+        // Recruit towards the target army size, within the 20% recruitment limit
+        int target = static_cast<int>(people * policy.get(RulerPolicy::ARMY_SHARE));
+        int recruits = std::min(target - army->getSize(), static_cast<int>(people * 0.2));
+        recruits = std::min(recruits, population.getClassPopulation(SocialClass::PEASANT));
+        if (recruits > 0) {
+            army->recruit(recruits, people);
+            population.migrate(SocialClass::PEASANT, SocialClass::MILITARY, recruits);
+        }
+
+        if (policy.get(RulerPolicy::PAY_ARMY) > 0.5) {
+            double cost = army->getMaintenanceCost();
+            if (cost > 0 && bank->withdraw(cost)) {
+                army->payMaintenance(cost);
+            }
+        }
+    }
+
+    // Borrow when the treasury runs low and repay once it has recovered
+    double treasury = bank->getTreasury();
+    if (bank->getLoanAmount() <= 0) {
+        if (treasury < policy.get(RulerPolicy::BORROW_BELOW)) {
+            bank->getLoan(policy.get(RulerPolicy::LOAN_AMOUNT), 0.1, 10);
+        }
+    }
+    else if (treasury > policy.get(RulerPolicy::REPAY_ABOVE)) {
+        double repayment = std::min(bank->getLoanAmount(), treasury - policy.get(RulerPolicy::REPAY_ABOVE));
+        if (repayment > 0) {
+            bank->repayLoan(repayment);
+        }
+    }
+
+    if (bank->getCorruptionLevel() >= policy.get(RulerPolicy::AUDIT_AT)) {
+        bank->audit();
+    }
+}
+
+std::string_view King::getTitle() const {
+    return "King";
+}
+
+void King::setTaxRate(double rate) {
+    // Implementation depends on Kingdom class integration
+}
+
+void King::declareWar(Kingdom& targetKingdom) {
+    // Implementation depends on Kingdom class integration
+}
+
+bool King::canBeBribes(int goldAmount) const {
+    return goldAmount > (100 - corruption) * 10;
+}
+
+void King::setPolicy(const RulerPolicy& newPolicy) {
+    policy = newPolicy;
+    policy.clamp();
+    followsPolicy = true;
+}
+
+const RulerPolicy* King::getPolicy() const {
+    return followsPolicy ? &policy : nullptr;
+}
+
+// RulerPolicy Implementation
+namespace {
+    // Lower and upper bounds for every gene, in RulerPolicy::Gene order
+    const double policyGeneBounds[RulerPolicy::GENE_COUNT][2] = {
+        { 0.0, 1.0 },       // LOW_MOOD_TAX
+        { 0.0, 1.0 },       // MID_MOOD_TAX
+        { 0.0, 1.0 },       // HIGH_MOOD_TAX
+        { 0.0, 0.3 },       // ARMY_SHARE
+        { 0.0, 1.0 },       // PAY_ARMY
+        { 0.0, 10.0 },      // FOOD_RESERVE
+        { 0.0, 2000.0 },    // BORROW_BELOW
+        { 1.0, 10000.0 },   // LOAN_AMOUNT
+        { 0.0, 20000.0 },   // REPAY_ABOVE
+        { 0.0, 100.0 }      // AUDIT_AT
+    };
+}
+
+RulerPolicy::RulerPolicy() {
+    // A cautious ruler: moderate taxes, a small paid army and no borrowing
+    genes[LOW_MOOD_TAX] = 0.1;
+    genes[MID_MOOD_TAX] = 0.3;
+    genes[HIGH_MOOD_TAX] = 0.5;
+    genes[ARMY_SHARE] = 0.05;
+    genes[PAY_ARMY] = 1.0;
+    genes[FOOD_RESERVE] = 2.0;
+    genes[BORROW_BELOW] = 0.0;
+    genes[LOAN_AMOUNT] = 500.0;
+    genes[REPAY_ABOVE] = 2000.0;
+    genes[AUDIT_AT] = 50.0;
+}
+
+void RulerPolicy::clamp() {
+    for (int i = 0; i < GENE_COUNT; i++) {
+        genes[i] = std::max(minValue(i), std::min(genes[i], maxValue(i)));
+    }
+}
+
+double RulerPolicy::minValue(int gene) {
+    return policyGeneBounds[gene][0];
+}
+
+double RulerPolicy::maxValue(int gene) {
+    return policyGeneBounds[gene][1];
+}
+
+// Commander Implementation
+Commander::Commander(const Name& name, int influence, int corruption, int leadership,
+    int experience, int strategy, bool loyalty) :
+    Leader(name, influence, corruption, leadership),
+    battleExperience(experience), strategySkill(strategy), loyal(loyalty) {}
+
+void Commander::makeDecision(Kingdom& kingdom) {
+    // Commander's decision logic
+    if (!loyal && corruption > 70) {
+        // Disloyal commanders might plan coup
+        gameOutput() << getName() << " is plotting against the king!\n";
+        // Coup logic would be implemented in full game
+    }
+
+    // Boost army training based on experience
+    if (kingdom.getArmy()) {
+        int trainingBonus = battleExperience / 10;
+        // Implement bonus to army
+    }
+}
+
+std::string_view Commander::getTitle() const {
+    return "Commander";
+}
+
+bool Commander::isLoyal() const {
+    return loyal;
+}
+
+int Commander::getStrategyBonus() const {
+    return strategySkill;
+}
+
+// MerchantGuildLeader Implementation
+MerchantGuildLeader::MerchantGuildLeader(const Name& name, int influence, int corruption, int leadership, double bonus) :
+    Leader(name, influence, corruption, leadership), tradingBonus(bonus) {}
+
+void MerchantGuildLeader::makeDecision(Kingdom& kingdom) {
+    // Merchant's decision logic
+    if (kingdom.getMarket()) {
+        // Apply trading bonuses
+    }
+
+    // Corrupt merchant leaders might manipulate prices
+    if (corruption > 60) {
+        // Price manipulation logic
+    }
+}
+
+std::string_view MerchantGuildLeader::getTitle() const {
+    return "Merchant Guild Leader";
+}
+
+void MerchantGuildLeader::addTradeConnection(const Name& connection) {
+    tradeConnections.push_back(connection);
+}
+
+double MerchantGuildLeader::getTradingBonus() const {
+    return tradingBonus;
+}
+
+// Army Implementation
+Army::Army(int initialSize) :
+    size(initialSize), trainingLevel(1), morale(50),
+    maintenanceCost(initialSize * 2.0), isPaid(true) {}
+
+Army::~Army() {}
+
+void Army::recruit(int count, int populationSize) {
+    if (count <= 0) {
+        throw GameException("Cannot recruit a negative or zero number of soldiers");
+    }
+
+    if (count > populationSize * 0.2) {
+        throw GameException("Cannot recruit more than 20% of the population");
+    }
+
+    // Simulating training time
+    gameOutput() << "Training recruits";
+    for (int i = 0; i < 3; i++) {
+        gameOutput() << ".";
+        gameDelay(1);
+    }
+    gameOutput() << " Done!" << endl;
+
+    enlist(count);
+}
+
+void Army::enlist(int count) {
+    size += count;
+    maintenanceCost = size * 2.0;
+}
+
+void Army::train(int duration) {
+    if (duration <= 0) {
+        throw GameException("Training duration must be positive");
+    }
+
+    gameOutput() << "Training army";
+    for (int i = 0; i < duration; i++) {
+        gameOutput() << ".";
+        gameDelay(1);
+    }
+    gameOutput() << " Done!" << endl;
+
+    trainingLevel += duration;
+    if (trainingLevel > 10) trainingLevel = 10;
+}
+
+bool Army::battle(Army& enemyArmy, CounterRandom& random) {
+    if (size <= 0) {
+        throw GameException("Cannot battle with no army");
+    }
+
+    // Simple battle simulation
+    int ourStrength = size * trainingLevel * morale / 100;
+    if (commander) {
+        ourStrength += commander->getLeadership() * 10;
+    }
+
+    int enemyStrength = enemyArmy.getSize() * enemyArmy.getTrainingLevel() *
+        enemyArmy.getMorale() / 100;
+    if (enemyArmy.getCommander()) {
+        enemyStrength += enemyArmy.getCommander()->getLeadership() * 10;
+    }
+
+    // Random factor
+    int randomFactor = random.nextInt(-20, 20);
+
+    ourStrength += randomFactor;
+
+    // Calculate casualties
+    int ourCasualties = size * (0.1 + 0.4 * enemyStrength / (ourStrength > 0 ? ourStrength : 1));
+    int enemyCasualties = enemyArmy.getSize() * (0.1 + 0.4 * ourStrength / enemyStrength);
+
+    size -= ourCasualties;
+    if (size < 0) size = 0;
+
+    enemyArmy.size -= enemyCasualties;
+    if (enemyArmy.size < 0) enemyArmy.size = 0;
+
+    // Decrease morale after battle
+    morale -= 10;
+    if (morale < 0) morale = 0;
+
+    enemyArmy.morale -= 10;
+    if (enemyArmy.morale < 0) enemyArmy.morale = 0;
+
+    return ourStrength > enemyStrength;
+}
+
+void Army::payMaintenance(double amount) {
+    double requiredAmount = maintenanceCost;
+
+    if (amount >= requiredAmount) {
+        isPaid = true;
+        morale += 10;
+        if (morale > 100) morale = 100;
+    }
+    else {
+        isPaid = false;
+        morale -= 20;
+        if (morale < 0) morale = 0;
+    }
+}
+
+void Army::updateMorale(bool hasFood, bool isPaid) {
+    if (hasFood && isPaid) {
+        morale += 5;
+    }
+    else {
+        morale -= 15;
+    }
+
+    if (morale < 0) morale = 0;
+    if (morale > 100) morale = 100;
+}
+
+int Army::getSize() const {
+    return size;
+}
+
+int Army::getTrainingLevel() const {
+    return trainingLevel;
+}
+
+int Army::getMorale() const {
+    return morale;
+}
+
+double Army::getMaintenanceCost() const {
+    return maintenanceCost;
+}
+
+bool Army::getIsPaid() const {
+    return isPaid;
+}
+
+void Army::setCommander(std::unique_ptr<Commander> newCommander) {
+    commander = std::move(newCommander);
+}
+
+Commander* Army::getCommander() const {
+    return commander.get();
+}
+
+// Bank Implementation
+Bank::Bank(double initialTreasury) :
+    treasury(initialTreasury), loanAmount(0),
+    interestRate(0), loanDueTime(0), corruptionLevel(0) {}
+
+bool Bank::withdraw(double amount) {
+    if (amount <= 0) {
+        throw EconomyException("Cannot withdraw a negative or zero amount");
+    }
+
+    if (amount > treasury) {
+        return false;
+    }
+
+    treasury -= amount;
+    return true;
+}
+
+void Bank::deposit(double amount) {
+    if (amount <= 0) {
+        throw EconomyException("Cannot deposit a negative or zero amount");
+    }
+
+    treasury += amount;
+}
+
+double Bank::getLoan(double amount, double rate, int dueTime) {
+    if (amount <= 0) {
+        throw EconomyException("Loan amount must be positive");
+    }
+
+    if (rate <= 0) {
+        throw EconomyException("Interest rate must be positive");
+    }
+
+    if (dueTime <= 0) {
+        throw EconomyException("Loan due time must be positive");
+    }
+
+    if (loanAmount > 0) {
+        throw EconomyException("Cannot take another loan until current loan is repaid");
+    }
+
+    loanAmount = amount;
+    interestRate = rate;
+    loanDueTime = dueTime;
+    treasury += amount;
+
+    return amount;
+}
+
+bool Bank::repayLoan(double amount) {
+    if (amount <= 0) {
+        throw EconomyException("Repayment amount must be positive");
+    }
+
+    if (amount > treasury) {
+        return false;
+    }
+
+    if (loanAmount <= 0) {
+        throw EconomyException("No active loan to repay");
+    }
+
+    loanAmount -= amount;
+    treasury -= amount;
+
+    if (loanAmount < 0) {
+        treasury -= loanAmount; // Return overpayment
+        loanAmount = 0;
+        interestRate = 0;
+        loanDueTime = 0;
+    }
+
+    return true;
+}
+
+bool Bank::audit() {
+    // Simulating audit time
+    gameOutput() << "Auditing finances";
+    for (int i = 0; i < 3; i++) {
+        gameOutput() << ".";
+        gameDelay(1);
+    }
+    gameOutput() << " Done!" << endl;
+
+    double stolenAmount = treasury * (corruptionLevel / 100.0) * 0.1;
+    treasury -= stolenAmount;
+
+    if (stolenAmount > 0) {
+        gameOutput() << "Audit found " << stolenAmount << " gold was embezzled!" << endl;
+        corruptionLevel -= 20;
+        if (corruptionLevel < 0) corruptionLevel = 0;
+        return true;
+    }
+
+    return false;
+}
+
+double Bank::getTreasury() const {
+    return treasury;
+}
+
+double Bank::getLoanAmount() const {
+    return loanAmount;
+}
+
+double Bank::getInterestRate() const {
+    return interestRate;
+}
+
+int Bank::getLoanDueTime() const {
+    return loanDueTime;
+}
+
+int Bank::getCorruptionLevel() const {
+    return corruptionLevel;
+}
+
+void Bank::setCorruptionLevel(int level) {
+    corruptionLevel = std::max(0, std::min(level, 100));
+}
+
+// Market Implementation
+Market::Market() : inflationRate(0.02), tradingVolume(0), isOpen(true) {
+    // Initialize prices
+    prices["wood"] = 10.0;
+    prices["stone"] = 20.0;
+    prices["iron"] = 40.0;
+    prices["gold"] = 100.0;
+    prices["food"] = 15.0;
+    prices["weapons"] = 50.0;
+}
+
+void Market::updatePrices(CounterRandom& random) {
+    for (auto& price : prices) {
+        double change = random.nextReal(-0.1, 0.1) + inflationRate;
+        price.second *= (1 + change);
+        if (price.second < 1.0) price.second = 1.0; // Minimum price
+    }
+}
+
+void Market::updatePrices(const uint32_t* draws) {
+    for (auto& price : prices) {
+        double change = CounterRandom::toReal(*draws++, -0.1, 0.1) + inflationRate;
+        price.second *= (1 + change);
+        if (price.second < 1.0) price.second = 1.0; // Minimum price
+    }
+}
+
+size_t Market::getPriceCount() const {
+    return prices.size();
+}
+
+double Market::buyResource(const std::string& resourceName, int amount, Bank& bank) {
+    if (!isOpen) {
+        throw GameException("Market is closed");
+    }
+
+    if (amount <= 0) {
+        throw GameException("Cannot buy a negative or zero amount");
+    }
+
+    auto it = prices.find(resourceName);
+    if (it == prices.end()) {
+        throw GameException("Resource not available in market");
+    }
+
+    double cost = it->second * amount;
+
+    if (!bank.withdraw(cost)) {
+        throw GameException("Not enough money to buy resources");
+    }
+
+    tradingVolume += amount;
+    return cost;
+}
+
+double Market::sellResource(const std::string& resourceName, int amount, Bank& bank) {
+    if (!isOpen) {
+        throw GameException("Market is closed");
+    }
+
+    if (amount <= 0) {
+        throw GameException("Cannot sell a negative or zero amount");
+    }
+
+    auto it = prices.find(resourceName);
+    if (it == prices.end()) {
+        throw GameException("Resource not recognized in market");
+    }
+
+    double revenue = it->second * amount * 0.9; // 10% market fee
+    bank.deposit(revenue);
+
+    tradingVolume += amount;
+    return revenue;
+}
+
+void Market::setInflationRate(double rate) {
+    if (rate < 0) {
+        throw EconomyException("Inflation rate cannot be negative");
+    }
+
+    inflationRate = rate;
+}
+
+double Market::getResourcePrice(const std::string& resourceName) const {
+    auto it = prices.find(resourceName);
+    if (it != prices.end()) {
+        return it->second;
+    }
+    return 0.0;
+}
+
+void Market::open() {
+    isOpen = true;
+}
+
+void Market::close() {
+    isOpen = false;
+}
+
+bool Market::getIsOpen() const {
+    return isOpen;
+}
+
+// Diplomacy Implementation
+namespace {
+    // Attitudes are symmetric, so a pair is keyed by its smaller id first
+    uint64_t pairKey(KingdomId first, KingdomId second) {
+        KingdomId low = std::min(first, second);
+        KingdomId high = std::max(first, second);
+        return (static_cast<uint64_t>(low) << 32) | high;
+    }
+}
+
+Diplomacy::Diplomacy() : wordsPerRow(0) {}
+
+KingdomId Diplomacy::intern(const Name& name) {
+    auto it = ids.find(name);
+    if (it != ids.end()) {
+        return it->second;
+    }
+
+    KingdomId id = static_cast<KingdomId>(names.size());
+    growRows(names.size() + 1);
+    names.push_back(name);
+    ids.emplace(name, id);
+    return id;
+}
+
+bool Diplomacy::find(std::string_view name, KingdomId& id) const {
+    Name handle;
+    if (!Name::find(name, handle)) {
+        return false;
+    }
+    auto it = ids.find(handle);
+    if (it == ids.end()) {
+        return false;
+    }
+    id = it->second;
+    return true;
+}
+
+void Diplomacy::rename(KingdomId kingdom, const Name& name) {
+    checkId(kingdom);
+    auto it = ids.find(name);
+    if (it != ids.end()) {
+        if (it->second == kingdom) {
+            return;
+        }
+        throw GameException("Another kingdom is already called " + name.str());
+    }
+    ids.erase(names[kingdom]);
+    names[kingdom] = name;
+    ids.emplace(name, kingdom);
+}
+
+std::string_view Diplomacy::getName(KingdomId kingdom) const {
+    checkId(kingdom);
+    return names[kingdom].view();
+}
+
+size_t Diplomacy::size() const {
+    return names.size();
+}
+
+void Diplomacy::checkId(KingdomId kingdom) const {
+    if (kingdom >= names.size()) {
+        throw GameException("Unknown kingdom id " + std::to_string(kingdom));
+    }
+}
+
+void Diplomacy::growRows(size_t kingdoms) {
+    // Rows are padded to a power-of-two number of words and restrided when
+    // a new kingdom no longer fits
+    size_t words = std::max<size_t>(wordsPerRow, 1);
+    while (words * 64 < kingdoms) {
+        words *= 2;
+    }
+
+    for (vector<uint64_t>* bits : { &allyBits, &enemyBits, &truceBits }) {
+        if (words != wordsPerRow) {
+            vector<uint64_t> wider(names.size() * words, 0);
+            for (size_t row = 0; row < names.size(); row++) {
+                std::copy(bits->begin() + row * wordsPerRow, bits->begin() + (row + 1) * wordsPerRow,
+                    wider.begin() + row * words);
+            }
+            bits->swap(wider);
+        }
+        bits->resize(kingdoms * words, 0);
+    }
+    wordsPerRow = words;
+}
+
+void Diplomacy::setBit(vector<uint64_t>& bits, KingdomId first, KingdomId second, bool value) {
+    uint64_t& word = bits[first * wordsPerRow + second / 64];
+    uint64_t mask = uint64_t(1) << (second % 64);
+    word = value ? (word | mask) : (word & ~mask);
+}
+
+bool Diplomacy::testBit(const vector<uint64_t>& bits, KingdomId first, KingdomId second) const {
+    return (bits[first * wordsPerRow + second / 64] >> (second % 64)) & 1;
+}
+
+vector<KingdomId> Diplomacy::collect(const vector<uint64_t>& bits, KingdomId kingdom) const {
+    checkId(kingdom);
+    vector<KingdomId> result;
+    const uint64_t* row = bits.data() + kingdom * wordsPerRow;
+    for (size_t w = 0; w < wordsPerRow; w++) {
+        uint64_t word = row[w];
+        for (KingdomId id = static_cast<KingdomId>(w * 64); word != 0; id++, word >>= 1) {
+            if (word & 1) {
+                result.push_back(id);
+            }
+        }
+    }
+    return result;
+}
+
+Relation Diplomacy::getRelation(KingdomId first, KingdomId second) const {
+    checkId(first);
+    checkId(second);
+    if (testBit(allyBits, first, second)) return Relation::ALLY;
+    if (testBit(enemyBits, first, second)) return Relation::ENEMY;
+    if (testBit(truceBits, first, second)) return Relation::TRUCE;
+    return Relation::NEUTRAL;
+}
+
+void Diplomacy::setRelation(KingdomId first, KingdomId second, Relation relation) {
+    checkId(first);
+    checkId(second);
+    if (first == second) {
+        throw GameException("A kingdom cannot have relations with itself");
+    }
+
+    for (KingdomId from : { first, second }) {
+        KingdomId to = from == first ? second : first;
+        setBit(allyBits, from, to, relation == Relation::ALLY);
+        setBit(enemyBits, from, to, relation == Relation::ENEMY);
+        setBit(truceBits, from, to, relation == Relation::TRUCE);
+    }
+}
+
+vector<KingdomId> Diplomacy::alliesOf(KingdomId kingdom) const {
+    return collect(allyBits, kingdom);
+}
+
+vector<KingdomId> Diplomacy::enemiesOf(KingdomId kingdom) const {
+    return collect(enemyBits, kingdom);
+}
+
+size_t Diplomacy::countEnemies(KingdomId kingdom) const {
+    checkId(kingdom);
+    size_t count = 0;
+    const uint64_t* row = enemyBits.data() + kingdom * wordsPerRow;
+    for (size_t w = 0; w < wordsPerRow; w++) {
+        count += std::bitset<64>(row[w]).count();
+    }
+    return count;
+}
+
+int Diplomacy::getAttitude(KingdomId first, KingdomId second) const {
+    auto it = attitudes.find(pairKey(first, second));
+    return it == attitudes.end() ? 0 : it->second;
+}
+
+void Diplomacy::adjustAttitude(KingdomId first, KingdomId second, int amount) {
+    checkId(first);
+    checkId(second);
+    int attitude = std::max(-100, std::min(getAttitude(first, second) + amount, 100));
+    if (attitude == 0) {
+        attitudes.erase(pairKey(first, second));
+    }
+    else {
+        attitudes[pairKey(first, second)] = attitude;
+    }
+}
+
+// Politics Implementation
+Politics::Politics(const Name& kingdomName, Diplomacy* sharedDiplomacy) :
+    stability(50), civilUnrest(false),
+    ownDiplomacy(sharedDiplomacy ? nullptr : std::make_unique<Diplomacy>()),
+    diplomacy(sharedDiplomacy ? sharedDiplomacy : ownDiplomacy.get()) {
+    self = diplomacy->intern(kingdomName);
+}
+
+Politics::~Politics() {}
+
+void Politics::electKing(std::unique_ptr<King> newKing) {
+    if (!newKing) {
+        throw GameException("Invalid king");
+    }
+
+    gameOutput() << "Electing new king: " << newKing->getName() << endl;
+    gameDelay(2);
+
+    currentKing = std::move(newKing);
+    stability += 20;
+    if (stability > 100) stability = 100;
+
+    civilUnrest = false;
+}
+
+void Politics::coup(std::unique_ptr<King> usurper) {
+    if (!usurper) {
+        throw GameException("Invalid usurper");
+    }
+
+    gameOutput() << "Coup in progress! " << usurper->getName() << " is taking over the kingdom!" << endl;
+    gameDelay(3);
+
+    currentKing = std::move(usurper);
+    stability -= 40;
+    if (stability < 0) stability = 0;
+
+    civilUnrest = true;
+}
+
+KingdomId Politics::other(const Name& kingdom) {
+    KingdomId id = diplomacy->intern(kingdom);
+    if (id == self) {
+        throw GameException("A kingdom cannot have relations with itself");
+    }
+    return id;
+}
+
+vector<std::string_view> Politics::namesOf(const vector<KingdomId>& kingdoms) const {
+    vector<std::string_view> result;
+    result.reserve(kingdoms.size());
+    for (KingdomId id : kingdoms) {
+        result.push_back(diplomacy->getName(id));
+    }
+    return result;
+}
+
+void Politics::declareWar(const Name& enemyKingdom) {
+    if (isAtWar()) {
+        throw GameException("Already at war");
+    }
+
+    KingdomId enemy = other(enemyKingdom);
+    bool brokenTreaty = diplomacy->getRelation(self, enemy) != Relation::NEUTRAL;
+
+    gameOutput() << "Declaring war on " << enemyKingdom << endl;
+    diplomacy->setRelation(self, enemy, Relation::ENEMY);
+    diplomacy->adjustAttitude(self, enemy, -50);
+    stability -= 10;
+    if (brokenTreaty) {
+        gameOutput() << "Breaking your word to " << enemyKingdom << " unsettles the realm." << endl;
+        stability -= 10;
+    }
+    if (stability < 0) stability = 0;
+}
+
+void Politics::makePeace(std::string_view kingdom) {
+    KingdomId enemy;
+    if (diplomacy->find(kingdom, enemy) && enemy != self &&
+        diplomacy->getRelation(self, enemy) == Relation::ENEMY) {
+        diplomacy->setRelation(self, enemy, Relation::TRUCE);
+        diplomacy->adjustAttitude(self, enemy, 10);
+        gameOutput() << "Peace treaty signed with " << kingdom << endl;
+    }
+
+    if (!isAtWar()) {
+        stability += 15;
+        if (stability > 100) stability = 100;
+    }
+}
+
+void Politics::formAlliance(const Name& kingdom) {
+    KingdomId ally = other(kingdom);
+    Relation relation = diplomacy->getRelation(self, ally);
+    if (relation == Relation::ENEMY) {
+        throw GameException("Cannot form alliance with an enemy");
+    }
+    if (relation == Relation::ALLY) {
+        throw GameException("Already allied with " + kingdom.str());
+    }
+
+    diplomacy->setRelation(self, ally, Relation::ALLY);
+    diplomacy->adjustAttitude(self, ally, 30);
+    gameOutput() << "Alliance formed with " << kingdom << endl;
+    stability += 5;
+    if (stability > 100) stability = 100;
+}
+
+void Politics::breakAlliance(std::string_view kingdom) {
+    KingdomId ally;
+    if (diplomacy->find(kingdom, ally) && ally != self &&
+        diplomacy->getRelation(self, ally) == Relation::ALLY) {
+        diplomacy->setRelation(self, ally, Relation::NEUTRAL);
+        diplomacy->adjustAttitude(self, ally, -20);
+        gameOutput() << "Alliance with " << kingdom << " is broken" << endl;
+        stability -= 5;
+        if (stability < 0) stability = 0;
+    }
+}
+
+int Politics::getStability() const {
+    return stability;
+}
+
+bool Politics::hasCivilUnrest() const {
+    return civilUnrest;
+}
+
+bool Politics::isAtWar() const {
+    return diplomacy->countEnemies(self) > 0;
+}
+
+void Politics::setCivilUnrest(bool unrest) {
+    civilUnrest = unrest;
+}
+
+King* Politics::getCurrentKing() const {
+    return currentKing.get();
+}
+
+KingdomId Politics::getKingdomId() const {
+    return self;
+}
+
+Diplomacy& Politics::getDiplomacy() const {
+    return *diplomacy;
+}
+
+Relation Politics::getRelation(std::string_view kingdom) const {
+    KingdomId id;
+    if (!diplomacy->find(kingdom, id) || id == self) {
+        return Relation::NEUTRAL;
+    }
+    return diplomacy->getRelation(self, id);
+}
+
+vector<std::string_view> Politics::getAllies() const {
+    return namesOf(diplomacy->alliesOf(self));
+}
+
+vector<std::string_view> Politics::getEnemies() const {
+    return namesOf(diplomacy->enemiesOf(self));
+}
+
+// Save compression Implementation
+namespace {
+    const char saveMagic[4] = { 'S', 'H', 'Z', '1' };
+    const size_t saveFrameSize = 256 * 1024;
+    const size_t saveMaxFrameSize = 64 * 1024 * 1024;
+    const char numberMark = '\x01';
+    const char escapeMark = '\x02';
+    const int maxNumberDigits = 18;
+    const int matchHashBits = 16;
+    const size_t minMatch = 4;
+    const size_t maxOffset = 65535;
+
+    void appendVarint(std::string& out, uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<char>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    bool readVarint(const char*& cursor, const char* end, uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 64 && cursor < end; shift += 7) {
+            uint8_t byte = static_cast<uint8_t>(*cursor++);
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (byte < 0x80) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool readVarint(std::istream& in, uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            int byte = in.get();
+            if (byte == std::char_traits<char>::eof()) {
+                return false;
+            }
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (byte < 0x80) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Lets the save and compression code stream into a reusable string
+    class StringAppendBuffer : public std::streambuf {
+    private:
+        std::string& target;
+
+    protected:
+        int_type overflow(int_type character) override {
+            if (!traits_type::eq_int_type(character, traits_type::eof())) {
+                target.push_back(traits_type::to_char_type(character));
+            }
+            return traits_type::not_eof(character);
+        }
+
+        std::streamsize xsputn(const char* text, std::streamsize count) override {
+            target.append(text, static_cast<size_t>(count));
+            return count;
+        }
+
+    public:
+        explicit StringAppendBuffer(std::string& buffer) : target(buffer) {}
+    };
+
+    [[noreturn]] void corruptSave() {
+        throw GameException("Compressed save is corrupt");
+    }
+
+    // Numbers become a mark and the zigzag delta from the same column of the
+    // previous line. Runs with a leading zero or too many digits stay as text.
+    void encodeNumbers(std::string_view text, std::string& out) {
+        std::vector<int64_t> previous;
+        std::vector<int64_t> current;
+        size_t i = 0;
+        while (i < text.size()) {
+            char c = text[i];
+            if (c >= '0' && c <= '9') {
+                size_t end = i;
+                while (end < text.size() && text[end] >= '0' && text[end] <= '9') {
+                    end++;
+                }
+                size_t digits = end - i;
+                if ((c == '0' && digits > 1) || digits > static_cast<size_t>(maxNumberDigits)) {
+                    out.append(text.data() + i, digits);
+                }
+                else {
+                    int64_t value = 0;
+                    std::from_chars(text.data() + i, text.data() + end, value);
+                    size_t column = current.size();
+                    int64_t delta = value - (column < previous.size() ? previous[column] : 0);
+                    out.push_back(numberMark);
+                    appendVarint(out, (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63));
+                    current.push_back(value);
+                }
+                i = end;
+                continue;
+            }
+            if (c == numberMark || c == escapeMark) {
+                out.push_back(escapeMark);
+            }
+            else if (c == '\n') {
+                previous.swap(current);
+                current.clear();
+            }
+            out.push_back(c);
+            i++;
+        }
+    }
+
+    // Writes exactly size bytes of text to out, which must have room for them
+    void decodeNumbers(std::string_view data, char* out, size_t size) {
+        std::vector<int64_t> previous;
+        std::vector<int64_t> current;
+        const char* cursor = data.data();
+        const char* end = cursor + data.size();
+        char* written = out;
+        char* limit = out + size;
+        while (cursor < end) {
+            // Copy plain text up to the next byte that needs attention
+            const char* plain = cursor;
+            while (cursor < end && *cursor != numberMark && *cursor != escapeMark && *cursor != '\n') {
+                cursor++;
+            }
+            if (cursor - plain > limit - written) {
+                corruptSave();
+            }
+            std::memcpy(written, plain, cursor - plain);
+            written += cursor - plain;
+            if (cursor == end) {
+                break;
+            }
+
+            char c = *cursor++;
+            if (c == numberMark) {
+                uint64_t zigzag;
+                if (!readVarint(cursor, end, zigzag)) {
+                    corruptSave();
+                }
+                // Unsigned arithmetic keeps corrupt deltas from overflowing
+                uint64_t delta = (zigzag >> 1) ^ (0 - (zigzag & 1));
+                size_t column = current.size();
+                uint64_t base = column < previous.size() ? static_cast<uint64_t>(previous[column]) : 0;
+                int64_t value = static_cast<int64_t>(base + delta);
+                std::to_chars_result result = std::to_chars(written, limit, value);
+                if (result.ec != std::errc()) {
+                    corruptSave();
+                }
+                written = result.ptr;
+                current.push_back(value);
+                continue;
+            }
+
+            if (written == limit) {
+                corruptSave();
+            }
+            if (c == escapeMark) {
+                if (cursor == end) {
+                    corruptSave();
+                }
+                *written++ = *cursor++;
+            }
+            else {
+                *written++ = '\n';
+                previous.swap(current);
+                current.clear();
+            }
+        }
+
+        if (written != limit) {
+            corruptSave();
+        }
+    }
+
+    // Catches corruption that still decodes, eight bytes at a time
+    uint32_t frameChecksum(const char* data, size_t size) {
+        uint64_t hash = 0x9E3779B97F4A7C15ull ^ size;
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, data + i, sizeof(word));
+            hash = (hash ^ word) * 0x100000001B3ull;
+            hash ^= hash >> 29;
+        }
+        for (; i < size; i++) {
+            hash = (hash ^ static_cast<uint8_t>(data[i])) * 0x100000001B3ull;
+        }
+        return static_cast<uint32_t>(hash ^ (hash >> 32));
+    }
+
+    uint32_t read32(const char* bytes) {
+        uint32_t value;
+        std::memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+
+    void appendLength(std::string& out, size_t length) {
+        for (; length >= 255; length -= 255) {
+            out.push_back(static_cast<char>(255));
+        }
+        out.push_back(static_cast<char>(length));
+    }
+
+    // LZ77 with a single-probe hash table. Each sequence is a token holding
+    // the literal and match lengths, the literals, and a 16-bit offset.
+    void compressBlock(std::string_view input, std::string& out, std::vector<uint32_t>& table) {
+        table.assign(size_t(1) << matchHashBits, 0);
+        const char* base = input.data();
+        size_t size = input.size();
+        size_t anchor = 0;
+        size_t position = 0;
+
+        auto emit = [&](size_t literalEnd, size_t offset, size_t matchLength) {
+            size_t literals = literalEnd - anchor;
+            size_t extraMatch = matchLength ? matchLength - minMatch : 0;
+            out.push_back(static_cast<char>((std::min<size_t>(literals, 15) << 4) | std::min<size_t>(extraMatch, 15)));
+            if (literals >= 15) appendLength(out, literals - 15);
+            out.append(base + anchor, literals);
+            if (matchLength) {
+                out.push_back(static_cast<char>(offset & 0xFF));
+                out.push_back(static_cast<char>(offset >> 8));
+                if (extraMatch >= 15) appendLength(out, extraMatch - 15);
+            }
+        };
+
+        while (position + minMatch <= size) {
+            uint32_t sequence = read32(base + position);
+            uint32_t hash = (sequence * 2654435761u) >> (32 - matchHashBits);
+            size_t candidate = table[hash];
+            table[hash] = static_cast<uint32_t>(position + 1);
+            if (candidate == 0 || position + 1 - candidate > maxOffset || read32(base + candidate - 1) != sequence) {
+                // Skip faster through data that does not compress
+                position += 1 + ((position - anchor) >> 6);
+                continue;
+            }
+            candidate--;
+
+            size_t length = minMatch;
+            while (position + length < size && base[candidate + length] == base[position + length]) {
+                length++;
+            }
+            emit(position, position - candidate, length);
+            position += length;
+            anchor = position;
+        }
+
+        if (anchor < size || size == 0) {
+            emit(size, 0, 0);
+        }
+    }
+
+    void decompressBlock(std::string_view input, size_t outputSize, std::string& out) {
+        size_t start = out.size();
+        out.resize(start + outputSize);
+        char* output = &out[start];
+        size_t written = 0;
+        const uint8_t* cursor = reinterpret_cast<const uint8_t*>(input.data());
+        const uint8_t* end = cursor + input.size();
+
+        auto readLength = [&](size_t length) {
+            if (length == 15) {
+                uint8_t byte;
+                do {
+                    if (cursor == end) corruptSave();
+                    byte = *cursor++;
+                    length += byte;
+                } while (byte == 255);
+            }
+            return length;
+        };
+
+        while (cursor < end) {
+            uint8_t token = *cursor++;
+            size_t literals = readLength(token >> 4);
+            if (literals > static_cast<size_t>(end - cursor) || literals > outputSize - written) {
+                corruptSave();
+            }
+            std::memcpy(output + written, cursor, literals);
+            cursor += literals;
+            written += literals;
+            if (cursor == end) {
+                break;
+            }
+
+            if (end - cursor < 2) {
+                corruptSave();
+            }
+            size_t offset = cursor[0] | (static_cast<size_t>(cursor[1]) << 8);
+            cursor += 2;
+            size_t length = readLength(token & 15) + minMatch;
+            if (offset == 0 || offset > written || length > outputSize - written) {
+                corruptSave();
+            }
+            char* target = output + written;
+            const char* source = target - offset;
+            if (offset >= length) {
+                std::memcpy(target, source, length);
+            }
+            else {
+                // Overlapping copies repeat the last offset bytes
+                for (size_t i = 0; i < length; i++) {
+                    target[i] = source[i];
+                }
+            }
+            written += length;
+        }
+
+        if (written != outputSize) {
+            corruptSave();
+        }
+    }
+}
+
+SaveCompressor::SaveCompressor(std::ostream& output) : output(output) {
+    this->output.write(saveMagic, sizeof(saveMagic));
+}
+
+void SaveCompressor::write(std::string_view text) {
+    pending.append(text.data(), text.size());
+    while (pending.size() >= saveFrameSize) {
+        // Frames end on a line so that every frame starts a fresh column state
+        size_t lineEnd = pending.rfind('\n', saveFrameSize - 1);
+        size_t frameLength = lineEnd == std::string::npos ? saveFrameSize : lineEnd + 1;
+        writeFrame(std::string_view(pending).substr(0, frameLength));
+        pending.erase(0, frameLength);
+    }
+}
+
+void SaveCompressor::finish() {
+    if (!pending.empty()) {
+        writeFrame(pending);
+        pending.clear();
+    }
+    std::string endMarker;
+    appendVarint(endMarker, 0);
+    output.write(endMarker.data(), static_cast<std::streamsize>(endMarker.size()));
+    output.flush();
+}
+
+void SaveCompressor::writeFrame(std::string_view text) {
+    transformed.clear();
+    encodeNumbers(text, transformed);
+    compressed.clear();
+    compressBlock(transformed, compressed, matchTable);
+
+    std::string header;
+    appendVarint(header, text.size());
+    appendVarint(header, transformed.size());
+    appendVarint(header, compressed.size());
+    uint32_t checksum = frameChecksum(text.data(), text.size());
+    for (int shift = 0; shift < 32; shift += 8) {
+        header.push_back(static_cast<char>(checksum >> shift));
+    }
+    output.write(header.data(), static_cast<std::streamsize>(header.size()));
+    output.write(compressed.data(), static_cast<std::streamsize>(compressed.size()));
+}
+
+SaveDecompressor::SaveDecompressor(std::istream& input) : input(input), finished(false) {
+    char magic[sizeof(saveMagic)];
+    if (!input.read(magic, sizeof(magic)) || std::memcmp(magic, saveMagic, sizeof(magic)) != 0) {
+        throw GameException("Not a compressed save");
+    }
+}
+
+bool SaveDecompressor::readFrame(std::string& text) {
+    if (finished) {
+        return false;
+    }
+
+    uint64_t textSize, transformedSize, compressedSize;
+    if (!readVarint(input, textSize)) {
+        corruptSave();
+    }
+    if (textSize == 0) {
+        finished = true;
+        return false;
+    }
+    if (!readVarint(input, transformedSize) || !readVarint(input, compressedSize) ||
+        textSize > saveMaxFrameSize || transformedSize > 2 * saveMaxFrameSize || compressedSize > 2 * saveMaxFrameSize) {
+        corruptSave();
+    }
+    unsigned char checksumBytes[4];
+    if (!input.read(reinterpret_cast<char*>(checksumBytes), sizeof(checksumBytes))) {
+        corruptSave();
+    }
+    uint32_t checksum = checksumBytes[0] | (checksumBytes[1] << 8) | (checksumBytes[2] << 16) |
+        (static_cast<uint32_t>(checksumBytes[3]) << 24);
+
+    compressed.resize(compressedSize);
+    if (!input.read(&compressed[0], static_cast<std::streamsize>(compressedSize))) {
+        corruptSave();
+    }
+    transformed.clear();
+    decompressBlock(compressed, transformedSize, transformed);
+
+    size_t start = text.size();
+    if (text.capacity() < start + textSize) {
+        text.reserve(std::max<size_t>(start + textSize, 2 * text.capacity()));
+    }
+    text.resize(start + textSize);
+    decodeNumbers(transformed, &text[start], textSize);
+    if (frameChecksum(&text[start], textSize) != checksum) {
+        corruptSave();
+    }
+    return true;
+}
+
+bool std::isCompressedSave(const std::string& filename) {
+    const std::string extension = ".savz";
+    return filename.size() >= extension.size() &&
+        filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+void std::readSaveStream(const std::string& filename, const std::function<void(std::string_view)>& sink) {
+    std::ifstream file(filename, std::ios::in | std::ios::binary);
+    if (!file.is_open()) {
+        throw GameException("Could not open file: " + filename);
+    }
+
+    // Compressed saves are recognised by content, whatever their name
+    char magic[sizeof(saveMagic)] = {};
+    file.read(magic, sizeof(magic));
+    bool compressed = file.gcount() == sizeof(magic) && std::memcmp(magic, saveMagic, sizeof(magic)) == 0;
+    file.clear();
+    file.seekg(0);
+
+    std::string text;
+    if (compressed) {
+        SaveDecompressor decompressor(file);
+        while (decompressor.readFrame(text)) {
+            sink(text);
+            text.clear();
+        }
+        return;
+    }
+
+    text.resize(64 * 1024);
+    while (file.read(&text[0], static_cast<std::streamsize>(text.size())) || file.gcount() > 0) {
+        sink(std::string_view(text.data(), static_cast<size_t>(file.gcount())));
+    }
+}
+
+std::string std::readSaveFile(const std::string& filename) {
+    std::string text;
+    readSaveStream(filename, [&text](std::string_view piece) {
+        text.append(piece.data(), piece.size());
+        });
+    return text;
+}
+
+// SaveParser Implementation
+namespace {
+    // Every kingdom starts with these stores, and a save cannot hold more of
+    // a resource than its store takes
+    struct StartingResource {
+        const char* name;
+        int quantity;
+        int capacity;
+        double price;
+    };
+
+    const StartingResource startingResources[] = {
+        { "wood", 100, 1000, 10.0 },
+        { "stone", 50, 500, 20.0 },
+        { "iron", 20, 200, 40.0 },
+        { "gold", 10, 100, 100.0 },
+        { "food", 200, 2000, 5.0 },
+        { "weapons", 10, 100, 50.0 },
+    };
+
+    enum SaveSection {
+        KINGDOM_SECTION, POPULATION_SECTION, PROVINCE_SECTION, BUILDING_SECTION, CONSTRUCTION_SECTION,
+        RESOURCES_SECTION, ARMY_SECTION, BANK_SECTION, MARKET_SECTION, POLITICS_SECTION, KING_SECTION,
+        SAVE_SECTION_COUNT
+    };
+
+    // Sections with fields hold one value per line in this order; the others
+    // hold one record per line
+    const char* const kingdomFields[] = { "kingdom name", "turn", "game over flag" };
+    const char* const populationFields[] = { "population", "happiness", "peasants", "merchants", "nobility", "military" };
+    const char* const armyFields[] = { "army size", "training level", "morale", "maintenance cost", "paid flag" };
+    const char* const bankFields[] = { "treasury", "loan amount", "interest rate", "loan due time", "corruption level" };
+    const char* const marketFields[] = { "market open flag" };
+    const char* const politicsFields[] = { "stability", "civil unrest flag", "war flag" };
+    const char* const kingFields[] = { "king name", "influence", "corruption", "leadership" };
+
+    struct SaveSectionSchema {
+        const char* header;
+        bool required;
+        const char* const* fields;
+        int fieldCount;
+    };
+
+    const SaveSectionSchema saveSchema[SAVE_SECTION_COUNT] = {
+        { "KINGDOM_DATA", true, kingdomFields, 3 },
+        { "POPULATION_DATA", true, populationFields, 6 },
+        { "PROVINCE_DATA", false, nullptr, 0 },
+        { "BUILDING_DATA", false, nullptr, 0 },
+        { "CONSTRUCTION_DATA", false, nullptr, 0 },
+        { "RESOURCES_DATA", true, nullptr, 0 },
+        { "ARMY_DATA", false, armyFields, 5 },
+        { "BANK_DATA", false, bankFields, 5 },
+        { "MARKET_DATA", false, marketFields, 1 },
+        { "POLITICS_DATA", false, politicsFields, 3 },
+        { "KING_DATA", false, kingFields, 4 },
+    };
+
+    const size_t maxSaveLineLength = 64 * 1024;
+
+    int findSaveSection(std::string_view line) {
+        for (int s = 0; s < SAVE_SECTION_COUNT; s++) {
+            if (line == saveSchema[s].header) {
+                return s;
+            }
+        }
+        return -1;
+    }
+
+    // Kingdom and king names fill a whole line, so one that reads as a section
+    // header, or starts with the escape itself, is saved behind a backslash
+    void appendSaveName(std::ostream& out, std::string_view name) {
+        if (findSaveSection(name) >= 0 || (!name.empty() && name.front() == '\\')) {
+            out << '\\';
+        }
+        out << name;
+    }
+
+    std::string parseSaveName(std::string_view value) {
+        if (!value.empty() && value.front() == '\\') {
+            value.remove_prefix(1);
+        }
+        return std::string(value);
+    }
+
+    // Takes the next space-separated field off the front of a record
+    std::string_view nextField(std::string_view& rest) {
+        size_t start = rest.find_first_not_of(" \t");
+        if (start == std::string_view::npos) {
+            rest = std::string_view();
+            return rest;
+        }
+        size_t end = rest.find_first_of(" \t", start);
+        if (end == std::string_view::npos) {
+            end = rest.size();
+        }
+        std::string_view field = rest.substr(start, end - start);
+        rest.remove_prefix(end);
+        return field;
+    }
+
+    int parseSaveInt(std::string_view text, int line, int field, const char* what, int minimum = INT_MIN) {
+        int value = 0;
+        std::from_chars_result result = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (text.empty() || result.ec != std::errc() || result.ptr != text.data() + text.size()) {
+            throw SaveFormatException("expected a whole number for " + std::string(what) +
+                ", found '" + std::string(text) + "'", line, field);
+        }
+        if (value < minimum) {
+            throw SaveFormatException(std::string(what) + " cannot be below " + std::to_string(minimum), line, field);
+        }
+        return value;
+    }
+
+    double parseSaveDouble(std::string_view text, int line, int field, const char* what) {
+        double value = 0.0;
+        std::from_chars_result result = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (text.empty() || result.ec != std::errc() || result.ptr != text.data() + text.size()) {
+            throw SaveFormatException("expected a number for " + std::string(what) +
+                ", found '" + std::string(text) + "'", line, field);
+        }
+        return value;
+    }
+
+    bool parseSaveFlag(std::string_view text, int line, int field, const char* what) {
+        if (text != "0" && text != "1") {
+            throw SaveFormatException("expected 0 or 1 for " + std::string(what) +
+                ", found '" + std::string(text) + "'", line, field);
+        }
+        return text == "1";
+    }
+
+    BuildingType parseSaveBuilding(std::string_view text, int line, int field) {
+        BuildingType type;
+        if (!parseBuildingType(std::string(text), type)) {
+            throw SaveFormatException("unknown building type '" + std::string(text) + "'", line, field);
+        }
+        return type;
+    }
+}
+
+SaveParser::SaveParser(SaveContents& contents)
+    : contents(contents), lineNumber(0), section(-1), sectionLine(0), seenSections(0) {
+}
+
+void SaveParser::feed(std::string_view text) {
+    while (!text.empty()) {
+        size_t end = text.find('\n');
+        if (end == std::string_view::npos) {
+            if (partialLine.size() + text.size() > maxSaveLineLength) {
+                throw SaveFormatException("line is too long", lineNumber + 1);
+            }
+            partialLine.append(text.data(), text.size());
+            return;
+        }
+
+        // Whole lines are parsed in place; only a line split across pieces is copied
+        if (partialLine.empty()) {
+            parseLine(text.substr(0, end));
+        }
+        else {
+            partialLine.append(text.data(), end);
+            parseLine(partialLine);
+            partialLine.clear();
+        }
+        text.remove_prefix(end + 1);
+    }
+}
+
+void SaveParser::finish() {
+    if (!partialLine.empty()) {
+        std::string lastLine;
+        lastLine.swap(partialLine);
+        parseLine(lastLine);
+    }
+    endSection();
+    section = -1;
+
+    for (int s = 0; s < SAVE_SECTION_COUNT; s++) {
+        if (saveSchema[s].required && !(seenSections & (1u << s))) {
+            throw SaveFormatException("missing " + std::string(saveSchema[s].header) + " section", lineNumber);
+        }
+    }
+}
+
+void SaveParser::parseLine(std::string_view line) {
+    lineNumber++;
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+    if (line.empty()) {
+        return;
+    }
+
+    // Only the exact header lines open a section; names that could be
+    // mistaken for one are escaped when saved
+    int s = findSaveSection(line);
+    if (s >= 0) {
+        endSection();
+        if (seenSections & (1u << s)) {
+            throw SaveFormatException("duplicate " + std::string(line) + " section", lineNumber);
+        }
+        seenSections |= 1u << s;
+        section = s;
+        sectionLine = 0;
+        contents.hasArmy |= s == ARMY_SECTION;
+        contents.hasBank |= s == BANK_SECTION;
+        contents.hasKing |= s == KING_SECTION;
+        return;
+    }
+
+    if (section < 0) {
+        throw SaveFormatException("data before the first section", lineNumber);
+    }
+    if (saveSchema[section].fieldCount > 0) {
+        parseField(line);
+    }
+    else {
+        parseRecord(line);
+    }
+    sectionLine++;
+}
+
+void SaveParser::parseField(std::string_view value) {
+    const SaveSectionSchema& schema = saveSchema[section];
+    if (sectionLine >= schema.fieldCount) {
+        throw SaveFormatException("unexpected extra line in " + std::string(schema.header), lineNumber);
+    }
+    const char* what = schema.fields[sectionLine];
+    int line = lineNumber;
+
+    switch (section) {
+    case KINGDOM_SECTION:
+        switch (sectionLine) {
+        case 0: contents.kingdomName = parseSaveName(value); break;
+        case 1: contents.turn = parseSaveInt(value, line, 1, what, 1); break;
+        case 2: contents.gameOver = parseSaveFlag(value, line, 1, what); break;
+        }
+        break;
+    case POPULATION_SECTION:
+        if (sectionLine == 0) {
+            contents.totalPopulation = parseSaveInt(value, line, 1, what, 0);
+        }
+        else if (sectionLine == 1) {
+            contents.happiness = parseSaveDouble(value, line, 1, what);
+        }
+        else {
+            // Peasants, merchants, nobility and military, in SocialClass order
+            contents.classPopulation[sectionLine - 2] = parseSaveInt(value, line, 1, what, 0);
+        }
+        break;
+    case ARMY_SECTION:
+        switch (sectionLine) {
+        case 0: contents.armySize = parseSaveInt(value, line, 1, what, 0); break;
+        case 1: contents.armyTraining = parseSaveInt(value, line, 1, what); break;
+        case 2: contents.armyMorale = parseSaveInt(value, line, 1, what); break;
+        case 3: contents.armyMaintenance = parseSaveDouble(value, line, 1, what); break;
+        case 4: contents.armyPaid = parseSaveFlag(value, line, 1, what); break;
+        }
+        break;
+    case BANK_SECTION:
+        switch (sectionLine) {
+        case 0: contents.treasury = parseSaveDouble(value, line, 1, what); break;
+        case 1: contents.loanAmount = parseSaveDouble(value, line, 1, what); break;
+        case 2: contents.interestRate = parseSaveDouble(value, line, 1, what); break;
+        case 3: contents.loanDueTime = parseSaveInt(value, line, 1, what); break;
+        case 4: contents.corruptionLevel = parseSaveInt(value, line, 1, what, 0); break;
+        }
+        break;
+    case MARKET_SECTION:
+        contents.marketOpen = parseSaveFlag(value, line, 1, what);
+        break;
+    case POLITICS_SECTION:
+        switch (sectionLine) {
+        case 0: contents.stability = parseSaveInt(value, line, 1, what); break;
+        case 1: contents.civilUnrest = parseSaveFlag(value, line, 1, what); break;
+        case 2: contents.atWar = parseSaveFlag(value, line, 1, what); break;
+        }
+        break;
+    case KING_SECTION:
+        switch (sectionLine) {
+        case 0: contents.kingName = parseSaveName(value); break;
+        case 1: contents.kingInfluence = parseSaveInt(value, line, 1, what); break;
+        case 2: contents.kingCorruption = parseSaveInt(value, line, 1, what); break;
+        case 3: contents.kingLeadership = parseSaveInt(value, line, 1, what); break;
+        }
+        break;
+    }
+}
+
+void SaveParser::parseRecord(std::string_view line) {
+    std::string_view rest = line;
+    int field = 0;
+    auto take = [&]() {
+        field++;
+        std::string_view value = nextField(rest);
+        if (value.empty()) {
+            throw SaveFormatException("missing field in " + std::string(saveSchema[section].header) + " entry", lineNumber, field);
+        }
+        return value;
+    };
+    auto takeInt = [&](const char* what, int minimum = INT_MIN) {
+        std::string_view value = take();
+        return parseSaveInt(value, lineNumber, field, what, minimum);
+    };
+    auto takeDouble = [&](const char* what) {
+        std::string_view value = take();
+        return parseSaveDouble(value, lineNumber, field, what);
+    };
+    auto takeBuilding = [&]() {
+        std::string_view value = take();
+        return parseSaveBuilding(value, lineNumber, field);
+    };
+    auto takeLocation = [&]() {
+        int location = takeInt("location", 0);
+        if (static_cast<size_t>(location) > contents.provinces.size()) {
+            throw SaveFormatException("there is no province " + std::to_string(location), lineNumber, field);
+        }
+        return static_cast<uint32_t>(location);
+    };
+
+    switch (section) {
+    case PROVINCE_SECTION: {
+        SaveContents::ProvinceRecord province;
+        for (int& count : province.classPopulation) {
+            count = takeInt("province class population", 0);
+        }
+        province.happiness = takeDouble("province happiness");
+        for (int& store : province.stores) {
+            store = takeInt("province store", 0);
+        }
+        province.unrest = takeInt("province unrest", 0);
+
+        // The name is the rest of the line and may contain spaces
+        field++;
+        size_t nameStart = rest.find_first_not_of(" \t");
+        if (nameStart == std::string_view::npos) {
+            throw SaveFormatException("missing province name", lineNumber, field);
+        }
+        province.name = std::string(rest.substr(nameStart));
+        contents.provinces.push_back(std::move(province));
+        return;
+    }
+    case BUILDING_SECTION: {
+        BuildingType type = takeBuilding();
+        uint32_t location = takeLocation();
+        contents.buildings.push_back({ type, location });
+        break;
+    }
+    case CONSTRUCTION_SECTION: {
+        BuildingType type = takeBuilding();
+        uint32_t location = takeLocation();
+        int completionTurn = takeInt("completion turn");
+        contents.construction.push_back({ type, location, completionTurn });
+        break;
+    }
+    case RESOURCES_SECTION: {
+        SaveContents::ResourceRecord resource;
+        resource.name = std::string(take());
+        resource.quantity = takeInt("resource quantity", 0);
+        for (const StartingResource& known : startingResources) {
+            if (resource.name == known.name && resource.quantity > known.capacity) {
+                throw SaveFormatException(resource.name + " cannot be above its storage capacity of " +
+                    std::to_string(known.capacity), lineNumber, field);
+            }
+        }
+        resource.price = takeDouble("resource price");
+        contents.resources.push_back(std::move(resource));
+        break;
+    }
+    }
+
+    if (!nextField(rest).empty()) {
+        throw SaveFormatException("unexpected extra field", lineNumber, field + 1);
+    }
+}
+
+void SaveParser::endSection() {
+    if (section < 0) {
+        return;
+    }
+    const SaveSectionSchema& schema = saveSchema[section];
+    if (sectionLine < schema.fieldCount) {
+        throw SaveFormatException(std::string(schema.header) + " ends before its " +
+            schema.fields[sectionLine], lineNumber);
+    }
+}
+
+// SaveWriter Implementation
+SaveWriter::SaveWriter()
+    : hasPending(false), writing(false), stopping(false), savesWritten(0), savesReplaced(0) {
+    writer = std::thread(&SaveWriter::writerLoop, this);
+}
+
+SaveWriter::~SaveWriter() {
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stopping = true;
+    }
+    wakeWriter.notify_one();
+    writer.join();
+}
+
+void SaveWriter::writerLoop() {
+    std::unique_lock<std::mutex> lock(stateMutex);
+    while (true) {
+        wakeWriter.wait(lock, [this] { return hasPending || stopping; });
+        if (!hasPending) {
+            return;
+        }
+
+        // Take the snapshot and leave our previous buffer as the next spare
+        std::swap(writingData, pendingData);
+        std::string filename = pendingFile;
+        hasPending = false;
+        writing = true;
+        lock.unlock();
+
+        std::string error;
+        try {
+            if (isCompressedSave(filename)) {
+                encodedData.clear();
+                StringAppendBuffer buffer(encodedData);
+                std::ostream encoded(&buffer);
+                SaveCompressor compressor(encoded);
+                compressor.write(writingData);
+                compressor.finish();
+                writeFileAtomically(filename, encodedData);
+            }
+            else {
+                writeFileAtomically(filename, writingData);
+            }
+        }
+        catch (const std::exception& e) {
+            error = e.what();
+        }
+
+        lock.lock();
+        writing = false;
+        if (error.empty()) {
+            savesWritten++;
+        }
+        else {
+            lastError = error;
+        }
+        writerIdle.notify_all();
+    }
+}
+
+void SaveWriter::submit(const std::string& filename, std::string& data) {
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        if (hasPending) {
+            savesReplaced++;
+        }
+        std::swap(pendingData, data);
+        pendingFile = filename;
+        hasPending = true;
+    }
+    data.clear();
+    wakeWriter.notify_one();
+}
+
+void SaveWriter::flush() {
+    std::unique_lock<std::mutex> lock(stateMutex);
+    writerIdle.wait(lock, [this] { return !hasPending && !writing; });
+}
+
+size_t SaveWriter::getSavesWritten() const {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    return savesWritten;
+}
+
+size_t SaveWriter::getSavesReplaced() const {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    return savesReplaced;
+}
+
+std::string SaveWriter::takeLastError() {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    std::string error;
+    std::swap(error, lastError);
+    return error;
+}
+
+// KingdomSnapshot Implementation
+int KingdomSnapshot::getResourceQuantity(std::string_view resourceName) const {
+    for (int i = 0; i < resourceCount; i++) {
+        if (resources[i].name.view() == resourceName) {
+            return resources[i].quantity;
+        }
+    }
+    return 0;
+}
+
+void std::renderStatus(std::ostream& out, const KingdomSnapshot& status) {
+    const RealmTotals& totals = status.totals;
+    out << "\n============ KINGDOM OF " << status.kingdomName << " ============\n";
+    out << "Population: " << totals.population << " (Happiness: " << totals.happiness << "%)\n";
+    out << "- Peasants: " << totals.classPopulation[static_cast<int>(SocialClass::PEASANT)] << "\n";
+    out << "- Merchants: " << totals.classPopulation[static_cast<int>(SocialClass::MERCHANT)] << "\n";
+    out << "- Nobility: " << totals.classPopulation[static_cast<int>(SocialClass::NOBILITY)] << "\n";
+    out << "- Military: " << totals.classPopulation[static_cast<int>(SocialClass::MILITARY)] << "\n";
+    if (status.provinceCount > 0) {
+        out << "- Capital: " << status.capitalPopulation << "\n";
+        out << "- Provinces: " << status.provinceCount << " (" << totals.starvingProvinces << " starving, "
+            << totals.restlessProvinces << " restless)\n";
+    }
+    if (status.plague) {
+        out << "- Plague: " << status.plagueInfectedPercent << "% infected\n";
+    }
+    out << "\n";
+
+    out << "Resources:\n";
+    for (int i = 0; i < status.resourceCount; i++) {
+        out << "- " << status.resources[i].name << ": " << status.resources[i].quantity << "\n";
+    }
+
+    if (status.buildingCount > 0 || status.underConstruction > 0) {
+        out << "\nBuildings:\n";
+        for (int t = 0; t < BUILDING_TYPE_COUNT; t++) {
+            if (status.buildings[t] > 0) {
+                out << "- " << getBuildingRecipe(static_cast<BuildingType>(t)).name << ": " << status.buildings[t] << "\n";
+            }
+        }
+    }
+    if (status.underConstruction > 0) {
+        out << "- Under construction: " << status.underConstruction << " (next ready on turn "
+            << status.nextCompletion << ")\n";
+        out << "- Reserved materials: " << status.reservedWood << " wood, "
+            << status.reservedStone << " stone, " << status.reservedGold << " gold\n";
+    }
+
+    out << "\nArmy:\n";
+    out << "- Size: " << status.armySize << "\n";
+    out << "- Training Level: " << status.trainingLevel << "\n";
+    out << "- Morale: " << status.morale << "%\n";
+    out << "- Maintenance Cost: " << status.maintenanceCost << " gold\n";
+
+    out << "\nEconomy:\n";
+    out << "- Treasury: " << status.treasury << " gold\n";
+    out << "- Loan: " << status.loanAmount << " gold (Interest: " << status.interestRate * 100 << "%)\n";
+    out << "- Corruption Level: " << status.corruptionLevel << "%\n";
+
+    out << "\nPolitics:\n";
+    out << "- King: " << (status.hasKing ? status.kingName.view() : std::string_view("None")) << "\n";
+    out << "- Stability: " << status.stability << "%\n";
+    out << "- At War: " << (status.atWar ? "Yes" : "No") << "\n";
+    out << "- Civil Unrest: " << (status.civilUnrest ? "Yes" : "No") << "\n";
+    out << "=============================================\n\n";
+}
+
+void std::renderStatusLine(std::ostream& out, const KingdomSnapshot& status) {
+    out << "turn=" << status.turn
+        << " population=" << status.totals.population
+        << " happiness=" << static_cast<int>(status.totals.happiness)
+        << " gold=" << status.getResourceQuantity("gold")
+        << " food=" << status.getResourceQuantity("food")
+        << " treasury=" << static_cast<long long>(status.treasury)
+        << " army=" << status.armySize
+        << " provinces=" << status.provinceCount
+        << " buildings=" << status.buildingCount
+        << (status.gameOver ? " gameover" : "");
+}
+
+// SharedStatusExport Implementation
+namespace {
+    static_assert(SOCIAL_CLASS_COUNT == SharedStatusRecord::CLASS_COUNT &&
+        BUILDING_TYPE_COUNT == SharedStatusRecord::BUILDING_TYPES,
+        "the shared status layout changed, bump SHARED_STATUS_VERSION");
+
+    // Copies a name into a fixed field, cut short if needed and always terminated
+    template<size_t Length>
+    void copyName(char (&field)[Length], std::string_view text) {
+        size_t length = std::min(text.size(), Length - 1);
+        memcpy(field, text.data(), length);
+        memset(field + length, 0, Length - length);
+    }
+}
+
+#ifdef __linux__
+
+namespace {
+    // A segment left under the name is only taken over when it is a status
+    // export whose writer closed it or is no longer running
+    bool isStaleStatusSegment(const std::string& name, int64_t& writerPid) {
+        writerPid = 0;
+        int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) {
+            return errno == ENOENT;
+        }
+        struct stat info;
+        void* mapping = MAP_FAILED;
+        if (::fstat(fd, &info) == 0 && info.st_size >= static_cast<off_t>(sizeof(SharedStatusSegment))) {
+            mapping = ::mmap(nullptr, sizeof(SharedStatusSegment), PROT_READ, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (mapping == MAP_FAILED) {
+            return false;
+        }
+
+        const SharedStatusSegment* existing = static_cast<const SharedStatusSegment*>(mapping);
+        bool stale = false;
+        if (memcmp(existing->magic, SHARED_STATUS_MAGIC, sizeof(existing->magic)) == 0) {
+            writerPid = existing->writerPid;
+            stale = existing->state.load(std::memory_order_acquire) == SharedStatusSegment::CLOSED ||
+                (writerPid > 0 && ::kill(static_cast<pid_t>(writerPid), 0) != 0 && errno == ESRCH);
+        }
+        ::munmap(mapping, sizeof(SharedStatusSegment));
+        return stale;
+    }
+}
+
+SharedStatusExport::SharedStatusExport(const std::string& name) : segmentName(name), segment(nullptr), record() {
+    // Never reinitialize a segment another game is still publishing to
+    int fd = ::shm_open(segmentName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0 && errno == EEXIST) {
+        int64_t writerPid = 0;
+        if (!isStaleStatusSegment(segmentName, writerPid)) {
+            throw GameException(writerPid > 0
+                ? "Shared memory " + segmentName + " is in use by game process " + std::to_string(writerPid)
+                : "Shared memory " + segmentName + " already exists and is not a status export");
+        }
+        ::shm_unlink(segmentName.c_str());
+        fd = ::shm_open(segmentName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    }
+    if (fd < 0) {
+        throw GameException("Could not create shared memory " + segmentName + ": " + std::strerror(errno));
+    }
+    void* mapping = MAP_FAILED;
+    if (::ftruncate(fd, sizeof(SharedStatusSegment)) == 0) {
+        mapping = ::mmap(nullptr, sizeof(SharedStatusSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    int error = errno;
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        ::shm_unlink(segmentName.c_str());
+        throw GameException("Could not map shared memory " + segmentName + ": " + std::strerror(error));
+    }
+
+    // Readers only trust the header once the state says it is live
+    segment = new (mapping) SharedStatusSegment();
+    memcpy(segment->magic, SHARED_STATUS_MAGIC, sizeof(segment->magic));
+    segment->layoutVersion = SHARED_STATUS_VERSION;
+    segment->recordSize = sizeof(SharedStatusRecord);
+    segment->writerPid = ::getpid();
+    segment->state.store(SharedStatusSegment::LIVE, std::memory_order_release);
+}
+
+SharedStatusExport::~SharedStatusExport() {
+    // Unlinked before it is marked closed, so a game that takes over the
+    // closed name cannot have its new segment unlinked by this one
+    ::shm_unlink(segmentName.c_str());
+    segment->state.store(SharedStatusSegment::CLOSED, std::memory_order_release);
+    ::munmap(segment, sizeof(SharedStatusSegment));
+}
+
+#else
+
+SharedStatusExport::SharedStatusExport(const std::string& name) : segmentName(name), segment(nullptr), record() {
+    throw GameException("Shared memory status export is only available on Linux");
+}
+
+SharedStatusExport::~SharedStatusExport() {
+}
+
+#endif
+
+void SharedStatusExport::publish(const KingdomSnapshot& status) {
+    record.publishedAtNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    record.updates++;
+    record.turn = status.turn;
+    record.population = status.totals.population;
+    for (int c = 0; c < SOCIAL_CLASS_COUNT; c++) {
+        record.classPopulation[c] = status.totals.classPopulation[c];
+    }
+    record.capitalPopulation = status.capitalPopulation;
+    record.provinces = static_cast<int64_t>(status.provinceCount);
+    record.starvingProvinces = status.totals.starvingProvinces;
+    record.restlessProvinces = status.totals.restlessProvinces;
+    record.plagueInfectedPercent = status.plagueInfectedPercent;
+    for (int t = 0; t < BUILDING_TYPE_COUNT; t++) {
+        record.buildings[t] = status.buildings[t];
+    }
+    record.underConstruction = static_cast<int64_t>(status.underConstruction);
+    record.armySize = status.armySize;
+    record.armyTraining = status.trainingLevel;
+    record.armyMorale = status.morale;
+    record.corruptionLevel = status.corruptionLevel;
+    record.stability = status.stability;
+    record.happiness = status.totals.happiness;
+    record.treasury = status.treasury;
+    record.loanAmount = status.loanAmount;
+    record.maintenanceCost = status.maintenanceCost;
+    record.gameOver = status.gameOver;
+    record.atWar = status.atWar;
+    record.civilUnrest = status.civilUnrest;
+    record.plague = status.plague;
+    copyName(record.kingdomName, status.kingdomName.view());
+    copyName(record.kingName, status.hasKing ? status.kingName.view() : std::string_view());
+
+    int count = std::min(status.resourceCount, SharedStatusRecord::MAX_RESOURCES);
+    record.resourceCount = count;
+    for (int i = 0; i < SharedStatusRecord::MAX_RESOURCES; i++) {
+        copyName(record.resources[i].name, i < count ? status.resources[i].name.view() : std::string_view());
+        record.resources[i].quantity = i < count ? status.resources[i].quantity : 0;
+    }
+
+    segment->status.write(record);
+}
+
+const std::string& SharedStatusExport::getSegmentName() const {
+    return segmentName;
+}
+
+// Command Implementation
+Command Command::buy(const Name& resource, int quantity) {
+    Command command;
+    command.type = CommandType::BUY;
+    command.resource = resource;
+    command.quantity = quantity;
+    return command;
+}
+
+Command Command::sell(const Name& resource, int quantity) {
+    Command command;
+    command.type = CommandType::SELL;
+    command.resource = resource;
+    command.quantity = quantity;
+    return command;
+}
+
+Command Command::recruit(int soldiers) {
+    Command command;
+    command.type = CommandType::RECRUIT;
+    command.quantity = soldiers;
+    return command;
+}
+
+Command Command::tax(double rate) {
+    Command command;
+    command.type = CommandType::TAX;
+    command.rate = rate;
+    return command;
+}
+
+Command Command::loan(double amount, double rate, int term) {
+    Command command;
+    command.type = CommandType::LOAN;
+    command.amount = amount;
+    command.rate = rate;
+    command.term = term;
+    return command;
+}
+
+Command Command::build(BuildingType building, size_t location) {
+    Command command;
+    command.type = CommandType::BUILD;
+    command.building = building;
+    command.location = location;
+    return command;
+}
+
+const char* std::describeCommandStatus(CommandStatus status) {
+    switch (status) {
+    case CommandStatus::APPLIED: return "Applied";
+    case CommandStatus::INVALID_ARGUMENT: return "Invalid argument";
+    case CommandStatus::UNKNOWN_RESOURCE: return "Unknown resource";
+    case CommandStatus::NO_SUCH_PROVINCE: return "No such province";
+    case CommandStatus::MARKET_CLOSED: return "Market is closed";
+    case CommandStatus::NOT_ENOUGH_GOLD: return "Not enough gold";
+    case CommandStatus::NOT_ENOUGH_GOODS: return "Not enough goods";
+    case CommandStatus::NOT_ENOUGH_STORAGE: return "Not enough storage";
+    case CommandStatus::TOO_MANY_RECRUITS: return "Cannot recruit more than 20% of the population";
+    case CommandStatus::NOT_ENOUGH_PEASANTS: return "Not enough peasants to recruit";
+    case CommandStatus::LOAN_OUTSTANDING: return "Cannot take another loan until current loan is repaid";
+    }
+    return "Unknown status";
+}
+
+// Kingdom Implementation
+namespace {
+    const size_t provinceGrainSize = 64;
+
+    // Smaller kingdoms run their turn one phase after another even when
+    // TurnScheduling is AUTOMATIC; their tasks are too small to hand out
+    const size_t turnGraphMinimumProvinces = 2 * provinceGrainSize;
+
+    // What the tasks of a turn read and write. A task waits for every earlier
+    // task it shares data with unless both only read it, so a task graph turn
+    // ends exactly like a sequential one.
+    enum TurnData : uint32_t {
+        DATA_OUTPUT = 1u << 0,          // messages keep their order
+        DATA_TURN_STATE = 1u << 1,
+        DATA_STORES = 1u << 2,          // the kingdom's resources
+        DATA_BUILDINGS = 1u << 3,       // buildings, construction and the turn arena
+        DATA_EPIDEMIC = 1u << 4,
+        DATA_POPULATION = 1u << 5,      // the capital's people
+        DATA_PROVINCES = 1u << 6,
+        DATA_ARMY = 1u << 7,
+        DATA_BANK = 1u << 8,
+        DATA_MARKET = 1u << 9,
+        DATA_POLITICS = 1u << 10,       // ruler, stability, unrest and the end of the game
+        DATA_EVERYTHING = ~0u
+    };
+
+    enum TurnTaskId {
+        EVENTS_TASK,
+        PRODUCTION_TASK,
+        EPIDEMIC_TASK,
+        GROWTH_TASK,
+        FOOD_TASK,
+        PROVINCES_TASK,                 // split into pieces of provinces
+        PROVINCE_REVIEW_TASK,
+        ARMY_TASK,
+        BANK_TASK,
+        MARKET_TASK,
+        POLITICS_TASK,                  // the ruler may act on anything
+        TURN_TASK_COUNT
+    };
+
+    struct TurnTask {
+        TurnPhase phase;
+        uint32_t reads;
+        uint32_t writes;
+    };
+
+    // In the order update() runs them
+    const TurnTask turnTasks[TURN_TASK_COUNT] = {
+        { TurnPhase::EVENTS, 0,
+          DATA_OUTPUT | DATA_TURN_STATE | DATA_STORES | DATA_EPIDEMIC | DATA_POPULATION | DATA_POLITICS },
+        { TurnPhase::PRODUCTION, DATA_POPULATION | DATA_PROVINCES,
+          DATA_OUTPUT | DATA_TURN_STATE | DATA_STORES | DATA_BUILDINGS },
+        { TurnPhase::EPIDEMIC, DATA_TURN_STATE | DATA_PROVINCES, DATA_OUTPUT | DATA_EPIDEMIC | DATA_POPULATION },
+        { TurnPhase::POPULATION, DATA_TURN_STATE, DATA_POPULATION },
+        { TurnPhase::POPULATION, 0, DATA_OUTPUT | DATA_STORES | DATA_POPULATION },
+        { TurnPhase::PROVINCES, DATA_EPIDEMIC, DATA_PROVINCES },
+        { TurnPhase::PROVINCES, DATA_PROVINCES | DATA_POPULATION, DATA_OUTPUT | DATA_POLITICS },
+        { TurnPhase::ARMY, DATA_TURN_STATE, DATA_OUTPUT | DATA_ARMY | DATA_POLITICS },
+        { TurnPhase::ECONOMY, 0, DATA_BANK },
+        { TurnPhase::ECONOMY, 0, DATA_MARKET },
+        { TurnPhase::POLITICS, DATA_EVERYTHING, DATA_EVERYTHING }
+    };
+
+    // The tasks grouped into waves, each depending only on earlier waves.
+    // With the table above, growth and the provinces share a wave, as do the
+    // events, the bank and the market.
+    const std::vector<std::vector<size_t>>& turnTaskWaves() {
+        static const std::vector<std::vector<size_t>> waves = [] {
+            size_t wave[TURN_TASK_COUNT];
+            std::vector<std::vector<size_t>> grouped;
+            for (size_t task = 0; task < TURN_TASK_COUNT; task++) {
+                wave[task] = 0;
+                for (size_t earlier = 0; earlier < task; earlier++) {
+                    const TurnTask& first = turnTasks[earlier];
+                    const TurnTask& second = turnTasks[task];
+                    if ((first.writes & (second.reads | second.writes)) || (first.reads & second.writes)) {
+                        wave[task] = std::max(wave[task], wave[earlier] + 1);
+                    }
+                }
+                if (wave[task] >= grouped.size()) {
+                    grouped.resize(wave[task] + 1);
+                }
+                grouped[wave[task]].push_back(task);
+            }
+            return grouped;
+        }();
+        return waves;
+    }
+
+    // A share of one task, handed to whichever thread is free
+    struct TurnTaskPiece {
+        size_t task;
+        size_t begin;
+        size_t end;
+    };
+
+    // Windfalls beyond the storage capacity are lost instead of failing the turn
+    void addUpToCapacity(Resource<int>& resource, int amount) {
+        resource.addQuantity(std::min(amount, resource.getMaxQuantity() - resource.getQuantity()));
+    }
+
+    // Appends a number to a string without going through a stream
+    template<typename Text>
+    void appendNumber(Text& text, long long value) {
+        char digits[24];
+        std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+        text.append(digits, result.ptr);
+    }
+
+    // Same digits as streaming the value with the default precision
+    void appendDecimal(std::string& text, double value) {
+        char digits[32];
+        std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::general, 6);
+        text.append(digits, result.ptr);
+    }
+}
+
+Kingdom::Kingdom(const Name& name, Diplomacy* diplomacy)
+    : name(name), autosaveInterval(0), gameOver(false), currentTurn(1), statusExport(nullptr), battlesThisTurn(0) {
+    std::mt19937& gen = gameRandom();
+    randomSeed = (static_cast<uint64_t>(gen()) << 32) | gen();
+
+    // Initialize components
+    army = std::make_unique<Army>();
+    bank = std::make_unique<Bank>();
+    market = std::make_unique<Market>();
+    politics = std::make_unique<Politics>(name, diplomacy);
+
+    // Initialize resources
+    initializeResources();
+    publishStatus();
+}
+
+Kingdom::~Kingdom() {}
+
+void Kingdom::initializeResources() {
+    for (const StartingResource& start : startingResources) {
+        resources.emplace(start.name, Resource<int>(start.name, start.quantity, start.capacity, start.price));
+    }
+}
+
+void Kingdom::update() {
+    if (usesTurnGraph()) {
+        runTurnGraph();
+        return;
+    }
+    for (int phase = static_cast<int>(TurnPhase::EVENTS); phase <= static_cast<int>(TurnPhase::POLITICS); phase++) {
+        updatePhase(static_cast<TurnPhase>(phase));
+    }
+}
+
+void Kingdom::updatePhase(TurnPhase phase) {
+    TurnPhaseScope scope(phase);
+    switch (phase) {
+    case TurnPhase::EVENTS:
+        rollEvents();
+        break;
+    case TurnPhase::PRODUCTION:
+        runProduction();
+        break;
+    case TurnPhase::EPIDEMIC:
+        advanceEpidemic();
+        break;
+    case TurnPhase::POPULATION:
+        growPopulation();
+        consumeFood();
+        break;
+    case TurnPhase::PROVINCES:
+        updateProvinces();
+        break;
+    case TurnPhase::ARMY:
+        updateArmy();
+        break;
+    case TurnPhase::ECONOMY:
+        updateBank();
+        updateMarket();
+        break;
+    case TurnPhase::POLITICS:
+        updatePolitics();
+        break;
+    default:
+        throw GameException(std::string("Not a phase of update(): ") + getTurnPhaseName(phase));
+    }
+}
+
+void Kingdom::rollEvents() {
+    updateEvents(getRandom(RandomSlot::EVENT_CHANCE, currentTurn)());
+}
+
+void Kingdom::updateEvents(uint32_t chanceDraw) {
+    // Check for random events
+    turnState.eventChance = CounterRandom::toInt(chanceDraw, 1, 100);
+
+    if (turnState.eventChance <= 10) { // 10% chance of random event
+        randomEvent();
+    }
+}
+
+void Kingdom::runProduction() {
+    // Finish the construction work due by the end of this turn, so a
+    // building started N turns before is standing after N turn updates.
+    // Then run the buildings.
+    int completed = construction.completeUntil(currentTurn + 1, buildings);
+    if (completed > 0) {
+        gameOutput() << completed << (completed == 1 ? " building has" : " buildings have") << " been completed." << endl;
+    }
+    manageResources();
+
+    // Update resources
+    turnState.hasFood = resources.at("food").getQuantity() >= population.getTotalPopulation() / 10;
+    turnState.hasHealthcare = resources.at("food").getQuantity() > 0;
+}
+
+void Kingdom::advanceEpidemic() {
+    // Advance the epidemic across the capital and the provinces; its deaths
+    // are part of this year's mortality
+    bool plagueSpreading = epidemic.isActive();
+    epidemic.setHealthcare(0, turnState.hasHealthcare ? 0.5 : 0.0);
+    for (const Province& province : provinces) {
+        epidemic.setHealthcare(province.getEpidemicRegion(), province.getStore(ProvinceStore::FOOD) > 0 ? 0.5 : 0.0);
+    }
+    epidemic.step();
+    population.setDiseaseMortality(epidemic.getMortality(0));
+    if (plagueSpreading && !epidemic.isActive()) {
+        gameOutput() << "The plague has run its course." << endl;
+        population.endPlague();
+    }
+}
+
+void Kingdom::growPopulation() {
+    int jobAvailability = population.getTotalPopulation() / 2; // Simplified job availability
+    population.update(turnState.hasFood, turnState.hasHealthcare, jobAvailability);
+}
+
+void Kingdom::consumeFood() {
+    int foodNeeded = population.getTotalPopulation() / 10;
+    if (resources.at("food").getQuantity() >= foodNeeded) {
+        resources.at("food").consumeQuantity(foodNeeded);
+    }
+    else {
+        // Not enough food
+        gameOutput() << "Your kingdom is starving!" << endl;
+        population.adjustHappiness(-10.0);
+    }
+}
+
+void Kingdom::updateArmy() {
+    if (!army) {
+        return;
+    }
+    army->updateMorale(turnState.hasFood, army->getIsPaid());
+
+    // Check for military rebellion
+    if (army->getMorale() < 20 && army->getSize() > 0) {
+        gameOutput() << "Your army is rebelling due to low morale!" << endl;
+        // Military coup logic
+        if (politics && politics->getCurrentKing()) {
+            gameOutput() << "The military has staged a coup!" << endl;
+            auto commander = army->getCommander();
+            if (commander) {
+                std::unique_ptr<King> militaryLeader = std::make_unique<King>(
+                    commander->getNameHandle(), commander->getInfluence(),
+                    commander->getCorruption(), commander->getLeadership(),
+                    militaristicStyle
+                );
+                politics->coup(std::move(militaryLeader));
+            }
+        }
+    }
+}
+
+void Kingdom::updatePolitics() {
+    if (!politics) {
+        return;
+    }
+    if (politics->getCurrentKing()) {
+        politics->getCurrentKing()->makeDecision(*this);
+    }
+
+    if (population.isUnhappy() && politics->getStability() < 30) {
+        gameOutput() << "The people are revolting!" << endl;
+        politics->setCivilUnrest(true);
+
+        // Chance of revolution
+        if (turnState.eventChance <= 30) {
+            gameOutput() << "Revolution! The king has been overthrown!" << endl;
+            gameOver = true;
+        }
+    }
+}
+
+bool Kingdom::usesTurnGraph() const {
+    switch (getTurnScheduling()) {
+    case TurnScheduling::SEQUENTIAL:
+        return false;
+    case TurnScheduling::TASK_GRAPH:
+        return true;
+    default:
+        return WorkerPool::shared().getThreadCount() > 1 && provinces.size() >= turnGraphMinimumProvinces;
+    }
+}
+
+size_t Kingdom::countTurnTaskItems(size_t task) const {
+    return task == PROVINCES_TASK ? provinces.size() : 1;
+}
+
+void Kingdom::runTurnTask(size_t task, size_t begin, size_t end) {
+    TurnPhaseScope phase(turnTasks[task].phase);
+    switch (task) {
+    case EVENTS_TASK: rollEvents(); break;
+    case PRODUCTION_TASK: runProduction(); break;
+    case EPIDEMIC_TASK: advanceEpidemic(); break;
+    case GROWTH_TASK: growPopulation(); break;
+    case FOOD_TASK: consumeFood(); break;
+    case PROVINCES_TASK: advanceProvinces(begin, end); break;
+    case PROVINCE_REVIEW_TASK: reviewProvinces(); break;
+    case ARMY_TASK: updateArmy(); break;
+    case BANK_TASK: updateBank(); break;
+    case MARKET_TASK: updateMarket(); break;
+    case POLITICS_TASK: updatePolitics(); break;
+    }
+}
+
+void Kingdom::runTurnGraph() {
+    // Tasks that spread themselves over the WorkerPool run on this thread so
+    // they still can. The rest of a wave is cut into pieces that make up one
+    // parallel job; their random draws come from the kingdom's counter-based
+    // streams, so it does not matter which thread takes them.
+    bool headless = isHeadless();
+    std::vector<TurnTaskPiece> pieces;
+    for (const std::vector<size_t>& wave : turnTaskWaves()) {
+        pieces.clear();
+        for (size_t task : wave) {
+            bool ownThread = task == EPIDEMIC_TASK || (task == GROWTH_TASK && population.hasCitizenAgents());
+            size_t items = countTurnTaskItems(task);
+            if (ownThread) {
+                runTurnTask(task, 0, items);
+                continue;
+            }
+            size_t grain = task == PROVINCES_TASK ? provinceGrainSize : items;
+            for (size_t begin = 0; begin < items; begin += grain) {
+                pieces.push_back({ task, begin, std::min(items, begin + grain) });
+            }
+        }
+
+        WorkerPool::shared().parallelFor(pieces.size(), 1, [&](size_t begin, size_t end) {
+            // Pool threads print, or stay quiet, like this one
+            bool wasHeadless = isHeadless();
+            setHeadless(headless);
+            try {
+                for (size_t i = begin; i < end; i++) {
+                    runTurnTask(pieces[i].task, pieces[i].begin, pieces[i].end);
+                }
+            }
+            catch (...) {
+                setHeadless(wasHeadless);
+                throw;
+            }
+            setHeadless(wasHeadless);
+        });
+    }
+}
+
+void Kingdom::updateBank() {
+    // Outstanding loans breed corruption
+    if (bank && bank->getLoanAmount() > 0) {
+        bank->setCorruptionLevel(bank->getCorruptionLevel() + 1);
+    }
+}
+
+void Kingdom::updateMarket() {
+    if (market) {
+        CounterRandom random = getRandom(RandomSlot::MARKET, currentTurn);
+        market->updatePrices(random);
+    }
+}
+
+void Kingdom::updateMarket(const uint32_t* draws) {
+    if (market) {
+        market->updatePrices(draws);
+    }
+}
+
+void Kingdom::updateProvinces() {
+    if (provinces.empty()) {
+        return;
+    }
+
+    // Provinces only touch their own state, so they advance in parallel
+    WorkerPool::shared().parallelFor(provinces.size(), provinceGrainSize, [this](size_t begin, size_t end) {
+        advanceProvinces(begin, end);
+    });
+    reviewProvinces();
+}
+
+void Kingdom::advanceProvinces(size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+        provinces[i].update(epidemic.getMortality(provinces[i].getEpidemicRegion()));
+    }
+}
+
+void Kingdom::reviewProvinces() {
+    RealmTotals totals = getRealmTotals();
+    if (totals.starvingProvinces > 0) {
+        gameOutput() << totals.starvingProvinces << " of your provinces are starving!" << endl;
+    }
+    if (politics && static_cast<size_t>(totals.restlessProvinces) * 2 > provinces.size()) {
+        gameOutput() << "Unrest is spreading through the provinces!" << endl;
+        politics->setCivilUnrest(true);
+    }
+}
+
+RealmTotals Kingdom::getRealmTotals() const {
+    RealmTotals totals;
+    totals.population = population.getTotalPopulation();
+    totals.happiness = population.getHappiness() * population.getTotalPopulation();
+    totals.starvingProvinces = 0;
+    totals.restlessProvinces = 0;
+    for (int c = 0; c < SOCIAL_CLASS_COUNT; c++) {
+        totals.classPopulation[c] = population.getClassPopulation(static_cast<SocialClass>(c));
+    }
+
+    for (const Province& province : provinces) {
+        const Population& people = province.getPopulation();
+        totals.population += people.getTotalPopulation();
+        totals.happiness += people.getHappiness() * people.getTotalPopulation();
+        for (int c = 0; c < SOCIAL_CLASS_COUNT; c++) {
+            totals.classPopulation[c] += people.getClassPopulation(static_cast<SocialClass>(c));
+        }
+        totals.starvingProvinces += province.isStarving();
+        totals.restlessProvinces += province.isRestless();
+    }
+
+    // Happiness of the realm is weighted by where the people live
+    totals.happiness = totals.population > 0 ? totals.happiness / totals.population : population.getHappiness();
+    return totals;
+}
+
+size_t Kingdom::getProvinceCount() const {
+    return provinces.size();
+}
+
+Province& Kingdom::getProvince(size_t index) {
+    if (index >= provinces.size()) {
+        throw GameException("No province number " + std::to_string(index + 1));
+    }
+    return provinces[index];
+}
+
+Province& Kingdom::foundProvince(const std::string& provinceName, int settlers) {
+    if (provinceName.empty()) {
+        throw GameException("A province needs a name");
+    }
+    for (const Province& province : provinces) {
+        if (province.getName() == provinceName) {
+            throw GameException("Province " + provinceName + " already exists");
+        }
+    }
+
+    int peasants = population.getClassPopulation(SocialClass::PEASANT);
+    if (settlers <= 0 || settlers > peasants) {
+        throw GameException("Not enough peasants to settle a new province");
+    }
+    population.setClassPopulation(SocialClass::PEASANT, peasants - settlers);
+
+    return addProvince(provinceName, settlers);
+}
+
+Province& Kingdom::addProvince(const std::string& provinceName, int initialPopulation) {
+    // A province trades with the capital and its nearest neighbour, which is
+    // also how disease travels between them
+    size_t region = epidemic.addRegion();
+    epidemic.addLink(0, region, 0.2);
+    if (!provinces.empty()) {
+        epidemic.addLink(provinces.back().getEpidemicRegion(), region, 0.1);
+    }
+    provinces.emplace_back(provinceName, initialPopulation, region);
+    return provinces.back();
+}
+
+void Kingdom::displayStatus() const {
+    renderStatus(std::cout, captureStatus());
+}
+
+KingdomSnapshot Kingdom::captureStatus() const {
+    KingdomSnapshot status;
+    status.kingdomName = name;
+    status.turn = currentTurn;
+    status.gameOver = gameOver;
+
+    status.totals = getRealmTotals();
+    status.capitalPopulation = population.getTotalPopulation();
+    status.provinceCount = provinces.size();
+    status.plague = epidemic.isActive();
+    if (status.plague) {
+        status.plagueInfectedPercent = static_cast<int>(epidemic.getInfected(0) * 100.0 + 0.5);
+    }
+
+    // Only the first few resources fit; the game defines six
+    for (const auto& res : resources) {
+        if (status.resourceCount == KingdomSnapshot::MAX_RESOURCES) break;
+        status.resources[status.resourceCount++] = { res.second.getNameHandle(), res.second.getQuantity() };
+    }
+
+    status.buildingCount = buildings.size();
+    for (int t = 0; t < BUILDING_TYPE_COUNT; t++) {
+        status.buildings[t] = buildings.count(static_cast<BuildingType>(t));
+    }
+    status.underConstruction = construction.size();
+    if (status.underConstruction > 0) {
+        status.nextCompletion = construction.getNextCompletion();
+        status.reservedWood = construction.getReservedWood();
+        status.reservedStone = construction.getReservedStone();
+        status.reservedGold = construction.getReservedGold();
+    }
+
+    status.armySize = army->getSize();
+    status.trainingLevel = army->getTrainingLevel();
+    status.morale = army->getMorale();
+    status.maintenanceCost = army->getMaintenanceCost();
+
+    status.treasury = bank->getTreasury();
+    status.loanAmount = bank->getLoanAmount();
+    status.interestRate = bank->getInterestRate();
+    status.corruptionLevel = bank->getCorruptionLevel();
+
+    King* king = politics->getCurrentKing();
+    status.hasKing = king != nullptr;
+    if (king) {
+        status.kingName = king->getNameHandle();
+    }
+    status.stability = politics->getStability();
+    status.atWar = politics->isAtWar();
+    status.civilUnrest = politics->hasCivilUnrest();
+    return status;
+}
+
+void Kingdom::publishStatus() {
+    KingdomSnapshot status = captureStatus();
+    publishedStatus.write(status);
+    if (statusExport) {
+        statusExport->publish(status);
+    }
+}
+
+KingdomSnapshot Kingdom::readStatus() const {
+    return publishedStatus.read();
+}
+
+uint64_t Kingdom::getStatusVersion() const {
+    return publishedStatus.getVersion();
+}
+
+void Kingdom::setStatusExport(SharedStatusExport* target) {
+    statusExport = target;
+    if (statusExport) {
+        statusExport->publish(readStatus());
+    }
+}
+
+SharedStatusExport* Kingdom::getStatusExport() const {
+    return statusExport;
+}
+
+void Kingdom::setRandomSeed(uint64_t seed) {
+    randomSeed = seed;
+}
+
+uint64_t Kingdom::getRandomSeed() const {
+    return randomSeed;
+}
+
+CounterRandom Kingdom::getRandom(RandomSlot slot, int turn, uint32_t sequence) const {
+    return CounterRandom(randomSeed, politics->getKingdomId(), static_cast<uint32_t>(turn), slot, sequence);
+}
+
+const InstrumentationReport& Kingdom::getTurnCosts() const {
+    return turnCosts;
+}
+
+void Kingdom::processTurn() {
+    InstrumentationReport countsBefore;
+    if (isInstrumented()) {
+        countsBefore = readInstrumentation();
+    }
+
+    update();
+    finishTurn();
+
+    if (isInstrumented()) {
+        turnCosts = readInstrumentation() - countsBefore;
+    }
+    if (!isHeadless()) {
+        renderStatus(std::cout, readStatus());
+        if (isInstrumented()) {
+            renderInstrumentation(std::cout, turnCosts);
+        }
+    }
+}
+
+void Kingdom::finishTurn() {
+    currentTurn++;
+    battlesThisTurn = 0;
+    TurnPhaseScope phase(TurnPhase::BOOKKEEPING);
+    if (autosaver && currentTurn % autosaveInterval == 0) {
+        autosave();
+    }
+    publishStatus();
+
+    // Nothing allocated from the turn arena outlives the turn
+    turnArena.reset();
+}
+
+bool Kingdom::isGameOver() const {
+    return gameOver;
+}
+
+std::string_view Kingdom::getName() const {
+    return name.view();
+}
+
+const Name& Kingdom::getNameHandle() const {
+    return name;
+}
+
+Population& Kingdom::getPopulation() {
+    return population;
+}
+
+const BuildingTable& Kingdom::getBuildings() const {
+    return buildings;
+}
+
+const ConstructionQueue& Kingdom::getConstruction() const {
+    return construction;
+}
+
+TurnArena& Kingdom::getTurnArena() {
+    return turnArena;
+}
+
+const Epidemic& Kingdom::getEpidemic() const {
+    return epidemic;
+}
+
+Army* Kingdom::getArmy() const {
+    return army.get();
+}
+
+Bank* Kingdom::getBank() const {
+    return bank.get();
+}
+
+Market* Kingdom::getMarket() const {
+    return market.get();
+}
+
+Politics* Kingdom::getPolitics() const {
+    return politics.get();
+}
+
+Resource<int>* Kingdom::getResource(const std::string& name) {
+    auto it = resources.find(name);
+    if (it != resources.end()) {
+        return &(it->second);
+    }
+    return nullptr;
+}
+
+void Kingdom::collectTaxes(double taxRate) {
+    if (taxRate < 0 || taxRate > 1.0) {
+        throw GameException("Tax rate must be between 0 and 1");
+    }
+
+    // Different tax rates for different classes (can be adjusted)
+    double peasantTax = taxRate * 0.5;
+    double merchantTax = taxRate * 2.0;
+    double nobilityTax = taxRate * 5.0;
+
+    auto taxesFrom = [&](Population& people) {
+        // Adjust happiness based on tax rate
+        if (taxRate > 0.5) {
+            people.adjustHappiness(-10.0 * (taxRate - 0.5) * 2); // Higher taxes decrease happiness
+        }
+        return people.getClassPopulation(SocialClass::PEASANT) * peasantTax +
+            people.getClassPopulation(SocialClass::MERCHANT) * merchantTax +
+            people.getClassPopulation(SocialClass::NOBILITY) * nobilityTax;
+    };
+
+    // Restless provinces hold back part of what they owe
+    double totalTax = taxesFrom(population);
+    for (Province& province : provinces) {
+        totalTax += taxesFrom(province.getPopulation()) * (1.0 - province.getUnrest() / 100.0);
+    }
+
+    if (totalTax > 0) {
+        bank->deposit(totalTax);
+    }
+
+    gameOutput() << "Taxes collected: " << totalTax << " gold" << endl;
+}
+
+void Kingdom::buildStructure(const std::string& structureName, size_t location) {
+    BuildingType type;
+    if (!parseBuildingType(structureName, type)) {
+        throw GameException("Unknown building type: " + structureName);
+    }
+    buildStructure(type, location);
+}
+
+void Kingdom::buildStructure(BuildingType type, size_t location) {
+    const BuildingRecipe& recipe = getBuildingRecipe(type);
+    if (location > provinces.size()) {
+        throw GameException("No province number " + std::to_string(location) + " to build in");
+    }
+
+    // Check every cost before paying any of them
+    Resource<int>& wood = resources.at("wood");
+    Resource<int>& stone = resources.at("stone");
+    Resource<int>& gold = resources.at("gold");
+    if (wood.getQuantity() < recipe.woodCost || stone.getQuantity() < recipe.stoneCost ||
+        gold.getQuantity() < recipe.goldCost) {
+        throw ResourceException("A " + std::string(recipe.name) + " needs " + std::to_string(recipe.woodCost) + " wood, " +
+            std::to_string(recipe.stoneCost) + " stone and " + std::to_string(recipe.goldCost) + " gold");
+    }
+    wood.consumeQuantity(recipe.woodCost);
+    stone.consumeQuantity(recipe.stoneCost);
+    gold.consumeQuantity(recipe.goldCost);
+
+    construction.enqueue(type, static_cast<uint32_t>(location), currentTurn + recipe.buildTurns);
+    gameOutput() << "Construction of a " << recipe.name << " has begun in "
+        << (location == 0 ? "the capital" : provinces[location - 1].getName())
+        << ". It will be ready in " << recipe.buildTurns << " turns." << endl;
+}
+
+size_t Kingdom::apply(const Command* commands, size_t count, CommandResult* results) {
+    Resource<int>& wood = resources.at("wood");
+    Resource<int>& stone = resources.at("stone");
+    Resource<int>& gold = resources.at("gold");
+    size_t applied = 0;
+
+    // Every check runs before anything is changed, so the actions called at
+    // the end of each case never throw
+    for (size_t i = 0; i < count; i++) {
+        const Command& command = commands[i];
+        CommandResult& result = results[i];
+        result = CommandResult{};
+
+        switch (command.type) {
+        case CommandType::BUY:
+        case CommandType::SELL: {
+            const std::string& resourceName = command.resource.str();
+            auto stored = resources.find(resourceName);
+            double price = market->getResourcePrice(resourceName);
+            if (!market->getIsOpen()) {
+                result.status = CommandStatus::MARKET_CLOSED;
+            }
+            else if (command.quantity <= 0) {
+                result.status = CommandStatus::INVALID_ARGUMENT;
+            }
+            else if (stored == resources.end() || price <= 0) {
+                result.status = CommandStatus::UNKNOWN_RESOURCE;
+            }
+            else if (command.type == CommandType::BUY) {
+                Resource<int>& resource = stored->second;
+                if (command.quantity > resource.getMaxQuantity() - resource.getQuantity()) {
+                    result.status = CommandStatus::NOT_ENOUGH_STORAGE;
+                }
+                else if (price * command.quantity > bank->getTreasury()) {
+                    result.status = CommandStatus::NOT_ENOUGH_GOLD;
+                }
+                else {
+                    result.value = market->buyResource(resourceName, command.quantity, *bank);
+                    resource.addQuantity(command.quantity);
+                }
+            }
+            else if (stored->second.getQuantity() < command.quantity) {
+                result.status = CommandStatus::NOT_ENOUGH_GOODS;
+            }
+            else {
+                result.value = market->sellResource(resourceName, command.quantity, *bank);
+                stored->second.consumeQuantity(command.quantity);
+            }
+            break;
+        }
+        case CommandType::RECRUIT: {
+            int people = population.getTotalPopulation();
+            if (command.quantity <= 0) {
+                result.status = CommandStatus::INVALID_ARGUMENT;
+            }
+            else if (command.quantity > people * 0.2) {
+                result.status = CommandStatus::TOO_MANY_RECRUITS;
+            }
+            else if (command.quantity > population.getClassPopulation(SocialClass::PEASANT)) {
+                result.status = CommandStatus::NOT_ENOUGH_PEASANTS;
+            }
+            else {
+                army->enlist(command.quantity);
+                population.migrate(SocialClass::PEASANT, SocialClass::MILITARY, command.quantity);
+                result.value = command.quantity;
+            }
+            break;
+        }
+        case CommandType::TAX:
+            if (!(command.rate >= 0 && command.rate <= 1.0)) {
+                result.status = CommandStatus::INVALID_ARGUMENT;
+            }
+            else {
+                double before = bank->getTreasury();
+                collectTaxes(command.rate);
+                result.value = bank->getTreasury() - before;
+            }
+            break;
+        case CommandType::LOAN:
+            if (!(command.amount > 0) || !(command.rate > 0) || command.term <= 0) {
+                result.status = CommandStatus::INVALID_ARGUMENT;
+            }
+            else if (bank->getLoanAmount() > 0) {
+                result.status = CommandStatus::LOAN_OUTSTANDING;
+            }
+            else {
+                result.value = bank->getLoan(command.amount, command.rate, command.term);
+            }
+            break;
+        case CommandType::BUILD: {
+            int type = static_cast<int>(command.building);
+            if (type < 0 || type >= BUILDING_TYPE_COUNT) {
+                result.status = CommandStatus::INVALID_ARGUMENT;
+                break;
+            }
+            const BuildingRecipe& recipe = getBuildingRecipe(command.building);
+            if (command.location > provinces.size()) {
+                result.status = CommandStatus::NO_SUCH_PROVINCE;
+            }
+            else if (wood.getQuantity() < recipe.woodCost || stone.getQuantity() < recipe.stoneCost ||
+                gold.getQuantity() < recipe.goldCost) {
+                result.status = CommandStatus::NOT_ENOUGH_GOODS;
+            }
+            else {
+                buildStructure(command.building, command.location);
+                result.value = currentTurn + recipe.buildTurns;
+            }
+            break;
+        }
+        default:
+            result.status = CommandStatus::INVALID_ARGUMENT;
+            break;
+        }
+
+        if (result.applied()) {
+            applied++;
+        }
+    }
+    return applied;
+}
+
+std::vector<CommandResult> Kingdom::apply(const std::vector<Command>& commands) {
+    std::vector<CommandResult> results(commands.size());
+    apply(commands.data(), commands.size(), results.data());
+    return results;
+}
+
+void Kingdom::cancelConstruction(const std::string& structureName, size_t location) {
+    BuildingType type;
+    if (!parseBuildingType(structureName, type)) {
+        throw GameException("Unknown building type: " + structureName);
+    }
+    cancelConstruction(type, location);
+}
+
+void Kingdom::cancelConstruction(BuildingType type, size_t location) {
+    const BuildingRecipe& recipe = getBuildingRecipe(type);
+    if (location > provinces.size() || !construction.cancel(type, static_cast<uint32_t>(location))) {
+        throw GameException("No " + std::string(recipe.name) + " is under construction there");
+    }
+
+    // Refunds beyond what the stores can hold are lost
+    auto refund = [](Resource<int>& resource, int amount) {
+        resource.setQuantity(std::min(resource.getMaxQuantity(), resource.getQuantity() + amount));
+    };
+    refund(resources.at("wood"), recipe.woodCost);
+    refund(resources.at("stone"), recipe.stoneCost);
+    refund(resources.at("gold"), recipe.goldCost);
+    gameOutput() << "Construction of a " << recipe.name << " in "
+        << (location == 0 ? "the capital" : provinces[location - 1].getName())
+        << " was cancelled and its materials returned." << endl;
+}
+
+void Kingdom::handleWar(Kingdom& enemyKingdom) {
+    if (!politics->isAtWar()) {
+        politics->declareWar(enemyKingdom.getNameHandle());
+    }
+
+    gameOutput() << "War with " << enemyKingdom.getName() << " has begun!" << endl;
+    gameDelay(2);
+
+    CounterRandom random = getRandom(RandomSlot::BATTLE, currentTurn, battlesThisTurn++);
+    bool victory = army->battle(*enemyKingdom.getArmy(), random);
+
+    if (victory) {
+        gameOutput() << "Victory! " << enemyKingdom.getName() << " has been defeated!" << endl;
+        // War reparations
+        double reparations = enemyKingdom.getBank()->getTreasury() * 0.2;
+        enemyKingdom.getBank()->withdraw(reparations);
+        bank->deposit(reparations);
+
+        politics->makePeace(enemyKingdom.getName());
+    }
+    else {
+        gameOutput() << "Defeat! Your army has been beaten by " << enemyKingdom.getName() << "!" << endl;
+        // Pay tribute
+        double tribute = bank->getTreasury() * 0.2;
+        bank->withdraw(tribute);
+        enemyKingdom.getBank()->deposit(tribute);
+
+        politics->makePeace(enemyKingdom.getName());
+    }
+}
+
+void Kingdom::manageResources() {
+    if (buildings.size() == 0) {
+        return;
+    }
+
+    // The peasants of each location staff the buildings there
+    std::pmr::vector<int> workforce(&turnArena);
+    workforce.reserve(provinces.size() + 1);
+    workforce.push_back(population.getClassPopulation(SocialClass::PEASANT));
+    for (const Province& province : provinces) {
+        workforce.push_back(province.getPopulation().getClassPopulation(SocialClass::PEASANT));
+    }
+    array<double, BUILDING_TYPE_COUNT> staffed = buildings.staffedCapacity(workforce.data(), workforce.size());
+
+    // Types run in order, so this year's iron already reaches the smithies.
+    // Output is limited by staff, inputs and free storage.
+    std::pmr::string report(&turnArena);
+    for (int t = 0; t < BUILDING_TYPE_COUNT; t++) {
+        const BuildingRecipe& recipe = getBuildingRecipe(static_cast<BuildingType>(t));
+        Resource<int>& output = resources.at(recipe.output);
+
+        double batches = staffed[t];
+        if (recipe.input) {
+            batches = std::min(batches, resources.at(recipe.input).getQuantity() / static_cast<double>(recipe.inputAmount));
+        }
+        batches = std::min(batches, (output.getMaxQuantity() - output.getQuantity()) / static_cast<double>(recipe.outputAmount));
+
+        int made = static_cast<int>(batches);
+        if (made <= 0) {
+            continue;
+        }
+        if (recipe.input) {
+            resources.at(recipe.input).consumeQuantity(made * recipe.inputAmount);
+        }
+        output.addQuantity(made * recipe.outputAmount);
+        if (!report.empty()) {
+            report += ", ";
+        }
+        appendNumber(report, made * recipe.outputAmount);
+        report += ' ';
+        report += recipe.output;
+    }
+
+    if (!report.empty()) {
+        gameOutput() << "Your buildings produced " << report << "." << endl;
+    }
+}
+
+// Update saveGameState method for Visual Studio 2022 compatibility
+void Kingdom::saveGameState(const std::string& filename) const {
+    try {
+        std::string data;
+        writeSaveData(data);
+        if (isCompressedSave(filename)) {
+            std::string encodedData;
+            StringAppendBuffer buffer(encodedData);
+            std::ostream encoded(&buffer);
+            SaveCompressor compressor(encoded);
+            compressor.write(data);
+            compressor.finish();
+            data.swap(encodedData);
+        }
+        writeFileAtomically(filename, data);
+        gameOutput() << "Game saved successfully to: " << filename << std::endl;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error saving game: " << e.what() << std::endl;
+        throw GameException("Failed to save game: " + std::string(e.what()));
+    }
+}
+
+void Kingdom::writeSaveData(std::string& buffer) const {
+    // The stream appends straight to the buffer, so it can be mixed with
+    // direct appends
+    StringAppendBuffer output(buffer);
+    std::ostream saveFile(&output);
+
+    // Save basic kingdom info
+    saveFile << "KINGDOM_DATA\n";
+    appendSaveName(saveFile, name.view());
+    saveFile << "\n";
+    saveFile << currentTurn << "\n";
+    saveFile << (gameOver ? "1" : "0") << "\n";
+
+    // Save population data
+    saveFile << "POPULATION_DATA\n";
+    saveFile << population.getTotalPopulation() << "\n";
+    saveFile << population.getHappiness() << "\n";
+    saveFile << population.getClassPopulation(SocialClass::PEASANT) << "\n";
+    saveFile << population.getClassPopulation(SocialClass::MERCHANT) << "\n";
+    saveFile << population.getClassPopulation(SocialClass::NOBILITY) << "\n";
+    saveFile << population.getClassPopulation(SocialClass::MILITARY) << "\n";
+
+    // Provinces and buildings grow with the realm, so they are appended to
+    // the buffer directly instead of being formatted by the stream.
+    // Save provinces: class populations, happiness, stores, unrest and name
+    if (!provinces.empty()) {
+        buffer += "PROVINCE_DATA\n";
+        for (const Province& province : provinces) {
+            const Population& people = province.getPopulation();
+            for (int c = 0; c < SOCIAL_CLASS_COUNT; c++) {
+                appendNumber(buffer, people.getClassPopulation(static_cast<SocialClass>(c)));
+                buffer += ' ';
+            }
+            appendDecimal(buffer, people.getHappiness());
+            buffer += ' ';
+            for (int store = 0; store < PROVINCE_STORE_COUNT; store++) {
+                appendNumber(buffer, province.getStore(static_cast<ProvinceStore>(store)));
+                buffer += ' ';
+            }
+            appendNumber(buffer, province.getUnrest());
+            buffer += ' ';
+            buffer += province.getName();
+            buffer += '\n';
+        }
+    }
+
+    // Save buildings: type and location
+    if (buildings.size() > 0) {
+        buffer += "BUILDING_DATA\n";
+        for (size_t i = 0; i < buildings.size(); i++) {
+            buffer += getBuildingRecipe(buildings.getType(i)).name;
+            buffer += ' ';
+            appendNumber(buffer, buildings.getLocation(i));
+            buffer += '\n';
+        }
+    }
+
+    // Save construction jobs: type, location and completion turn
+    if (construction.size() > 0) {
+        saveFile << "CONSTRUCTION_DATA\n";
+        for (const ConstructionQueue::Job& job : construction.getJobsInOrder()) {
+            saveFile << getBuildingRecipe(static_cast<BuildingType>(job.type)).name << " "
+                << job.location << " " << job.completionTurn << "\n";
+        }
+    }
+
+    // Save resources
+    saveFile << "RESOURCES_DATA\n";
+    for (const auto& res : resources) {
+        saveFile << res.first << " "
+            << res.second.getQuantity() << " "
+            << res.second.getPrice() << "\n";
+    }
+
+    // Save army data
+    saveFile << "ARMY_DATA\n";
+    saveFile << army->getSize() << "\n";
+    saveFile << army->getTrainingLevel() << "\n";
+    saveFile << army->getMorale() << "\n";
+    saveFile << army->getMaintenanceCost() << "\n";
+    saveFile << (army->getIsPaid() ? "1" : "0") << "\n";
+
+    // Save bank data
+    saveFile << "BANK_DATA\n";
+    saveFile << bank->getTreasury() << "\n";
+    saveFile << bank->getLoanAmount() << "\n";
+    saveFile << bank->getInterestRate() << "\n";
+    saveFile << bank->getLoanDueTime() << "\n";
+    saveFile << bank->getCorruptionLevel() << "\n";
+
+    // Save market data
+    saveFile << "MARKET_DATA\n";
+    saveFile << (market->getIsOpen() ? "1" : "0") << "\n";
+
+    // Save politics data
+    saveFile << "POLITICS_DATA\n";
+    saveFile << politics->getStability() << "\n";
+    saveFile << (politics->hasCivilUnrest() ? "1" : "0") << "\n";
+    saveFile << (politics->isAtWar() ? "1" : "0") << "\n";
+
+    // Add king data if exists
+    if (politics->getCurrentKing()) {
+        saveFile << "KING_DATA\n";
+        appendSaveName(saveFile, politics->getCurrentKing()->getName());
+        saveFile << "\n";
+        saveFile << politics->getCurrentKing()->getInfluence() << "\n";
+        saveFile << politics->getCurrentKing()->getCorruption() << "\n";
+        saveFile << politics->getCurrentKing()->getLeadership() << "\n";
+    }
+}
+
+void Kingdom::enableAutosave(const std::string& filename, int interval) {
+    if (filename.empty() || interval < 1) {
+        throw GameException("Autosave needs a file name and an interval of at least one turn");
+    }
+    if (!autosaver) {
+        autosaver = std::make_unique<SaveWriter>();
+    }
+    autosaveFile = filename;
+    autosaveInterval = interval;
+}
+
+void Kingdom::disableAutosave() {
+    autosaver.reset();
+    autosaveInterval = 0;
+}
+
+const SaveWriter* Kingdom::getAutosaver() const {
+    return autosaver.get();
+}
+
+void Kingdom::autosave() {
+    std::string error = autosaver->takeLastError();
+    if (!error.empty()) {
+        gameOutput() << "Autosave failed: " << error << std::endl;
+    }
+
+    // Only the snapshot happens on this thread; the writer does the disk work
+    writeSaveData(autosaveBuffer);
+    autosaver->submit(autosaveFile, autosaveBuffer);
+}
+
+// Update loadGameState method to fix the string parsing issues
+void Kingdom::loadGameState(const std::string& filename) {
+    try {
+        // The file is parsed and checked in one pass before anything changes
+        SaveContents contents;
+        SaveParser parser(contents);
+        readSaveStream(filename, [&parser](std::string_view text) {
+            parser.feed(text);
+            });
+        parser.finish();
+
+        applySave(contents);
+        gameOutput() << "Game loaded successfully from: " << filename << std::endl;
+    }
+    catch (const SaveFormatException& e) {
+        std::cerr << "Error loading game: " << e.what() << std::endl;
+        throw;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error loading game: " << e.what() << std::endl;
+        throw GameException("Failed to load game: " + std::string(e.what()));
+    }
+}
+
+void Kingdom::applySave(const SaveContents& contents) {
+    // The parser has checked every record, so only the names can still be
+    // refused. They are interned and the new kingdom name is claimed before
+    // anything changes, so a refused save leaves the kingdom as it was.
+    Name savedName(contents.kingdomName);
+    std::vector<Name> provinceNames;
+    provinceNames.reserve(contents.provinces.size());
+    for (const SaveContents::ProvinceRecord& record : contents.provinces) {
+        provinceNames.emplace_back(record.name);
+    }
+    politics->getDiplomacy().rename(politics->getKingdomId(), savedName);
+
+    name = savedName;
+    currentTurn = contents.turn;
+    gameOver = contents.gameOver;
+
+    // Citizen agents are rebuilt from the saved cohorts
+    bool citizenAgents = population.hasCitizenAgents();
+    population = Population(contents.totalPopulation);
+    population.adjustHappiness(contents.happiness - population.getHappiness());
+    for (int c = 0; c < SOCIAL_CLASS_COUNT; c++) {
+        population.setClassPopulation(static_cast<SocialClass>(c), contents.classPopulation[c]);
+    }
+
+    // Provinces and their epidemic regions are rebuilt from the file
+    provinces.clear();
+    buildings.clear();
+    construction.clear();
+    epidemic = Epidemic(1);
+    for (const SaveContents::ProvinceRecord& record : contents.provinces) {
+        Province& province = addProvince(record.name, 0);
+        for (int c = 0; c < SOCIAL_CLASS_COUNT; c++) {
+            province.getPopulation().setClassPopulation(static_cast<SocialClass>(c), record.classPopulation[c]);
+        }
+        province.getPopulation().adjustHappiness(record.happiness - province.getPopulation().getHappiness());
+        for (int store = 0; store < PROVINCE_STORE_COUNT; store++) {
+            province.setStore(static_cast<ProvinceStore>(store), record.stores[store]);
+        }
+        province.setUnrest(record.unrest);
+    }
+    for (const SaveContents::BuildingRecord& record : contents.buildings) {
+        buildings.add(record.type, record.location);
+    }
+    for (const SaveContents::ConstructionRecord& record : contents.construction) {
+        construction.enqueue(record.type, record.location, record.completionTurn);
+    }
+
+    // Resources this version does not know are skipped
+    for (const SaveContents::ResourceRecord& record : contents.resources) {
+        Resource<int>* resource = getResource(record.name);
+        if (resource) {
+            resource->setQuantity(record.quantity);
+            resource->setPrice(record.price);
+        }
+    }
+
+    if (contents.hasArmy) {
+        army = std::make_unique<Army>(contents.armySize);
+    }
+    if (contents.hasBank) {
+        bank = std::make_unique<Bank>(contents.treasury);
+        bank->setCorruptionLevel(contents.corruptionLevel);
+    }
+
+    if (citizenAgents) {
+        population.enableCitizenAgents();
+    }
+    publishStatus();
+}
+
+bool Kingdom::validateSaveFile(const std::string& filename) {
+    try {
+        SaveContents contents;
+        SaveParser parser(contents);
+        readSaveStream(filename, [&parser](std::string_view text) {
+            parser.feed(text);
+            });
+        parser.finish();
+        return true;
+    }
+    catch (const GameException& e) {
+        std::cerr << "Error: " << filename << " is not a valid save file: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+void Kingdom::randomEvent() {
+    CounterRandom random = getRandom(RandomSlot::EVENT, currentTurn);
+    int eventType = random.nextInt(0, 5);
+
+    switch (eventType) {
+    case 0: // Plague
+        gameOutput() << "A plague has broken out in your kingdom!" << endl;
+        epidemic.seed(0, 0.02);
+        population.triggerPlague();
+        break;
+    case 1: // Good harvest
+        gameOutput() << "Excellent harvest this year! Food supplies increased." << endl;
+        addUpToCapacity(resources.at("food"), 100);
+        break;
+    case 2: // Drought
+        gameOutput() << "A severe drought has affected your kingdom. Food production decreased." << endl;
+        resources.at("food").consumeQuantity(resources.at("food").getQuantity() / 3);
+        break;
+    case 3: // Gold discovery
+        gameOutput() << "Gold has been discovered in your kingdom!" << endl;
+        addUpToCapacity(resources.at("gold"), 20);
+        break;
+    case 4: // Trade opportunity
+        gameOutput() << "A foreign merchant offers special trade opportunities." << endl;
+        // Implementation would depend on other mechanics
+        break;
+    case 5: // Assassination attempt
+        if (politics->getCurrentKing()) {
+            gameOutput() << "An assassination attempt on King " << politics->getCurrentKing()->getName() << "!" << endl;
+            int success = random.nextInt(1, 100);
+            if (success <= 20) { // 20% chance of success
+                gameOutput() << "The king has been assassinated!" << endl;
+                // Set king to nullptr and trigger election
+                gameOver = true;
+            }
+            else {
+                gameOutput() << "The assassination attempt was foiled!" << endl;
+            }
+        }
+        break;
+    }
+}
+
+// World Implementation
+World::World(bool stagedTurns) : staged(stagedTurns), currentTurn(1) {
+    std::mt19937& gen = gameRandom();
+    seed = (static_cast<uint64_t>(gen()) << 32) | gen();
+}
+
+Kingdom& World::addKingdom(const Name& name) {
+    KingdomId existing;
+    if (diplomacy.find(name.view(), existing)) {
+        throw GameException("There is already a kingdom called " + name.str());
+    }
+    kingdoms.push_back(std::make_unique<Kingdom>(name, &diplomacy));
+    kingdoms.back()->setRandomSeed(seed);
+    return *kingdoms.back();
+}
+
+size_t World::getKingdomCount() const {
+    return kingdoms.size();
+}
+
+Kingdom& World::getKingdom(size_t index) {
+    if (index >= kingdoms.size()) {
+        throw GameException("No kingdom number " + std::to_string(index));
+    }
+    return *kingdoms[index];
+}
+
+Diplomacy& World::getDiplomacy() {
+    return diplomacy;
+}
+
+void World::setSeed(uint64_t worldSeed) {
+    seed = worldSeed;
+    for (const auto& kingdom : kingdoms) {
+        kingdom->setRandomSeed(seed);
+    }
+}
+
+uint64_t World::getSeed() const {
+    return seed;
+}
+
+void World::setStaged(bool stagedTurns) {
+    staged = stagedTurns;
+}
+
+bool World::isStaged() const {
+    return staged;
+}
+
+int World::getCurrentTurn() const {
+    return currentTurn;
+}
+
+const InstrumentationReport& World::getTurnCosts() const {
+    return turnCosts;
+}
+
+void World::processTurn() {
+    InstrumentationReport countsBefore;
+    if (isInstrumented()) {
+        countsBefore = readInstrumentation();
+    }
+
+    std::vector<Kingdom*> playing;
+    playing.reserve(kingdoms.size());
+    for (const auto& kingdom : kingdoms) {
+        if (!kingdom->isGameOver()) {
+            playing.push_back(kingdom.get());
+        }
+    }
+
+    if (!staged) {
+        for (Kingdom* kingdom : playing) {
+            kingdom->processTurn();
+        }
+    }
+    else {
+        for (int phase = static_cast<int>(TurnPhase::EVENTS); phase <= static_cast<int>(TurnPhase::POLITICS); phase++) {
+            TurnPhase current = static_cast<TurnPhase>(phase);
+            TurnPhaseScope scope(current);
+            if (current == TurnPhase::PROVINCES) {
+                // Provinces only touch their own state, so those of every
+                // kingdom advance together as one parallel job instead of
+                // one small job per kingdom
+                std::vector<size_t> firstProvince(playing.size() + 1, 0);
+                for (size_t k = 0; k < playing.size(); k++) {
+                    firstProvince[k + 1] = firstProvince[k] + playing[k]->getProvinceCount();
+                }
+                WorkerPool::shared().parallelFor(firstProvince.back(), provinceGrainSize, [&](size_t begin, size_t end) {
+                    size_t k = std::upper_bound(firstProvince.begin(), firstProvince.end(), begin) - firstProvince.begin() - 1;
+                    while (begin < end) {
+                        size_t stop = std::min(end, firstProvince[k + 1]);
+                        playing[k]->advanceProvinces(begin - firstProvince[k], stop - firstProvince[k]);
+                        begin = stop;
+                        k++;
+                    }
+                });
+                for (Kingdom* kingdom : playing) {
+                    kingdom->reviewProvinces();
+                }
+            }
+            else if (current == TurnPhase::EVENTS) {
+                randomDraws.generate(playing, RandomSlot::EVENT_CHANCE, 1);
+                for (size_t k = 0; k < playing.size(); k++) {
+                    playing[k]->updateEvents(randomDraws.getDraws(k)[0]);
+                }
+            }
+            else if (current == TurnPhase::ECONOMY) {
+                size_t shocks = 0;
+                for (Kingdom* kingdom : playing) {
+                    if (kingdom->getMarket()) {
+                        shocks = std::max(shocks, kingdom->getMarket()->getPriceCount());
+                    }
+                }
+                randomDraws.generate(playing, RandomSlot::MARKET, shocks);
+
+                // Banks and markets share nothing, within a kingdom or across
+                // kingdoms: the first half of the range ticks the banks while
+                // the second half moves the prices
+                size_t count = playing.size();
+                WorkerPool::shared().parallelFor(count * 2, 256, [&](size_t begin, size_t end) {
+                    for (size_t i = begin; i < end; i++) {
+                        if (i < count) {
+                            playing[i]->updateBank();
+                        }
+                        else {
+                            playing[i - count]->updateMarket(randomDraws.getDraws(i - count));
+                        }
+                    }
+                });
+            }
+            else {
+                for (Kingdom* kingdom : playing) {
+                    kingdom->updatePhase(current);
+                }
+            }
+        }
+        for (Kingdom* kingdom : playing) {
+            kingdom->finishTurn();
+            if (!isHeadless()) {
+                renderStatus(std::cout, kingdom->readStatus());
+            }
+        }
+    }
+    currentTurn++;
+
+    if (isInstrumented()) {
+        turnCosts = readInstrumentation() - countsBefore;
+    }
+}
+
+// PolicyOptimizer Implementation
+PolicyOptimizer::PolicyOptimizer(const OptimizerSettings& optimizerSettings) :
+    settings(optimizerSettings), rng(optimizerSettings.seed), generation(0), firstGeneration(0),
+    simulatedTurns(0), simulationSeconds(0.0) {
+
+    if (settings.populationSize < 2) {
+        throw GameException("Optimizer needs at least two candidate policies");
+    }
+    settings.eliteCount = std::max(0, std::min(settings.eliteCount, settings.populationSize));
+    settings.tournamentSize = std::max(1, settings.tournamentSize);
+    settings.seedsPerPolicy = std::max(1, settings.seedsPerPolicy);
+
+    // Start from the default ruler plus random candidates
+    candidates.resize(settings.populationSize);
+    for (size_t i = 1; i < candidates.size(); i++) {
+        candidates[i].policy = randomPolicy();
+    }
+}
+
+RulerPolicy PolicyOptimizer::randomPolicy() {
+    RulerPolicy policy;
+    for (int i = 0; i < RulerPolicy::GENE_COUNT; i++) {
+        std::uniform_real_distribution<> distrib(RulerPolicy::minValue(i), RulerPolicy::maxValue(i));
+        policy.genes[i] = distrib(rng);
+    }
+    return policy;
+}
+
+RulerPolicy PolicyOptimizer::crossover(const RulerPolicy& first, const RulerPolicy& second) {
+    // Blend crossover: each gene is drawn between (and slightly beyond) the parents
+    std::uniform_real_distribution<> distrib(-0.25, 1.25);
+    RulerPolicy child;
+    for (int i = 0; i < RulerPolicy::GENE_COUNT; i++) {
+        double weight = distrib(rng);
+        child.genes[i] = first.genes[i] + weight * (second.genes[i] - first.genes[i]);
+    }
+    child.clamp();
+    return child;
+}
+
+void PolicyOptimizer::mutate(RulerPolicy& policy) {
+    std::uniform_real_distribution<> chance(0.0, 1.0);
+    std::normal_distribution<> noise(0.0, settings.mutationScale);
+    for (int i = 0; i < RulerPolicy::GENE_COUNT; i++) {
+        if (chance(rng) < settings.mutationRate) {
+            double range = RulerPolicy::maxValue(i) - RulerPolicy::minValue(i);
+            policy.genes[i] += noise(rng) * range;
+        }
+    }
+    policy.clamp();
+}
+
+const ScoredPolicy& PolicyOptimizer::tournament() {
+    std::uniform_int_distribution<size_t> pick(0, candidates.size() - 1);
+    const ScoredPolicy* winner = &candidates[pick(rng)];
+    for (int i = 1; i < settings.tournamentSize; i++) {
+        const ScoredPolicy& challenger = candidates[pick(rng)];
+        if (challenger.fitness > winner->fitness) {
+            winner = &challenger;
+        }
+    }
+    return *winner;
+}
+
+double PolicyOptimizer::simulate(const RulerPolicy& policy, unsigned int seed, int turns, int& turnsPlayed) {
+    bool wasHeadless = isHeadless();
+    setHeadless(true);
+    seedGameRandom(seed);
+
+    Kingdom kingdom("Simulation");
+    std::unique_ptr<King> ruler = std::make_unique<King>("Regent", 50, 20, 50, "Economic");
+    ruler->setPolicy(policy);
+    kingdom.getPolitics()->electKing(std::move(ruler));
+
+    turnsPlayed = 0;
+    while (turnsPlayed < turns && !kingdom.isGameOver() &&
+        kingdom.getPopulation().getTotalPopulation() > 0) {
+        try {
+            kingdom.processTurn();
+        }
+        catch (const GameException&) {
+            // A failed action ends the turn early, as it does in the interactive game
+        }
+        turnsPlayed++;
+    }
+
+    // Survival dominates; surviving kingdoms are ranked by how well they are doing,
+    // with each measure squashed into [0, 1) so it never outweighs a turn survived
+    double fitness = turnsPlayed;
+    if (!kingdom.isGameOver()) {
+        Bank* bank = kingdom.getBank();
+        double people = kingdom.getPopulation().getTotalPopulation() / 1000.0;
+        double wealth = std::max(0.0, bank->getTreasury() - bank->getLoanAmount()) / 1000.0;
+        fitness += (people / (1.0 + people) + wealth / (1.0 + wealth) +
+            kingdom.getPopulation().getHappiness() / 100.0) / 3.0;
+    }
+
+    setHeadless(wasHeadless);
+    return fitness;
+}
+
+void PolicyOptimizer::evaluateCandidates() {
+    // Every candidate faces the same seeds this generation so scores are comparable
+    std::vector<unsigned int> seeds(settings.seedsPerPolicy);
+    for (auto& seed : seeds) {
+        seed = rng();
+    }
+
+    size_t evaluations = candidates.size() * seeds.size();
+    std::vector<double> scores(evaluations);
+    std::vector<int> turns(evaluations);
+
+    auto start = std::chrono::steady_clock::now();
+    WorkerPool::shared().parallelFor(evaluations, 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const RulerPolicy& policy = candidates[i / seeds.size()].policy;
+            scores[i] = simulate(policy, seeds[i % seeds.size()], settings.turnsPerEvaluation, turns[i]);
+        }
+        });
+    simulationSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (size_t c = 0; c < candidates.size(); c++) {
+        double total = 0.0;
+        for (size_t s = 0; s < seeds.size(); s++) {
+            total += scores[c * seeds.size() + s];
+            simulatedTurns += turns[c * seeds.size() + s];
+        }
+        candidates[c].fitness = total / seeds.size();
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [](const ScoredPolicy& a, const ScoredPolicy& b) {
+        return a.fitness > b.fitness;
+        });
+}
+
+void PolicyOptimizer::evolve() {
+    std::vector<ScoredPolicy> next(candidates.begin(), candidates.begin() + settings.eliteCount);
+    while (static_cast<int>(next.size()) < settings.populationSize) {
+        ScoredPolicy child;
+        child.policy = crossover(tournament().policy, tournament().policy);
+        mutate(child.policy);
+        next.push_back(child);
+    }
+    candidates = std::move(next);
+    generation++;
+}
+
+void PolicyOptimizer::run() {
+    while (true) {
+        evaluateCandidates();
+
+        const ScoredPolicy& best = getBest();
+        gameOutput() << "Generation " << generation << ": best fitness " << best.fitness
+            << " (" << static_cast<long long>(getTurnsPerSecond()) << " turns/s)" << endl;
+
+        if (!settings.checkpointFile.empty()) {
+            saveCheckpoint(settings.checkpointFile);
+        }
+
+        if (generation + 1 - firstGeneration >= settings.generations) {
+            break;
+        }
+        evolve();
+    }
+}
+
+int PolicyOptimizer::getGeneration() const {
+    return generation;
+}
+
+const ScoredPolicy& PolicyOptimizer::getBest() const {
+    return candidates.front();
+}
+
+long long PolicyOptimizer::getSimulatedTurns() const {
+    return simulatedTurns;
+}
+
+double PolicyOptimizer::getTurnsPerSecond() const {
+    return simulationSeconds > 0 ? simulatedTurns / simulationSeconds : 0.0;
+}
+
+void PolicyOptimizer::saveCheckpoint(const std::string& filename) const {
+    std::ostringstream file;
+    size_t count = std::min<size_t>(candidates.size(), std::max(1, settings.eliteCount));
+    file << "POLICY_CHECKPOINT\n";
+    file << generation << "\n";
+    file << count << "\n";
+    file.precision(17);
+    for (size_t i = 0; i < count; i++) {
+        file << candidates[i].fitness;
+        for (double gene : candidates[i].policy.genes) {
+            file << " " << gene;
+        }
+        file << "\n";
+    }
+
+    // An interrupted run keeps the old checkpoint
+    writeFileAtomically(filename, file.str());
+}
+
+bool PolicyOptimizer::loadCheckpoint(const std::string& filename) {
+    std::ifstream file(filename);
+    std::string header;
+    int savedGeneration = 0;
+    size_t count = 0;
+    if (!file.is_open() || !std::getline(file, header) || header != "POLICY_CHECKPOINT" ||
+        !(file >> savedGeneration >> count) || savedGeneration < 0) {
+        return false;
+    }
+
+    // Read the whole file before touching the optimizer, so a damaged
+    // checkpoint leaves it as it was
+    std::vector<ScoredPolicy> saved(std::min(count, candidates.size()));
+    for (ScoredPolicy& candidate : saved) {
+        file >> candidate.fitness;
+        for (double& gene : candidate.policy.genes) {
+            file >> gene;
+        }
+        if (!file) {
+            return false;
+        }
+        candidate.policy.clamp();
+    }
+
+    // Saved genomes replace the front of the population; the rest stay random
+    std::copy(saved.begin(), saved.end(), candidates.begin());
+    generation = savedGeneration + 1;
+    firstGeneration = generation;
+    return true;
+}
+// GameServer Implementation
+namespace {
+    constexpr int MAX_TURNS_PER_COMMAND = 1000;
+    constexpr size_t SESSION_GRAIN = 8;
+    constexpr size_t MAX_PENDING_OUTPUT = 1 << 20;   // stop running a session's commands until its replies drain
+    constexpr int MAX_EPOLL_EVENTS = 1024;
+
+    size_t splitWords(std::string_view line, std::string_view* words, size_t capacity) {
+        size_t count = 0;
+        size_t position = 0;
+        while (position < line.size()) {
+            while (position < line.size() && (line[position] == ' ' || line[position] == '\t' || line[position] == '\r')) {
+                position++;
+            }
+            size_t start = position;
+            while (position < line.size() && line[position] != ' ' && line[position] != '\t' && line[position] != '\r') {
+                position++;
+            }
+            if (position > start) {
+                if (count == capacity) {
+                    throw GameException("Too many arguments");
+                }
+                words[count++] = line.substr(start, position - start);
+            }
+        }
+        return count;
+    }
+
+    template<typename T>
+    T parseArgument(std::string_view text, const char* what) {
+        T value{};
+        auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (result.ec != std::errc() || result.ptr != text.data() + text.size()) {
+            throw GameException("Invalid " + std::string(what) + ": " + std::string(text));
+        }
+        return value;
+    }
+}
+
+std::string GameServer::handleCommand(std::unique_ptr<Kingdom>& kingdom, std::string_view line, bool& closeAfterReply) {
+    try {
+        std::string_view words[4];
+        size_t wordCount = splitWords(line, words, 4);
+        if (wordCount == 0) {
+            throw GameException("Empty command");
+        }
+
+        std::string_view command = words[0];
+        if (command == "PING") {
+            return "OK PONG";
+        }
+        if (command == "QUIT") {
+            closeAfterReply = true;
+            return "OK BYE";
+        }
+        if (command == "NEW") {
+            if (wordCount < 2) {
+                throw GameException("Usage: NEW <kingdom> [ruler]");
+            }
+            auto founded = std::make_unique<Kingdom>(words[1]);
+            std::unique_ptr<King> king = std::make_unique<King>(
+                wordCount > 2 ? words[2] : std::string_view("Regent"), 50, 20, 50, "Benevolent");
+            founded->getPolitics()->electKing(std::move(king));
+            kingdom = std::move(founded);
+            return "OK " + std::string(words[1]);
+        }
+
+        if (!kingdom) {
+            throw GameException("No kingdom yet, send NEW <kingdom> first");
+        }
+
+        std::ostringstream reply;
+        reply << "OK ";
+        if (command == "TURN") {
+            int turns = wordCount > 1 ? parseArgument<int>(words[1], "turn count") : 1;
+            if (turns < 1 || turns > MAX_TURNS_PER_COMMAND) {
+                throw GameException("Turn count must be between 1 and " + std::to_string(MAX_TURNS_PER_COMMAND));
+            }
+            for (int i = 0; i < turns && !kingdom->isGameOver(); i++) {
+                try {
+                    kingdom->processTurn();
+                }
+                catch (const GameException&) {
+                    // A failed action ends the turn early, as it does in the interactive game
+                }
+            }
+            reply << "turn=" << kingdom->getCurrentTurn() << (kingdom->isGameOver() ? " gameover" : "");
+        }
+        else if (command == "STATUS") {
+            renderStatusLine(reply, kingdom->captureStatus());
+        }
+        else if (command == "TAX") {
+            if (wordCount < 2) {
+                throw GameException("Usage: TAX <rate>");
+            }
+            kingdom->collectTaxes(parseArgument<double>(words[1], "tax rate"));
+            reply << "gold=" << kingdom->getResource("gold")->getQuantity();
+        }
+        else if (command == "BUILD") {
+            if (wordCount < 2) {
+                throw GameException("Usage: BUILD <building> [location]");
+            }
+            size_t location = wordCount > 2 ? parseArgument<size_t>(words[2], "location") : 0;
+            kingdom->buildStructure(std::string(words[1]), location);
+            reply << "construction=" << kingdom->getConstruction().size();
+        }
+        else if (command == "RECRUIT") {
+            if (wordCount < 2) {
+                throw GameException("Usage: RECRUIT <soldiers>");
+            }
+            int count = parseArgument<int>(words[1], "soldier count");
+            Population& population = kingdom->getPopulation();
+            if (count > population.getClassPopulation(SocialClass::PEASANT)) {
+                throw GameException("Not enough peasants to recruit");
+            }
+            kingdom->getArmy()->recruit(count, population.getTotalPopulation());
+            population.migrate(SocialClass::PEASANT, SocialClass::MILITARY, count);
+            reply << "army=" << kingdom->getArmy()->getSize();
+        }
+        else if (command == "PROVINCE") {
+            if (wordCount < 3) {
+                throw GameException("Usage: PROVINCE <name> <settlers>");
+            }
+            kingdom->foundProvince(std::string(words[1]), parseArgument<int>(words[2], "settler count"));
+            reply << "provinces=" << kingdom->getProvinceCount();
+        }
+        else {
+            throw GameException("Unknown command: " + std::string(command));
+        }
+        return reply.str();
+    }
+    catch (const std::exception& e) {
+        return "ERR " + std::string(e.what());
+    }
+}
+
+#ifdef __linux__
+
+struct GameServer::Session {
+    int fd = -1;
+    std::string input;
+    std::string output;
+    size_t outputSent = 0;
+    NameScope names;            // outlives the kingdom, whose names it holds
+    std::unique_ptr<Kingdom> kingdom;
+    bool queued = false;        // already in this round's ready list
+    bool closing = false;       // close once the pending output is written
+    uint32_t interest = EPOLLIN | EPOLLRDHUP;   // the events epoll watches for now
+
+    explicit Session(size_t nameLimit) : names(nameLimit) {}
+
+    bool hasCommand() const {
+        return output.size() - outputSent < MAX_PENDING_OUTPUT &&
+            input.find('\n') != std::string::npos;
+    }
+};
+
+GameServer::GameServer(const ServerSettings& serverSettings)
+    : settings(serverSettings), listenFd(-1), epollFd(-1), wakeFd(-1), stopping(false), commandsHandled(0) {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd < 0 || wakeFd < 0) {
+        if (epollFd >= 0) ::close(epollFd);
+        if (wakeFd >= 0) ::close(wakeFd);
+        throw GameException("Could not create the server event loop: " + std::string(std::strerror(errno)));
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.ptr = &wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+
+    try {
+        openListener();
+    }
+    catch (...) {
+        ::close(epollFd);
+        ::close(wakeFd);
+        throw;
+    }
+}
+
+GameServer::~GameServer() {
+    for (auto& entry : sessions) {
+        ::close(entry.first);
+    }
+    if (listenFd >= 0) {
+        ::close(listenFd);
+        if (!settings.unixPath.empty()) {
+            ::unlink(settings.unixPath.c_str());
+        }
+    }
+    ::close(wakeFd);
+    ::close(epollFd);
+}
+
+void GameServer::openListener() {
+    if (!settings.unixPath.empty()) {
+        sockaddr_un address{};
+        if (settings.unixPath.size() >= sizeof(address.sun_path)) {
+            throw GameException("Socket path is too long: " + settings.unixPath);
+        }
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, settings.unixPath.c_str(), settings.unixPath.size() + 1);
+        listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        ::unlink(settings.unixPath.c_str());
+        if (listenFd < 0 || bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            throw GameException("Could not bind " + settings.unixPath + ": " + std::strerror(errno));
+        }
+    }
+    else {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<uint16_t>(settings.tcpPort));
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int reuse = 1;
+        if (listenFd >= 0) {
+            setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        }
+        if (listenFd < 0 || bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            throw GameException("Could not bind 127.0.0.1:" + std::to_string(settings.tcpPort) + ": " + std::strerror(errno));
+        }
+    }
+
+    if (listen(listenFd, SOMAXCONN) != 0) {
+        throw GameException("Could not listen for sessions: " + std::string(std::strerror(errno)));
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event);
+}
+
+void GameServer::acceptSessions() {
+    while (true) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            // EAGAIN means the backlog is drained; anything else is retried on the next wakeup
+            return;
+        }
+        if (sessions.size() >= settings.maxSessions) {
+            static const char full[] = "ERR Server is full\n";
+            ssize_t ignored = ::write(fd, full, sizeof(full) - 1);
+            (void)ignored;
+            ::close(fd);
+            continue;
+        }
+        if (settings.unixPath.empty()) {
+            int noDelay = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        }
+
+        auto session = std::make_unique<Session>(settings.maxNamesPerSession);
+        session->fd = fd;
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.ptr = session.get();
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+        sessions.emplace(fd, std::move(session));
+    }
+}
+
+void GameServer::readSession(Session& session) {
+    char buffer[16 * 1024];
+    while (true) {
+        ssize_t received = ::read(session.fd, buffer, sizeof(buffer));
+        if (received > 0) {
+            session.input.append(buffer, static_cast<size_t>(received));
+            continue;
+        }
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        // The client hung up; commands it already sent are still answered
+        session.closing = true;
+        break;
+    }
+
+    // A line that never ends would grow the buffer without bound
+    size_t lastNewline = session.input.rfind('\n');
+    size_t unterminated = lastNewline == std::string::npos ? session.input.size() : session.input.size() - lastNewline - 1;
+    if (unterminated > settings.maxLineLength) {
+        session.input.clear();
+        session.output += "ERR Line too long\n";
+        session.closing = true;
+    }
+}
+
+void GameServer::executeLines(Session& session) {
+    NameScope::Guard names(session.names);
+    size_t start = 0;
+    long long executed = 0;
+    while (session.output.size() - session.outputSent < MAX_PENDING_OUTPUT) {
+        size_t end = session.input.find('\n', start);
+        if (end == std::string::npos) {
+            break;
+        }
+        bool closeAfterReply = false;
+        session.output += handleCommand(session.kingdom, std::string_view(session.input).substr(start, end - start), closeAfterReply);
+        session.output += '\n';
+        start = end + 1;
+        executed++;
+        if (closeAfterReply) {
+            session.closing = true;
+            start = session.input.size();
+            break;
+        }
+    }
+    session.input.erase(0, start);
+    commandsHandled.fetch_add(executed, std::memory_order_relaxed);
+
+    // Reply straight away rather than after the rest of the batch
+    sendOutput(session);
+}
+
+void GameServer::sendOutput(Session& session) {
+    while (session.outputSent < session.output.size()) {
+        ssize_t sent = ::send(session.fd, session.output.data() + session.outputSent,
+            session.output.size() - session.outputSent, MSG_NOSIGNAL);
+        if (sent > 0) {
+            session.outputSent += static_cast<size_t>(sent);
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        // The peer is gone, so the rest of its replies can be dropped
+        session.output.clear();
+        session.outputSent = 0;
+        session.closing = true;
+        session.input.clear();
+        return;
+    }
+
+    if (session.outputSent == session.output.size()) {
+        session.output.clear();
+        session.outputSent = 0;
+    }
+}
+
+void GameServer::writeSession(Session& session) {
+    sendOutput(session);
+    watchSession(session);
+}
+
+void GameServer::watchSession(Session& session) {
+    // Only ask for writability while replies are backed up, and stop reading
+    // once the client has hung up: the events are level-triggered, so a
+    // half-closed socket would otherwise wake the loop until the replies drain
+    uint32_t interest = (session.closing ? 0u : EPOLLIN | EPOLLRDHUP) |
+        (session.output.empty() ? 0u : EPOLLOUT);
+    if (interest != session.interest) {
+        epoll_event event{};
+        event.events = interest;
+        event.data.ptr = &session;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, session.fd, &event);
+        session.interest = interest;
+    }
+}
+
+void GameServer::closeSession(Session& session) {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, session.fd, nullptr);
+    ::close(session.fd);
+    sessions.erase(session.fd);
+}
+
+void GameServer::runReadySessions() {
+    WorkerPool::shared().parallelFor(ready.size(), SESSION_GRAIN, [this](size_t begin, size_t end) {
+        bool wasHeadless = isHeadless();
+        setHeadless(true);
+        for (size_t i = begin; i < end; i++) {
+            executeLines(*ready[i]);
+        }
+        setHeadless(wasHeadless);
+        });
+
+    // A session that stopped for its replies to drain and has drained them
+    // goes straight into the next round, as nothing else would wake it
+    size_t kept = 0;
+    for (Session* session : ready) {
+        writeSession(*session);
+        if (session->hasCommand()) {
+            ready[kept++] = session;
+            continue;
+        }
+        session->queued = false;
+        if (session->closing && session->output.empty()) {
+            closeSession(*session);
+        }
+    }
+    ready.resize(kept);
+}
+
+void GameServer::run() {
+    epoll_event events[MAX_EPOLL_EVENTS];
+    std::vector<Session*> hungUp;
+    while (!stopping.load()) {
+        int count = epoll_wait(epollFd, events, MAX_EPOLL_EVENTS, ready.empty() ? -1 : 0);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw GameException("Server event loop failed: " + std::string(std::strerror(errno)));
+        }
+
+        for (int i = 0; i < count; i++) {
+            void* source = events[i].data.ptr;
+            if (source == nullptr) {
+                acceptSessions();
+                continue;
+            }
+            if (source == &wakeFd) {
+                uint64_t signals;
+                ssize_t ignored = ::read(wakeFd, &signals, sizeof(signals));
+                (void)ignored;
+                continue;
+            }
+
+            Session& session = *static_cast<Session*>(source);
+            if (events[i].events & EPOLLOUT) {
+                writeSession(session);
+            }
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                readSession(session);
+                watchSession(session);
+            }
+            if (session.hasCommand()) {
+                if (!session.queued) {
+                    session.queued = true;
+                    ready.push_back(&session);
+                }
+            }
+            else if (session.closing && !session.queued) {
+                hungUp.push_back(&session);
+            }
+        }
+
+        // Sessions closed here are not in the ready list
+        for (Session* session : hungUp) {
+            writeSession(*session);
+            if (session->output.empty()) {
+                closeSession(*session);
+            }
+        }
+        hungUp.clear();
+
+        runReadySessions();
+    }
+}
+
+void GameServer::stop() {
+    stopping.store(true);
+    uint64_t signal = 1;
+    ssize_t ignored = ::write(wakeFd, &signal, sizeof(signal));
+    (void)ignored;
+}
+
+#else
+
+struct GameServer::Session {
+};
+
+GameServer::GameServer(const ServerSettings& serverSettings)
+    : settings(serverSettings), listenFd(-1), epollFd(-1), wakeFd(-1), stopping(false), commandsHandled(0) {
+    throw GameException("Server mode needs epoll and is only available on Linux");
+}
+
+GameServer::~GameServer() {
+}
+
+void GameServer::run() {
+}
+
+void GameServer::stop() {
+}
+
+#endif
+
+size_t GameServer::getSessionCount() const {
+    return sessions.size();
+}
+
+long long GameServer::getCommandsHandled() const {
+    return commandsHandled.load(std::memory_order_relaxed);
+}
+
+// RealtimeGame Implementation
+namespace {
+    constexpr double MIN_TICK_RATE = 0.1;
+    constexpr double MAX_TICK_RATE = 1000.0;
+
+    double checkTickRate(double ticksPerSecond) {
+        if (!(ticksPerSecond >= MIN_TICK_RATE && ticksPerSecond <= MAX_TICK_RATE)) {
+            throw GameException("Tick rate must be between 0.1 and 1000 turns per second");
+        }
+        return ticksPerSecond;
+    }
+}
+
+RealtimeGame::RealtimeGame(std::unique_ptr<Kingdom> startingKingdom, double rate, std::function<void(const std::string&)> reportLine, double statusPeriod)
+    : kingdom(std::move(startingKingdom)), report(std::move(reportLine)), ticksPerSecond(checkTickRate(rate)),
+    statusSeconds(statusPeriod), paused(false), rescheduled(true), stopping(false), renderStopping(false), running(false),
+    ticks(0), lateTicks(0), commandsHandled(0), droppedReplies(0) {
+    if (!kingdom) {
+        throw GameException("Real-time mode needs a kingdom to run");
+    }
+}
+
+RealtimeGame::~RealtimeGame() {
+    stop();
+}
+
+void RealtimeGame::start() {
+    if (simulation.joinable()) {
+        return;
+    }
+    publishView();
+    stopping.store(false);
+    renderStopping.store(false);
+    running.store(true);
+    renderer = std::thread(&RealtimeGame::renderLoop, this);
+    simulation = std::thread(&RealtimeGame::simulationLoop, this);
+}
+
+bool RealtimeGame::submit(std::string line) {
+    if (!running.load() || !commands.push(line)) {
+        return false;
+    }
+    // Taking the lock orders the push before the simulation thread's last
+    // look at the queue, so it cannot go to sleep and miss this command
+    {
+        std::lock_guard<std::mutex> guard(wakeMutex);
+    }
+    wake.notify_one();
+    return true;
+}
+
+std::unique_ptr<Kingdom> RealtimeGame::stop() {
+    if (simulation.joinable()) {
+        {
+            std::lock_guard<std::mutex> guard(wakeMutex);
+            stopping.store(true);
+        }
+        wake.notify_one();
+        simulation.join();
+    }
+    if (renderer.joinable()) {
+        {
+            std::lock_guard<std::mutex> guard(renderMutex);
+            renderStopping.store(true);
+        }
+        renderWake.notify_one();
+        renderer.join();
+    }
+    return std::move(kingdom);
+}
+
+void RealtimeGame::simulationLoop() {
+    using Clock = std::chrono::steady_clock;
+
+    // Turns run without the interactive pauses and commentary
+    setHeadless(true);
+    Clock::time_point nextTick = Clock::now();
+    std::string line;
+    while (running.load()) {
+        bool changed = false;
+        while (running.load() && commands.pop(line)) {
+            post(runCommand(line));
+            commandsHandled.fetch_add(1, std::memory_order_relaxed);
+            changed = true;
+        }
+        if (changed) {
+            kingdom->publishStatus();
+            publishView();
+        }
+        if (stopping.load() || !running.load()) {
+            break;
+        }
+
+        std::chrono::duration<double> interval(1.0 / ticksPerSecond);
+        Clock::time_point now = Clock::now();
+        if (rescheduled) {
+            rescheduled = false;
+            nextTick = now + std::chrono::duration_cast<Clock::duration>(interval);
+        }
+        bool ticking = !paused && !kingdom->isGameOver();
+        if (ticking && now >= nextTick) {
+            tick();
+            nextTick += std::chrono::duration_cast<Clock::duration>(interval);
+            now = Clock::now();
+            if (nextTick <= now) {
+                // Turns take longer than a tick, so skip ahead instead of
+                // running a burst of catch-up turns
+                lateTicks.fetch_add(1, std::memory_order_relaxed);
+                nextTick = now;
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        auto woken = [this] { return stopping.load() || !commands.empty(); };
+        if (ticking) {
+            wake.wait_until(lock, nextTick, woken);
+        }
+        else {
+            wake.wait(lock, woken);
+        }
+    }
+    running.store(false);
+}
+
+void RealtimeGame::renderLoop() {
+    using Clock = std::chrono::steady_clock;
+    const Clock::duration statusPeriod =
+        std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(statusSeconds));
+
+    Clock::time_point nextStatus = Clock::now() + statusPeriod;
+    int lastTurn = view.read().turn;
+    std::string line;
+    while (true) {
+        while (replies.pop(line)) {
+            report(line);
+        }
+        if (renderStopping.load() && replies.empty()) {
+            break;
+        }
+
+        // Only report progress while turns are actually advancing
+        if (statusSeconds > 0.0 && Clock::now() >= nextStatus) {
+            KingdomSnapshot status = view.read();
+            if (status.turn != lastTurn && !status.gameOver) {
+                std::ostringstream text;
+                renderStatusLine(text, status);
+                report(text.str());
+            }
+            lastTurn = status.turn;
+            nextStatus = Clock::now() + statusPeriod;
+        }
+
+        std::unique_lock<std::mutex> lock(renderMutex);
+        auto woken = [this] { return renderStopping.load() || !replies.empty(); };
+        if (statusSeconds > 0.0) {
+            renderWake.wait_until(lock, nextStatus, woken);
+        }
+        else {
+            renderWake.wait(lock, woken);
+        }
+    }
+}
+
+void RealtimeGame::post(std::string line) {
+    if (!replies.push(line)) {
+        // The render thread is a full queue behind; drop rather than wait on it
+        droppedReplies.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> guard(renderMutex);
+    }
+    renderWake.notify_one();
+}
+
+void RealtimeGame::publishView() {
+    view.write(kingdom->readStatus());
+}
+
+std::string RealtimeGame::runCommand(const std::string& line) {
+    try {
+        std::string_view words[4];
+        size_t wordCount = splitWords(line, words, 4);
+        if (wordCount > 0 && words[0] == "PAUSE") {
+            paused = true;
+            return "OK paused turn=" + std::to_string(kingdom->getCurrentTurn());
+        }
+        if (wordCount > 0 && words[0] == "RESUME") {
+            paused = false;
+            rescheduled = true;
+            return "OK resumed turn=" + std::to_string(kingdom->getCurrentTurn());
+        }
+        if (wordCount > 0 && words[0] == "RATE") {
+            if (wordCount < 2) {
+                throw GameException("Usage: RATE <turns per second>");
+            }
+            ticksPerSecond = checkTickRate(parseArgument<double>(words[1], "tick rate"));
+            rescheduled = true;
+            std::ostringstream reply;
+            reply << "OK rate=" << ticksPerSecond;
+            return reply.str();
+        }
+    }
+    catch (const std::exception& e) {
+        return "ERR " + std::string(e.what());
+    }
+
+    bool quit = false;
+    Kingdom* previous = kingdom.get();
+    SharedStatusExport* statusExport = kingdom->getStatusExport();
+    std::string reply = GameServer::handleCommand(kingdom, line, quit);
+    if (kingdom.get() != previous) {
+        // A new kingdom starts on a fresh tick and keeps the old one's export
+        rescheduled = true;
+        kingdom->setStatusExport(statusExport);
+    }
+    if (quit) {
+        running.store(false);
+    }
+    return reply;
+}
+
+void RealtimeGame::tick() {
+    try {
+        kingdom->processTurn();
+    }
+    catch (const GameException&) {
+        // A failed action ends the turn early, as it does in the interactive
+        // game, before processTurn publishes its snapshot
+        kingdom->publishStatus();
+    }
+    catch (const std::exception& e) {
+        paused = true;
+        post("ERR Turn failed, paused: " + std::string(e.what()));
+        return;
+    }
+
+    ticks.fetch_add(1, std::memory_order_relaxed);
+    publishView();
+    if (kingdom->isGameOver()) {
+        post("GAME OVER turn=" + std::to_string(kingdom->getCurrentTurn()));
+    }
+}
+
+bool RealtimeGame::isRunning() const {
+    return running.load();
+}
+
+KingdomSnapshot RealtimeGame::readStatus() const {
+    return view.read();
+}
+
+long long RealtimeGame::getTicks() const {
+    return ticks.load(std::memory_order_relaxed);
+}
+
+long long RealtimeGame::getLateTicks() const {
+    return lateTicks.load(std::memory_order_relaxed);
+}
+
+long long RealtimeGame::getCommandsHandled() const {
+    return commandsHandled.load(std::memory_order_relaxed);
+}
+
+long long RealtimeGame::getDroppedReplies() const {
+    return droppedReplies.load(std::memory_order_relaxed);
 }
\ No newline at end of file
@@ -1,337 +1,1921 @@
-#ifndef STRONGHOLD_H
-#define STRONGHOLD_H
-
-#include <iostream>
-#include <string>
-#include <vector>
-#include <map>
-#include <memory>
-#include <fstream>
-#include <chrono>
-#include <thread>
-#include <random>
-#include <ctime>
-
-namespace std {
-    // Forward declarations
-    class Kingdom;
-    class Population;
-    class Army;
-    class Bank;
-    class Market;
-    class Politics;
-    class Leader;
-
-    // Exception classes
-    class GameException : public exception {
-    private:
-        string message;
-    public:
-        GameException(const string& msg) : message(msg) {}
-        const char* what() const noexcept override {
-            return message.c_str();
-        }
-    };
-
-    class ResourceException : public GameException {
-    public:
-        ResourceException(const string& msg) : GameException("Resource Error: " + msg) {}
-    };
-
-    class EconomyException : public GameException {
-    public:
-        EconomyException(const string& msg) : GameException("Economy Error: " + msg) {}
-    };
-
-    // Template class for resources
-    template <typename T>
-    class Resource {
-    private:
-        string name;
-        T quantity;
-        T maxQuantity;
-        double price;
-
-    public:
-        Resource() : name(""), quantity(0), maxQuantity(0), price(0.0) {}
-
-        Resource(const string& name, T initialQuantity, T maxQty, double initialPrice)
-            : name(name), quantity(initialQuantity), maxQuantity(maxQty), price(initialPrice) {}
-
-        void setQuantity(T q) {
-            if (q < 0) {
-                throw ResourceException("Cannot set negative quantity for " + name);
-            }
-            if (q > maxQuantity) {
-                throw ResourceException("Exceeds maximum storage capacity for " + name);
-            }
-            quantity = q;
-        }
-
-        T getQuantity() const { return quantity; }
-
-        void addQuantity(T amount) {
-            if (quantity + amount > maxQuantity) {
-                throw ResourceException("Not enough storage for " + name);
-            }
-            quantity += amount;
-        }
-
-        bool consumeQuantity(T amount) {
-            if (quantity < amount) {
-                return false;
-            }
-            quantity -= amount;
-            return true;
-        }
-
-        double getPrice() const { return price; }
-        void setPrice(double newPrice) { price = newPrice; }
-        string getName() const { return name; }
-    };
-
-    // Social class enumeration
-    enum class SocialClass {
-        PEASANT,
-        MERCHANT,
-        NOBILITY,
-        MILITARY
-    };
-
-    // Population class to handle demographics
-    class Population {
-    private:
-        int totalPopulation;
-        map<SocialClass, int> classDemographics;
-        double happiness;
-        int growthRate;
-        int deathRate;
-        bool plagueActive;
-
-    public:
-        Population(int initialPopulation = 1000);
-        void update(bool hasFood, bool hasHealthcare, int jobAvailability);
-        void triggerPlague();
-        void endPlague();
-        bool isUnhappy() const;
-        int getTotalPopulation() const;
-        int getClassPopulation(SocialClass socialClass) const;
-        double getHappiness() const;
-        void adjustHappiness(double amount);
-        void migrate(SocialClass fromClass, SocialClass toClass, int amount);
-    };
-
-    // Base Leader class
-    class Leader {
-    protected:
-        string name;
-        int influence;
-        int corruption;
-        int leadership;
-
-    public:
-        Leader(const string& name, int influence, int corruption, int leadership);
-        virtual ~Leader() = default;
-        virtual void makeDecision(Kingdom& kingdom) = 0;
-        virtual string getTitle() const = 0;
-        string getName() const;
-        int getInfluence() const;
-        int getCorruption() const;
-        int getLeadership() const;
-    };
-
-    // King class derived from Leader
-    class King : public Leader {
-    private:
-        int reignYears;
-        int popularity;
-        string leadershipStyle;
-
-    public:
-        King(const string& name, int influence, int corruption, int leadership,
-            const string& style);
-        void makeDecision(Kingdom& kingdom) override;
-        string getTitle() const override;
-        void setTaxRate(double rate);
-        void declareWar(Kingdom& targetKingdom);
-        bool canBeBribes(int goldAmount) const;
-    };
-
-    // Commander class derived from Leader
-    class Commander : public Leader {
-    private:
-        int battleExperience;
-        int strategySkill;
-        bool loyal;
-
-    public:
-        Commander(const string& name, int influence, int corruption, int leadership,
-            int experience, int strategy, bool loyalty);
-        void makeDecision(Kingdom& kingdom) override;
-        string getTitle() const override;
-        bool isLoyal() const;
-        int getStrategyBonus() const;
-    };
-
-    // MerchantGuildLeader class derived from Leader
-    class MerchantGuildLeader : public Leader {
-    private:
-        double tradingBonus;
-        vector<string> tradeConnections;
-
-    public:
-        MerchantGuildLeader(const string& name, int influence, int corruption, int leadership,
-            double bonus);
-        void makeDecision(Kingdom& kingdom) override;
-        string getTitle() const override;
-        void addTradeConnection(const string& connection);
-        double getTradingBonus() const;
-    };
-
-    // Army class
-    class Army {
-    private:
-        int size;
-        int trainingLevel;
-        int morale;
-        double maintenanceCost;
-        bool isPaid;
-        unique_ptr<Commander> commander;
-
-    public:
-        Army(int initialSize = 0);
-        ~Army();
-        void recruit(int count, int populationSize);
-        void train(int duration);
-        bool battle(Army& enemyArmy);
-        void payMaintenance(double amount);
-        void updateMorale(bool hasFood, bool isPaid);
-        int getSize() const;
-        int getTrainingLevel() const;
-        int getMorale() const;
-        double getMaintenanceCost() const;
-        bool getIsPaid() const;
-        void setCommander(unique_ptr<Commander> newCommander);
-        Commander* getCommander() const;
-    };
-
-    // Bank class
-    class Bank {
-    private:
-        double treasury;
-        double loanAmount;
-        double interestRate;
-        int loanDueTime;
-        int corruptionLevel;
-
-    public:
-        Bank(double initialTreasury = 1000.0);
-        bool withdraw(double amount);
-        void deposit(double amount);
-        double getLoan(double amount, double rate, int dueTime);
-        bool repayLoan(double amount);
-        bool audit();
-        double getTreasury() const;
-        double getLoanAmount() const;
-        double getInterestRate() const;
-        int getLoanDueTime() const;
-        int getCorruptionLevel() const;
-        void setCorruptionLevel(int level);
-    };
-
-    // Market class
-    class Market {
-    private:
-        map<string, double> prices;
-        double inflationRate;
-        int tradingVolume;
-        bool isOpen;
-
-    public:
-        Market();
-        void updatePrices();
-        double buyResource(const string& resourceName, int amount, Bank& bank);
-        double sellResource(const string& resourceName, int amount, Bank& bank);
-        void setInflationRate(double rate);
-        double getResourcePrice(const string& resourceName) const;
-        void open();
-        void close();
-        bool getIsOpen() const;
-    };
-
-    // Politics class
-    class Politics {
-    private:
-        unique_ptr<King> currentKing;
-        int stability;
-        bool civilUnrest;
-        bool atWar;
-        vector<string> allies;
-        vector<string> enemies;
-
-    public:
-        Politics();
-        ~Politics();
-        void electKing(unique_ptr<King> newKing);
-        void coup(unique_ptr<King> usurper);
-        void declareWar(const string& enemyKingdom);
-        void makePeace(const string& kingdom);
-        void formAlliance(const string& kingdom);
-        void breakAlliance(const string& kingdom);
-        int getStability() const;
-        bool hasCivilUnrest() const;
-        bool isAtWar() const;
-        void setCivilUnrest(bool unrest);
-        King* getCurrentKing() const;
-    };
-
-    // Kingdom class - the main game class
-    class Kingdom {
-    private:
-        string name;
-        Population population;
-        unique_ptr<Army> army;
-        unique_ptr<Bank> bank;
-        unique_ptr<Market> market;
-        unique_ptr<Politics> politics;
-        map<string, Resource<int>> resources;
-        bool gameOver;
-        int currentTurn;
-
-        // Helper methods
-        void randomEvent();
-
-    public:
-        Kingdom(const string& name);
-        ~Kingdom();
-
-        void initializeResources();
-        void update();
-        void displayStatus() const;
-        void processTurn();
-        bool isGameOver() const;
-        int getCurrentTurn() const { return currentTurn; }
-
-        // Simplified methods that would handle files in a full implementation
-        void saveGameState(const string& filename) const;
-        void loadGameState(const string& filename);
-        static bool validateSaveFile(const string& filename);
-
-        // Getters
-        string getName() const;
-        Population& getPopulation();
-        Army* getArmy() const;
-        Bank* getBank() const;
-        Market* getMarket() const;
-        Politics* getPolitics() const;
-        Resource<int>* getResource(const string& name);
-
-        // Game actions
-        void collectTaxes(double taxRate);
-        void buildStructure(const string& structureName);
-        void handleWar(Kingdom& enemyKingdom);
-        void manageResources();
-    };
-}  // namespace std
-
+#ifndef STRONGHOLD_H
+#define STRONGHOLD_H
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+#include <new>
+#include <fstream>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <ctime>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory_resource>
+#include <cstdint>
+#include <cstring>
+
+namespace std {
+    // Forward declarations
+    class Kingdom;
+    class Population;
+    class Army;
+    class Bank;
+    class Market;
+    class Politics;
+    class Leader;
+
+    // Counts a GameException for the instrumentation below
+    void countGameException();
+
+    // Exception classes
+    class GameException : public exception {
+    private:
+        string message;
+    public:
+        GameException(const string& msg) : message(msg) { countGameException(); }
+        const char* what() const noexcept override {
+            return message.c_str();
+        }
+    };
+
+    class ResourceException : public GameException {
+    public:
+        ResourceException(const string& msg) : GameException("Resource Error: " + msg) {}
+    };
+
+    class EconomyException : public GameException {
+    public:
+        EconomyException(const string& msg) : GameException("Economy Error: " + msg) {}
+    };
+
+    // A save file that breaks the format, with the line and field at fault
+    // (field 0 when the whole line is wrong)
+    class SaveFormatException : public GameException {
+    private:
+        int line;
+        int field;
+
+    public:
+        SaveFormatException(const string& msg, int line, int field = 0)
+            : GameException("Save Error: line " + to_string(line) +
+                (field > 0 ? ", field " + to_string(field) : string()) + ": " + msg),
+              line(line), field(field) {}
+        int getLine() const { return line; }
+        int getField() const { return field; }
+    };
+
+    // Interned name. Every distinct string is stored once in a process-wide
+    // table and a Name is only its index, so names are copied and compared
+    // as integers and their text is read through a view. Names stay in the
+    // table for good unless they were interned under a NameScope.
+    class Name {
+    private:
+        uint32_t index;
+
+        static uint32_t intern(string_view text);
+
+    public:
+        Name() : index(0) {}
+        Name(string_view text) : index(intern(text)) {}
+        Name(const string& text) : index(intern(text)) {}
+        Name(const char* text) : index(intern(text)) {}
+        const string& str() const;
+        string_view view() const { return str(); }
+        bool empty() const { return index == 0; }
+        uint32_t getIndex() const { return index; }
+        bool operator==(const Name& other) const { return index == other.index; }
+        bool operator!=(const Name& other) const { return index != other.index; }
+        // Looks a name up without adding it to the table
+        static bool find(string_view text, Name& name);
+        static size_t count();                  // names in the table now
+    };
+
+    // Names first interned while a scope is entered on the thread belong to
+    // that scope, and leave the table when every scope holding them has
+    // ended, unless code outside any scope interned them too. The game
+    // server gives each session one, so names chosen by clients go away
+    // with their session, and a session that holds too many names gets
+    // errors without affecting the others. Names of a scope must not be
+    // used once it has ended.
+    class NameScope {
+    private:
+        unordered_set<uint32_t> held;
+        size_t limit;
+
+        friend class Name;
+
+    public:
+        explicit NameScope(size_t limit);
+        NameScope(const NameScope&) = delete;
+        NameScope& operator=(const NameScope&) = delete;
+        ~NameScope();
+        size_t size() const;
+
+        // Enters a scope on this thread until the guard goes out of scope
+        class Guard {
+        private:
+            NameScope* previous;
+
+        public:
+            explicit Guard(NameScope& scope);
+            Guard(const Guard&) = delete;
+            Guard& operator=(const Guard&) = delete;
+            ~Guard();
+        };
+    };
+
+    ostream& operator<<(ostream& out, const Name& name);
+
+    template<> struct hash<Name> {
+        size_t operator()(const Name& name) const noexcept { return name.getIndex(); }
+    };
+
+    // Simulation helpers. Headless mode is tracked per thread so background
+    // simulations run silently and without the interactive pauses.
+    void setHeadless(bool headless);
+    bool isHeadless();
+    ostream& gameOutput();
+    void gameDelay(int seconds);
+    mt19937& gameRandom();
+    void seedGameRandom(unsigned int seed);
+
+    // Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as
+    // 1, 2, 3"). Each block of four numbers is a pure function of a key and
+    // a counter, so any block can be computed directly, on any thread.
+    struct Philox4x32 {
+        using Counter = array<uint32_t, 4>;
+        using Key = array<uint32_t, 2>;
+        static Counter block(Counter counter, Key key);
+    };
+
+    // Kinds of draw a kingdom makes in a turn, each with its own stream
+    enum class RandomSlot : uint32_t {
+        EVENT_CHANCE,
+        EVENT,
+        MARKET,
+        BATTLE
+    };
+
+    // The random numbers of one kingdom, turn and slot, for the standard
+    // distributions. The seed is the key and the kingdom, turn, slot and a
+    // sequence number within the slot make up the counter, so the draws do
+    // not depend on what ran before them or on which thread.
+    class CounterRandom {
+    private:
+        Philox4x32::Counter counter;
+        Philox4x32::Key key;
+        Philox4x32::Counter output;
+        size_t next;
+
+    public:
+        using result_type = uint32_t;
+
+        CounterRandom(uint64_t seed, uint32_t kingdom, uint32_t turn, RandomSlot slot, uint32_t sequence = 0);
+        static constexpr result_type min() { return 0; }
+        static constexpr result_type max() { return UINT32_MAX; }
+
+        result_type operator()() {
+            if (next == output.size()) {
+                output = Philox4x32::block(counter, key);
+                counter[0]++;
+                next = 0;
+            }
+            return output[next++];
+        }
+
+        // Turn single draws into variates. The game uses these rather than
+        // the standard distributions so that RandomBatch, which only makes
+        // the draws, gives the same results.
+        static int toInt(uint32_t draw, int low, int high) {     // low..high inclusive
+            uint64_t range = static_cast<uint64_t>(static_cast<int64_t>(high) - low) + 1;
+            return static_cast<int>(low + static_cast<int64_t>((draw * range) >> 32));
+        }
+        static double toReal(uint32_t draw, double low, double high) {   // low..high, high excluded
+            return low + (high - low) * (draw * (1.0 / 4294967296.0));
+        }
+        int nextInt(int low, int high) { return toInt((*this)(), low, high); }
+        double nextReal(double low, double high) { return toReal((*this)(), low, high); }
+    };
+
+    // The first draws of the streams of many kingdoms at once, for turns of a
+    // whole World: stream i holds exactly what the kingdom's CounterRandom
+    // for the slot and its current turn would give. Eight blocks at a time
+    // are made with AVX2 when the processor has it.
+    class RandomBatch {
+    private:
+        size_t drawsPerStream;
+        vector<uint32_t> draws;         // stream after stream
+        vector<uint32_t> lanes;         // blocks being made, word by word
+
+    public:
+        RandomBatch();
+        void generate(const vector<Kingdom*>& kingdoms, RandomSlot slot, size_t drawsPerStream);
+        const uint32_t* getDraws(size_t stream) const { return draws.data() + stream * drawsPerStream; }
+        static bool usesAvx2();
+    };
+
+    // How Kingdom::update() runs its phases. AUTOMATIC runs them as a task
+    // graph, with independent tasks in parallel, for kingdoms big enough to
+    // gain from it when the WorkerPool has threads to spare, and one after
+    // another otherwise. Both give exactly the same turn.
+    enum class TurnScheduling {
+        AUTOMATIC,
+        SEQUENTIAL,
+        TASK_GRAPH
+    };
+
+    void setTurnScheduling(TurnScheduling scheduling);
+    TurnScheduling getTurnScheduling();
+
+    // Replaces a file by writing a temporary copy, flushing it to disk and
+    // renaming it over the original, so a crash leaves the old or new file
+    // but never a truncated one
+    void writeFileAtomically(const string& filename, string_view data);
+
+    // Number of general-heap allocations made so far. Only counted when the
+    // game is built with STRONGHOLD_COUNT_ALLOCATIONS, otherwise always 0.
+    size_t heapAllocationCount();
+
+    // Stages of Kingdom::update(), used to attribute instrumentation counts
+    enum class TurnPhase {
+        OUTSIDE_TURN,   // menus, commands, loading and anything between turns
+        EVENTS,
+        PRODUCTION,     // construction and buildings
+        EPIDEMIC,
+        POPULATION,     // the capital's people and their food
+        PROVINCES,
+        ARMY,
+        ECONOMY,        // bank and market
+        POLITICS,
+        BOOKKEEPING     // autosave and status publishing after update()
+    };
+
+    const int TURN_PHASE_COUNT = 10;
+
+    const char* getTurnPhaseName(TurnPhase phase);
+
+    // Phase this thread is working on. WorkerPool tasks run in the phase of
+    // the thread that started them.
+    TurnPhase currentTurnPhase();
+    void setTurnPhase(TurnPhase phase);
+
+    // Enters a phase for a scope and goes back to the previous one on exit
+    class TurnPhaseScope {
+    private:
+        TurnPhase previous;
+
+    public:
+        explicit TurnPhaseScope(TurnPhase phase) : previous(currentTurnPhase()) { setTurnPhase(phase); }
+        TurnPhaseScope(const TurnPhaseScope&) = delete;
+        TurnPhaseScope& operator=(const TurnPhaseScope&) = delete;
+        ~TurnPhaseScope() { setTurnPhase(previous); }
+        void enter(TurnPhase phase) { setTurnPhase(phase); }
+    };
+
+    struct PhaseCounters {
+        size_t allocations = 0;
+        size_t bytesAllocated = 0;
+        size_t frees = 0;
+        size_t exceptions = 0;      // GameExceptions constructed
+    };
+
+    // Heap and exception counts by turn phase, for the whole process. Only
+    // gathered when the game is built with STRONGHOLD_COUNT_ALLOCATIONS;
+    // otherwise every count is 0. Kingdoms turning at the same time on other
+    // threads add to the same phases.
+    struct InstrumentationReport {
+        array<PhaseCounters, TURN_PHASE_COUNT> phases{};
+
+        PhaseCounters total() const;
+        InstrumentationReport operator-(const InstrumentationReport& earlier) const;
+    };
+
+    bool isInstrumented();
+    InstrumentationReport readInstrumentation();
+    void renderInstrumentation(ostream& out, const InstrumentationReport& report);
+
+    // Bump allocator for data that only lives for one turn. Memory is taken
+    // from the upstream resource in chunks and handed back wholesale by
+    // reset(); when a turn needed more than one chunk they are merged into a
+    // single larger one, so steady-state turns make no upstream allocations.
+    class TurnArena : public pmr::memory_resource {
+    private:
+        struct Chunk {
+            Chunk* next;
+            size_t size;
+        };
+
+        pmr::memory_resource* upstream;
+        Chunk* chunks;
+        char* cursor;
+        char* limit;
+        size_t chunkSize;
+        size_t bytesUsed;
+        size_t peakBytes;
+        size_t upstreamAllocations;
+
+        void addChunk(size_t minimumBytes);
+        void releaseChunks();
+
+    protected:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const pmr::memory_resource& other) const noexcept override;
+
+    public:
+        explicit TurnArena(size_t initialSize = 16 * 1024, pmr::memory_resource* upstreamResource = pmr::new_delete_resource());
+        TurnArena(const TurnArena&) = delete;
+        TurnArena& operator=(const TurnArena&) = delete;
+        ~TurnArena();
+        void reset();
+        size_t getBytesUsed() const;
+        size_t getPeakBytes() const;
+        size_t getUpstreamAllocations() const;
+    };
+
+    // Fixed-size slots for one object type, handed out through a freelist.
+    // Slots are carved from chunks that are never moved or released, so an
+    // object keeps its address until it is deleted. Each thread keeps a small
+    // cache of free slots and only takes the pool lock to refill or drain it.
+    // The chunk directory grows a page at a time as chunks are added, and
+    // slots are looked up in it without the lock.
+    template<typename T>
+    class ObjectPool {
+    private:
+        struct Slot {
+            alignas(T) unsigned char storage[sizeof(T)];
+            uint32_t index;
+            uint32_t nextFree;
+        };
+
+        static constexpr uint32_t CHUNK_SLOTS = 256;
+        static constexpr uint32_t PAGE_CHUNKS = 256;    // chunk pointers per directory page
+        static constexpr uint32_t MAX_CHUNKS = 65536;
+        static constexpr uint32_t NO_SLOT = 0xFFFFFFFFu;
+        static constexpr uint32_t CACHE_SLOTS = 32;
+
+        struct LocalCache {
+            ObjectPool* owner = nullptr;
+            uint32_t count = 0;
+            uint32_t slots[CACHE_SLOTS];
+            ~LocalCache() {
+                if (owner) owner->release(slots, count);
+            }
+        };
+
+        mutex poolMutex;
+        atomic<atomic<Slot*>*> directory[MAX_CHUNKS / PAGE_CHUNKS];
+        uint32_t chunkCount;
+        uint32_t slotCount;
+        uint32_t freeHead;
+        atomic<size_t> liveObjects;
+
+        Slot* chunkAt(uint32_t chunk) const {
+            atomic<Slot*>* page = directory[chunk / PAGE_CHUNKS].load(memory_order_acquire);
+            return page ? page[chunk % PAGE_CHUNKS].load(memory_order_acquire) : nullptr;
+        }
+
+        Slot* slotAt(uint32_t index) const {
+            return chunkAt(index / CHUNK_SLOTS) + index % CHUNK_SLOTS;
+        }
+
+        static Slot* slotOf(const void* pointer) {
+            return reinterpret_cast<Slot*>(const_cast<void*>(pointer));
+        }
+
+        LocalCache& localCache() {
+            static thread_local LocalCache cache;
+            cache.owner = this;
+            return cache;
+        }
+
+        // Moves up to half a cache worth of free slots into the local cache
+        void refill(LocalCache& cache) {
+            lock_guard<mutex> guard(poolMutex);
+            while (cache.count < CACHE_SLOTS / 2) {
+                if (freeHead != NO_SLOT) {
+                    cache.slots[cache.count++] = freeHead;
+                    freeHead = slotAt(freeHead)->nextFree;
+                    continue;
+                }
+                if (slotCount == chunkCount * CHUNK_SLOTS) {
+                    if (chunkCount == MAX_CHUNKS) {
+                        if (cache.count > 0) return;
+                        throw bad_alloc();
+                    }
+                    atomic<Slot*>* page = directory[chunkCount / PAGE_CHUNKS].load(memory_order_relaxed);
+                    if (!page) {
+                        page = new atomic<Slot*>[PAGE_CHUNKS];
+                        for (uint32_t i = 0; i < PAGE_CHUNKS; i++) {
+                            page[i].store(nullptr, memory_order_relaxed);
+                        }
+                        directory[chunkCount / PAGE_CHUNKS].store(page, memory_order_release);
+                    }
+                    Slot* chunk = static_cast<Slot*>(::operator new(sizeof(Slot) * CHUNK_SLOTS, align_val_t(alignof(Slot))));
+                    for (uint32_t i = 0; i < CHUNK_SLOTS; i++) {
+                        chunk[i].index = chunkCount * CHUNK_SLOTS + i;
+                    }
+                    page[chunkCount % PAGE_CHUNKS].store(chunk, memory_order_release);
+                    chunkCount++;
+                }
+                cache.slots[cache.count++] = slotCount++;
+            }
+        }
+
+        void release(const uint32_t* indices, uint32_t count) {
+            lock_guard<mutex> guard(poolMutex);
+            for (uint32_t i = 0; i < count; i++) {
+                slotAt(indices[i])->nextFree = freeHead;
+                freeHead = indices[i];
+            }
+        }
+
+    public:
+        ObjectPool() : chunkCount(0), slotCount(0), freeHead(NO_SLOT), liveObjects(0) {
+            for (auto& page : directory) {
+                page.store(nullptr, memory_order_relaxed);
+            }
+        }
+        ObjectPool(const ObjectPool&) = delete;
+        ObjectPool& operator=(const ObjectPool&) = delete;
+
+        void* allocate() {
+            LocalCache& cache = localCache();
+            if (cache.count == 0) refill(cache);
+            Slot* slot = slotAt(cache.slots[--cache.count]);
+            liveObjects.fetch_add(1, memory_order_relaxed);
+            return slot->storage;
+        }
+
+        void deallocate(void* pointer) {
+            Slot* slot = slotOf(pointer);
+            liveObjects.fetch_sub(1, memory_order_relaxed);
+            LocalCache& cache = localCache();
+            if (cache.count == CACHE_SLOTS) {
+                cache.count -= CACHE_SLOTS / 2;
+                release(cache.slots + cache.count, CACHE_SLOTS / 2);
+            }
+            cache.slots[cache.count++] = slot->index;
+        }
+
+        size_t getLiveCount() const { return liveObjects.load(memory_order_relaxed); }
+
+        size_t getCapacity() {
+            lock_guard<mutex> guard(poolMutex);
+            return slotCount;
+        }
+
+        // Never destroyed, so objects may still be freed during static teardown
+        static ObjectPool& shared() {
+            static ObjectPool* pool = new ObjectPool();
+            return *pool;
+        }
+    };
+
+    // Base for classes whose heap instances come from their own ObjectPool.
+    // Objects created with new or make_unique reuse freed slots; derived
+    // types of a different size fall back to the general heap.
+    template<typename T>
+    class Pooled {
+    public:
+        static void* operator new(size_t size) {
+            if (size != sizeof(T)) return ::operator new(size);
+            return ObjectPool<T>::shared().allocate();
+        }
+
+        static void operator delete(void* pointer, size_t size) {
+            if (!pointer) return;
+            if (size != sizeof(T)) {
+                ::operator delete(pointer);
+                return;
+            }
+            ObjectPool<T>::shared().deallocate(pointer);
+        }
+
+        static ObjectPool<T>& pool() {
+            return ObjectPool<T>::shared();
+        }
+    };
+
+    // Bounded lock-free queue between exactly one producer thread and one
+    // consumer thread. Each side owns one index and only reads the other's,
+    // keeping a cached copy so most calls touch no shared cache line.
+    template<typename T, size_t Capacity>
+    class SpscQueue {
+        static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+    private:
+        static constexpr size_t CACHE_LINE = 64;
+
+        alignas(CACHE_LINE) atomic<size_t> head{ 0 };   // next slot to read, written by the consumer
+        size_t cachedTail = 0;                          // consumer's last view of tail
+        alignas(CACHE_LINE) atomic<size_t> tail{ 0 };   // next slot to write, written by the producer
+        size_t cachedHead = 0;                          // producer's last view of head
+        alignas(CACHE_LINE) array<T, Capacity> slots;
+
+    public:
+        // Producer side. Returns false and leaves value alone when full.
+        bool push(T& value) {
+            size_t position = tail.load(memory_order_relaxed);
+            if (position - cachedHead == Capacity) {
+                cachedHead = head.load(memory_order_acquire);
+                if (position - cachedHead == Capacity) return false;
+            }
+            slots[position & (Capacity - 1)] = std::move(value);
+            tail.store(position + 1, memory_order_release);
+            return true;
+        }
+
+        // Consumer side. Returns false when empty.
+        bool pop(T& value) {
+            size_t position = head.load(memory_order_relaxed);
+            if (position == cachedTail) {
+                cachedTail = tail.load(memory_order_acquire);
+                if (position == cachedTail) return false;
+            }
+            value = std::move(slots[position & (Capacity - 1)]);
+            head.store(position + 1, memory_order_release);
+            return true;
+        }
+
+        // Safe from either side, though only a hint for the producer
+        bool empty() const {
+            return head.load(memory_order_acquire) == tail.load(memory_order_acquire);
+        }
+    };
+
+    // Sequence lock holding one small trivially copyable value for a single
+    // writer thread and any number of reader threads. The writer never waits;
+    // a reader whose copy overlapped a write simply copies again. The value is
+    // kept in relaxed atomic words so an overlapping copy is not a data race.
+    template<typename T>
+    class Seqlock {
+        static_assert(is_trivially_copyable<T>::value, "Seqlock values are copied word by word");
+
+    private:
+        static constexpr size_t WORD_COUNT = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+        atomic<uint64_t> sequence{ 0 };   // odd while a write is in progress
+        array<atomic<uint64_t>, WORD_COUNT> words;
+
+    public:
+        Seqlock() {
+            for (atomic<uint64_t>& word : words) word.store(0, memory_order_relaxed);
+        }
+
+        Seqlock(const Seqlock&) = delete;
+        Seqlock& operator=(const Seqlock&) = delete;
+
+        void write(const T& value) {
+            uint64_t buffer[WORD_COUNT] = {};
+            memcpy(buffer, &value, sizeof(T));
+            uint64_t start = sequence.load(memory_order_relaxed);
+            sequence.store(start + 1, memory_order_relaxed);
+            atomic_thread_fence(memory_order_release);
+            for (size_t i = 0; i < WORD_COUNT; i++) {
+                words[i].store(buffer[i], memory_order_relaxed);
+            }
+            sequence.store(start + 2, memory_order_release);
+        }
+
+        // One attempt; false if a write was in progress or overlapped the copy
+        bool tryRead(T& value) const {
+            uint64_t buffer[WORD_COUNT];
+            uint64_t before = sequence.load(memory_order_acquire);
+            if (before & 1) return false;
+            for (size_t i = 0; i < WORD_COUNT; i++) {
+                buffer[i] = words[i].load(memory_order_relaxed);
+            }
+            atomic_thread_fence(memory_order_acquire);
+            if (sequence.load(memory_order_relaxed) != before) return false;
+            memcpy(&value, buffer, sizeof(T));
+            return true;
+        }
+
+        T read() const {
+            T value;
+            while (!tryRead(value)) {
+                this_thread::yield();
+            }
+            return value;
+        }
+
+        // Number of completed writes
+        uint64_t getVersion() const {
+            return sequence.load(memory_order_acquire) / 2;
+        }
+    };
+
+    // Persistent worker threads for splitting independent simulation work
+    class WorkerPool {
+    private:
+        vector<thread> workers;
+        mutex dispatchMutex;
+        mutex stateMutex;
+        condition_variable wakeWorkers;
+        condition_variable workDone;
+        const function<void(size_t, size_t)>* task;
+        TurnPhase taskPhase;
+        size_t taskCount;
+        size_t grainSize;
+        atomic<size_t> nextIndex;
+        size_t pendingWorkers;
+        unsigned long generation;
+        bool stopping;
+        exception_ptr failure;
+
+        void workerLoop();
+        void runChunks();
+
+    public:
+        explicit WorkerPool(unsigned int threadCount);
+        ~WorkerPool();
+        void parallelFor(size_t count, size_t grain, const function<void(size_t, size_t)>& body);
+        unsigned int getThreadCount() const;
+        static WorkerPool& shared();
+    };
+
+    // Template class for resources
+    template <typename T>
+    class Resource {
+    private:
+        Name name;
+        T quantity;
+        T maxQuantity;
+        double price;
+
+    public:
+        Resource() : name(""), quantity(0), maxQuantity(0), price(0.0) {}
+
+        Resource(const Name& name, T initialQuantity, T maxQty, double initialPrice)
+            : name(name), quantity(initialQuantity), maxQuantity(maxQty), price(initialPrice) {}
+
+        void setQuantity(T q) {
+            if (q < 0) {
+                throw ResourceException("Cannot set negative quantity for " + name.str());
+            }
+            if (q > maxQuantity) {
+                throw ResourceException("Exceeds maximum storage capacity for " + name.str());
+            }
+            quantity = q;
+        }
+
+        T getQuantity() const { return quantity; }
+        T getMaxQuantity() const { return maxQuantity; }
+
+        void addQuantity(T amount) {
+            if (quantity + amount > maxQuantity) {
+                throw ResourceException("Not enough storage for " + name.str());
+            }
+            quantity += amount;
+        }
+
+        bool consumeQuantity(T amount) {
+            if (quantity < amount) {
+                return false;
+            }
+            quantity -= amount;
+            return true;
+        }
+
+        double getPrice() const { return price; }
+        void setPrice(double newPrice) { price = newPrice; }
+        string_view getName() const { return name.view(); }
+        const Name& getNameHandle() const { return name; }
+    };
+
+    // Social class enumeration
+    enum class SocialClass {
+        PEASANT,
+        MERCHANT,
+        NOBILITY,
+        MILITARY
+    };
+
+    const int SOCIAL_CLASS_COUNT = 4;
+    const int AGE_COHORTS = 8;   // ten-year age bands, the last one open-ended
+
+    // Optional agent-level population: every citizen is simulated individually.
+    // Attributes are kept in parallel arrays so the per-turn kernels stream
+    // through memory and vectorize; aggregates are reduced in parallel chunks.
+    class CitizenAgents {
+    private:
+        struct ChunkTotals {
+            size_t survivors;
+            int births[SOCIAL_CLASS_COUNT];
+            int cohortCounts[SOCIAL_CLASS_COUNT][AGE_COHORTS];
+            int workingAge;
+            double happinessSum;
+        };
+
+        vector<uint32_t> ids;
+        vector<uint8_t> socialClass;
+        vector<uint8_t> employed;
+        vector<uint8_t> fate;
+        vector<float> age;
+        vector<float> happiness;
+        vector<float> health;
+        vector<ChunkTotals> chunkTotals;
+        uint32_t nextId;
+        uint32_t turn;
+
+        array<array<int, AGE_COHORTS>, SOCIAL_CLASS_COUNT> cohortCounts;
+        array<int, SOCIAL_CLASS_COUNT> classCounts;
+        int workingAge;
+        double averageHappiness;
+
+        void addCitizens(int citizenClass, int count, float minAge, float maxAge, float mood);
+        void removeCitizens(int citizenClass, int count);
+        void reduce();
+
+    public:
+        CitizenAgents(const array<array<int, AGE_COHORTS>, SOCIAL_CLASS_COUNT>& cohorts, double happiness);
+        void update(bool hasFood, bool hasHealthcare, int jobAvailability, double diseaseMortality);
+        void adjustHappiness(double amount);
+        void migrate(SocialClass fromClass, SocialClass toClass, int amount);
+        void setClassPopulation(SocialClass socialClass, int count);
+        size_t size() const;
+        int getClassPopulation(SocialClass socialClass) const;
+        int getCohortPopulation(SocialClass socialClass, int cohort) const;
+        double getHappiness() const;
+    };
+
+    // Population class to handle demographics. Every social class is split into
+    // age cohorts that are projected one year per turn with a Leslie-style
+    // matrix; class totals are always the exact sum of their cohorts. With
+    // citizen agents enabled the same figures are reduced from the agents.
+    class Population {
+    private:
+        int totalPopulation;
+        array<int, SOCIAL_CLASS_COUNT> classDemographics;
+        array<array<int, AGE_COHORTS>, SOCIAL_CLASS_COUNT> cohorts;
+        double happiness;
+        bool plagueActive;
+        double diseaseMortality;
+        unique_ptr<CitizenAgents> agents;
+
+        void recountTotals();
+        void syncFromAgents();
+
+    public:
+        Population(int initialPopulation = 1000);
+        void update(bool hasFood, bool hasHealthcare, int jobAvailability);
+        void triggerPlague();
+        void endPlague();
+        bool isPlagueActive() const;
+        void setDiseaseMortality(double rate);
+        bool isUnhappy() const;
+        int getTotalPopulation() const;
+        int getClassPopulation(SocialClass socialClass) const;
+        int getCohortPopulation(SocialClass socialClass, int cohort) const;
+        void setClassPopulation(SocialClass socialClass, int count);
+        double getHappiness() const;
+        void adjustHappiness(double amount);
+        void migrate(SocialClass fromClass, SocialClass toClass, int amount);
+        void enableCitizenAgents();
+        bool hasCitizenAgents() const;
+        const CitizenAgents* getCitizenAgents() const;
+    };
+
+    // Compartmental (SEIR) epidemic over a set of regions. Every region holds
+    // the susceptible, exposed, infected and recovered shares of its people;
+    // infection spreads inside a region and along weighted trade and migration
+    // links, and dies out on its own once too few are left to catch it.
+    class Epidemic {
+    private:
+        struct Link {
+            uint32_t from;
+            uint32_t to;
+            double weight;
+        };
+
+        vector<double> susceptible;
+        vector<double> exposed;
+        vector<double> infected;
+        vector<double> recovered;
+        vector<double> healthcare;
+        vector<double> mortality;
+        vector<double> force;
+
+        // Links are collected as an edge list and packed into compressed rows
+        // the next time the epidemic is stepped
+        vector<Link> links;
+        vector<uint32_t> rowStart;
+        vector<uint32_t> linkTarget;
+        vector<double> linkWeight;
+        vector<double> contactTotal;
+        bool linksChanged;
+        size_t activeRegions;
+
+        void packLinks();
+
+    public:
+        explicit Epidemic(size_t regionCount = 1);
+        size_t addRegion();
+        void addLink(size_t first, size_t second, double weight);
+        void setHealthcare(size_t region, double level);
+        void seed(size_t region, double share);
+        void step();
+        bool isActive() const;
+        size_t getRegionCount() const;
+        double getInfected(size_t region) const;
+        double getMortality(size_t region) const;
+    };
+
+    // Stores kept by a province, indexed by ProvinceStore
+    enum class ProvinceStore {
+        FOOD,
+        WOOD,
+        STONE,
+        IRON
+    };
+
+    const int PROVINCE_STORE_COUNT = 4;
+
+    // A province outside the capital. It has its own people, a compact set of
+    // stores and its own unrest, and advances independently of the others so
+    // the kingdom can update all of its provinces in parallel.
+    class Province {
+    private:
+        Name name;
+        Population population;
+        array<int, PROVINCE_STORE_COUNT> stores;
+        int unrest;
+        bool starving;
+        size_t epidemicRegion;
+
+    public:
+        Province(const Name& name, int initialPopulation, size_t epidemicRegion);
+        void update(double diseaseMortality);
+        string_view getName() const;
+        Population& getPopulation();
+        const Population& getPopulation() const;
+        int getStore(ProvinceStore store) const;
+        void setStore(ProvinceStore store, int amount);
+        int getUnrest() const;
+        void setUnrest(int level);
+        bool isStarving() const;
+        bool isRestless() const;
+        size_t getEpidemicRegion() const;
+    };
+
+    // Kingdom-wide figures reduced from the capital and every province
+    struct RealmTotals {
+        int population;
+        array<int, SOCIAL_CLASS_COUNT> classPopulation;
+        double happiness;
+        int starvingProvinces;
+        int restlessProvinces;
+    };
+
+    // Buildings that can be constructed, indexed by BuildingType
+    enum class BuildingType {
+        FARM,
+        SAWMILL,
+        QUARRY,
+        MINE,
+        SMITHY
+    };
+
+    const int BUILDING_TYPE_COUNT = 5;
+
+    // What a building costs, how many peasants it needs and what it produces.
+    // Buildings with an input consume it to make their output.
+    struct BuildingRecipe {
+        const char* name;
+        int woodCost;
+        int stoneCost;
+        int goldCost;
+        int buildTurns;
+        int workers;
+        const char* input;
+        int inputAmount;
+        const char* output;
+        int outputAmount;
+    };
+
+    const BuildingRecipe& getBuildingRecipe(BuildingType type);
+    bool parseBuildingType(const string& name, BuildingType& type);
+
+    // Every building of a kingdom, one row per building in parallel columns.
+    // Production is computed in one batched pass over the table per turn.
+    class BuildingTable {
+    private:
+        vector<uint8_t> types;
+        vector<uint32_t> locations;   // 0 is the capital, n is the n-th province
+        vector<float> demand;
+        vector<float> staffing;
+
+    public:
+        void add(BuildingType type, uint32_t location);
+        void clear();
+        size_t size() const;
+        int count(BuildingType type) const;
+        BuildingType getType(size_t index) const;
+        uint32_t getLocation(size_t index) const;
+        // Staffed buildings of each type, given the peasants of every location
+        array<double, BUILDING_TYPE_COUNT> staffedCapacity(const int* workforce, size_t locationCount);
+    };
+
+    // Buildings under construction, kept as a min-heap on the turn they are
+    // finished so a turn only touches the jobs that complete in it. Their
+    // wood, stone and gold are paid when the job is queued and stay
+    // reserved, to be refunded if the job is cancelled, until it finishes.
+    class ConstructionQueue {
+    public:
+        struct Job {
+            int completionTurn;
+            uint32_t sequence;
+            uint8_t type;
+            uint32_t location;
+        };
+
+    private:
+        vector<Job> jobs;
+        uint32_t nextSequence;
+        int reservedWood;
+        int reservedStone;
+        int reservedGold;
+
+        void reserve(BuildingType type, int sign);
+
+    public:
+        ConstructionQueue();
+        void enqueue(BuildingType type, uint32_t location, int completionTurn);
+        // Removes the last job queued for this building and location
+        bool cancel(BuildingType type, uint32_t location);
+        // Moves every job finished by the given turn into the table, in the order they finish
+        int completeUntil(int turn, BuildingTable& buildings);
+        void clear();
+        size_t size() const;
+        int pending(BuildingType type) const;
+        int getNextCompletion() const;
+        int getReservedWood() const;
+        int getReservedStone() const;
+        int getReservedGold() const;
+        const vector<Job>& getJobs() const;
+        vector<Job> getJobsInOrder() const;     // by completion turn, then in the order they were queued
+    };
+
+    // Base Leader class
+    class Leader {
+    protected:
+        Name name;
+        int influence;
+        int corruption;
+        int leadership;
+
+    public:
+        Leader(const Name& name, int influence, int corruption, int leadership);
+        virtual ~Leader() = default;
+        virtual void makeDecision(Kingdom& kingdom) = 0;
+        virtual string_view getTitle() const = 0;
+        string_view getName() const;
+        const Name& getNameHandle() const;
+        int getInfluence() const;
+        int getCorruption() const;
+        int getLeadership() const;
+    };
+
+    // Ruler policy genome that a King can execute every turn
+    struct RulerPolicy {
+        enum Gene {
+            LOW_MOOD_TAX,      // tax rate while happiness is below 40%
+            MID_MOOD_TAX,      // tax rate while happiness is between 40% and 70%
+            HIGH_MOOD_TAX,     // tax rate while happiness is above 70%
+            ARMY_SHARE,        // target army size as a share of the population
+            PAY_ARMY,          // pay maintenance each turn when above 0.5
+            FOOD_RESERVE,      // turns of food to keep in stock, buying any shortfall
+            BORROW_BELOW,      // take a loan when the treasury falls below this
+            LOAN_AMOUNT,       // size of each loan
+            REPAY_ABOVE,       // repay the loan with treasury above this
+            AUDIT_AT,          // audit once bank corruption reaches this level
+            GENE_COUNT
+        };
+
+        array<double, GENE_COUNT> genes;
+
+        RulerPolicy();
+        double get(Gene gene) const { return genes[gene]; }
+        void clamp();
+        static double minValue(int gene);
+        static double maxValue(int gene);
+    };
+
+    // King class derived from Leader
+    class King : public Leader, public Pooled<King> {
+    private:
+        int reignYears;
+        int popularity;
+        Name leadershipStyle;
+        bool followsPolicy;
+        RulerPolicy policy;
+
+        void applyPolicy(Kingdom& kingdom);
+
+    public:
+        King(const Name& name, int influence, int corruption, int leadership,
+            const Name& style);
+        void makeDecision(Kingdom& kingdom) override;
+        string_view getTitle() const override;
+        void setTaxRate(double rate);
+        void declareWar(Kingdom& targetKingdom);
+        bool canBeBribes(int goldAmount) const;
+        void setPolicy(const RulerPolicy& newPolicy);
+        const RulerPolicy* getPolicy() const;
+    };
+
+    // Commander class derived from Leader
+    class Commander : public Leader, public Pooled<Commander> {
+    private:
+        int battleExperience;
+        int strategySkill;
+        bool loyal;
+
+    public:
+        Commander(const Name& name, int influence, int corruption, int leadership,
+            int experience, int strategy, bool loyalty);
+        void makeDecision(Kingdom& kingdom) override;
+        string_view getTitle() const override;
+        bool isLoyal() const;
+        int getStrategyBonus() const;
+    };
+
+    // MerchantGuildLeader class derived from Leader
+    class MerchantGuildLeader : public Leader, public Pooled<MerchantGuildLeader> {
+    private:
+        double tradingBonus;
+        vector<Name> tradeConnections;
+
+    public:
+        MerchantGuildLeader(const Name& name, int influence, int corruption, int leadership,
+            double bonus);
+        void makeDecision(Kingdom& kingdom) override;
+        string_view getTitle() const override;
+        void addTradeConnection(const Name& connection);
+        double getTradingBonus() const;
+    };
+
+    // Army class
+    class Army : public Pooled<Army> {
+    private:
+        int size;
+        int trainingLevel;
+        int morale;
+        double maintenanceCost;
+        bool isPaid;
+        unique_ptr<Commander> commander;
+
+    public:
+        Army(int initialSize = 0);
+        ~Army();
+        void recruit(int count, int populationSize);
+        void enlist(int count);     // adds recruits at once, without the training or the checks
+        void train(int duration);
+        bool battle(Army& enemyArmy, CounterRandom& random);
+        void payMaintenance(double amount);
+        void updateMorale(bool hasFood, bool isPaid);
+        int getSize() const;
+        int getTrainingLevel() const;
+        int getMorale() const;
+        double getMaintenanceCost() const;
+        bool getIsPaid() const;
+        void setCommander(unique_ptr<Commander> newCommander);
+        Commander* getCommander() const;
+    };
+
+    // Bank class
+    class Bank : public Pooled<Bank> {
+    private:
+        double treasury;
+        double loanAmount;
+        double interestRate;
+        int loanDueTime;
+        int corruptionLevel;
+
+    public:
+        Bank(double initialTreasury = 1000.0);
+        bool withdraw(double amount);
+        void deposit(double amount);
+        double getLoan(double amount, double rate, int dueTime);
+        bool repayLoan(double amount);
+        bool audit();
+        double getTreasury() const;
+        double getLoanAmount() const;
+        double getInterestRate() const;
+        int getLoanDueTime() const;
+        int getCorruptionLevel() const;
+        void setCorruptionLevel(int level);
+    };
+
+    // Market class
+    class Market {
+    private:
+        map<string, double> prices;
+        double inflationRate;
+        int tradingVolume;
+        bool isOpen;
+
+    public:
+        Market();
+        void updatePrices(CounterRandom& random);
+        void updatePrices(const uint32_t* draws);    // one draw per price, as the random stream gives them
+        size_t getPriceCount() const;
+        double buyResource(const string& resourceName, int amount, Bank& bank);
+        double sellResource(const string& resourceName, int amount, Bank& bank);
+        void setInflationRate(double rate);
+        double getResourcePrice(const string& resourceName) const;
+        void open();
+        void close();
+        bool getIsOpen() const;
+    };
+
+    // Kingdoms are known to diplomacy by a dense interned id
+    using KingdomId = uint32_t;
+
+    enum class Relation {
+        NEUTRAL,
+        ALLY,
+        ENEMY,
+        TRUCE
+    };
+
+    // Relations between every pair of known kingdoms. Each relation is a row
+    // of bits per kingdom, so a query is a single bit test and listing all
+    // enemies of a kingdom scans one row; attitudes are kept only for pairs
+    // that have some history. Relations are always symmetric.
+    class Diplomacy {
+    private:
+        unordered_map<Name, KingdomId> ids;
+        vector<Name> names;
+        size_t wordsPerRow;
+        vector<uint64_t> allyBits;
+        vector<uint64_t> enemyBits;
+        vector<uint64_t> truceBits;
+        unordered_map<uint64_t, int> attitudes;
+
+        void growRows(size_t kingdoms);
+        void setBit(vector<uint64_t>& bits, KingdomId first, KingdomId second, bool value);
+        bool testBit(const vector<uint64_t>& bits, KingdomId first, KingdomId second) const;
+        vector<KingdomId> collect(const vector<uint64_t>& bits, KingdomId kingdom) const;
+        void checkId(KingdomId kingdom) const;
+
+    public:
+        Diplomacy();
+        KingdomId intern(const Name& name);
+        bool find(string_view name, KingdomId& id) const;
+        void rename(KingdomId kingdom, const Name& name);
+        string_view getName(KingdomId kingdom) const;
+        size_t size() const;
+
+        Relation getRelation(KingdomId first, KingdomId second) const;
+        void setRelation(KingdomId first, KingdomId second, Relation relation);
+        vector<KingdomId> alliesOf(KingdomId kingdom) const;
+        vector<KingdomId> enemiesOf(KingdomId kingdom) const;
+        size_t countEnemies(KingdomId kingdom) const;
+
+        int getAttitude(KingdomId first, KingdomId second) const;
+        void adjustAttitude(KingdomId first, KingdomId second, int amount);
+    };
+
+    // Politics class
+    class Politics {
+    private:
+        unique_ptr<King> currentKing;
+        int stability;
+        bool civilUnrest;
+        unique_ptr<Diplomacy> ownDiplomacy;
+        Diplomacy* diplomacy;
+        KingdomId self;
+
+        KingdomId other(const Name& kingdom);
+        vector<string_view> namesOf(const vector<KingdomId>& kingdoms) const;
+
+    public:
+        // Without a shared diplomacy the kingdom keeps its relations to itself
+        Politics(const Name& kingdomName = Name(), Diplomacy* sharedDiplomacy = nullptr);
+        ~Politics();
+        void electKing(unique_ptr<King> newKing);
+        void coup(unique_ptr<King> usurper);
+        void declareWar(const Name& enemyKingdom);
+        void makePeace(string_view kingdom);
+        void formAlliance(const Name& kingdom);
+        void breakAlliance(string_view kingdom);
+        int getStability() const;
+        bool hasCivilUnrest() const;
+        bool isAtWar() const;
+        void setCivilUnrest(bool unrest);
+        King* getCurrentKing() const;
+        KingdomId getKingdomId() const;
+        Diplomacy& getDiplomacy() const;
+        Relation getRelation(string_view kingdom) const;
+        vector<string_view> getAllies() const;
+        vector<string_view> getEnemies() const;
+    };
+
+    // Compressed save container, used for files ending in .savz. The text is
+    // cut into frames at line ends; within a frame every number becomes a
+    // varint delta from the number in the same column of the previous line,
+    // and the result is LZ-compressed. Frames decode independently, so both
+    // directions work as a stream.
+    class SaveCompressor {
+    private:
+        ostream& output;
+        string pending;
+        string transformed;
+        string compressed;
+        vector<uint32_t> matchTable;
+
+        void writeFrame(string_view text);
+
+    public:
+        explicit SaveCompressor(ostream& output);
+        void write(string_view text);
+        void finish();                      // writes the last frame and the end marker
+    };
+
+    class SaveDecompressor {
+    private:
+        istream& input;
+        string compressed;
+        string transformed;
+        bool finished;
+
+    public:
+        explicit SaveDecompressor(istream& input);
+        bool readFrame(string& text);       // appends the next frame, false at the end
+    };
+
+    bool isCompressedSave(const string& filename);
+    string readSaveFile(const string& filename);    // the text of a plain or compressed save
+    // Passes a plain or compressed save to sink piece by piece
+    void readSaveStream(const string& filename, const function<void(string_view)>& sink);
+
+    // Everything a save file holds, before it is applied to a kingdom
+    struct SaveContents {
+        struct ProvinceRecord {
+            string name;
+            array<int, SOCIAL_CLASS_COUNT> classPopulation;
+            double happiness;
+            array<int, PROVINCE_STORE_COUNT> stores;
+            int unrest;
+        };
+        struct BuildingRecord {
+            BuildingType type;
+            uint32_t location;
+        };
+        struct ConstructionRecord {
+            BuildingType type;
+            uint32_t location;
+            int completionTurn;
+        };
+        struct ResourceRecord {
+            string name;
+            int quantity;
+            double price;
+        };
+
+        string kingdomName;
+        int turn = 1;
+        bool gameOver = false;
+        int totalPopulation = 0;
+        double happiness = 0.0;
+        array<int, SOCIAL_CLASS_COUNT> classPopulation{};
+        vector<ProvinceRecord> provinces;
+        vector<BuildingRecord> buildings;
+        vector<ConstructionRecord> construction;
+        vector<ResourceRecord> resources;
+
+        bool hasArmy = false;
+        int armySize = 0;
+        int armyTraining = 0;
+        int armyMorale = 0;
+        double armyMaintenance = 0.0;
+        bool armyPaid = false;
+
+        bool hasBank = false;
+        double treasury = 0.0;
+        double loanAmount = 0.0;
+        double interestRate = 0.0;
+        int loanDueTime = 0;
+        int corruptionLevel = 0;
+
+        bool marketOpen = true;
+        int stability = 0;
+        bool civilUnrest = false;
+        bool atWar = false;
+
+        bool hasKing = false;
+        string kingName;
+        int kingInfluence = 0;
+        int kingCorruption = 0;
+        int kingLeadership = 0;
+    };
+
+    // Single-pass save parser. Text may arrive in pieces of any size; each
+    // line is checked against its section's schema and its numbers converted
+    // as soon as it is complete. All state lives in the parser, so any number
+    // of saves can be parsed at once on different threads.
+    class SaveParser {
+    private:
+        SaveContents& contents;
+        string partialLine;
+        int lineNumber;
+        int section;            // index into the section schema, -1 before the first header
+        int sectionLine;        // data lines seen in the current section
+        uint32_t seenSections;
+
+        void parseLine(string_view line);
+        void parseField(string_view value);
+        void parseRecord(string_view line);
+        void endSection();
+
+    public:
+        explicit SaveParser(SaveContents& contents);
+        void feed(string_view text);
+        void finish();          // throws if the save is incomplete
+    };
+
+    // Writes save files on a background thread. The game thread hands over a
+    // finished snapshot and gets a spare buffer back, so it never waits for
+    // the disk. If the writer falls behind, a snapshot that has not started
+    // writing yet is replaced by the newer one.
+    class SaveWriter {
+    private:
+        thread writer;
+        mutable mutex stateMutex;
+        condition_variable wakeWriter;
+        condition_variable writerIdle;
+        string pendingFile;
+        string pendingData;
+        string writingData;
+        string encodedData;
+        bool hasPending;
+        bool writing;
+        bool stopping;
+        size_t savesWritten;
+        size_t savesReplaced;
+        string lastError;
+
+        void writerLoop();
+
+    public:
+        SaveWriter();
+        SaveWriter(const SaveWriter&) = delete;
+        SaveWriter& operator=(const SaveWriter&) = delete;
+        ~SaveWriter();                                  // finishes the pending save first
+        void submit(const string& filename, string& data);  // swaps data for a spare buffer
+        void flush();                                   // waits until every submitted save is on disk
+        size_t getSavesWritten() const;
+        size_t getSavesReplaced() const;
+        string takeLastError();                         // the last failure, cleared once read
+    };
+
+    // Everything the status screen shows, copied out of a kingdom in one go
+    // so it can be rendered on another thread while the next turn runs.
+    // Names are interned, so the snapshot stays trivially copyable.
+    struct KingdomSnapshot {
+        static constexpr int MAX_RESOURCES = 8;
+
+        struct ResourceLevel {
+            Name name;
+            int quantity = 0;
+        };
+
+        Name kingdomName;
+        int turn = 0;
+        bool gameOver = false;
+
+        RealmTotals totals{};
+        int capitalPopulation = 0;
+        size_t provinceCount = 0;
+        bool plague = false;
+        int plagueInfectedPercent = 0;
+
+        int resourceCount = 0;
+        array<ResourceLevel, MAX_RESOURCES> resources{};
+
+        size_t buildingCount = 0;
+        array<int, BUILDING_TYPE_COUNT> buildings{};
+        size_t underConstruction = 0;
+        int nextCompletion = 0;
+        int reservedWood = 0;
+        int reservedStone = 0;
+        int reservedGold = 0;
+
+        int armySize = 0;
+        int trainingLevel = 0;
+        int morale = 0;
+        double maintenanceCost = 0.0;
+
+        double treasury = 0.0;
+        double loanAmount = 0.0;
+        double interestRate = 0.0;
+        int corruptionLevel = 0;
+
+        bool hasKing = false;
+        Name kingName;
+        int stability = 0;
+        bool atWar = false;
+        bool civilUnrest = false;
+
+        int getResourceQuantity(string_view resourceName) const;   // 0 when not tracked
+    };
+
+    // Full status screen, as shown between turns
+    void renderStatus(ostream& out, const KingdomSnapshot& status);
+    // One-line summary: turn, population, happiness, stores, army and holdings
+    void renderStatusLine(ostream& out, const KingdomSnapshot& status);
+
+    // Layout of the shared-memory status segment that --export publishes and
+    // monitoring tools map read-only. Only fixed-width plain fields, since
+    // other processes read it; any change to SharedStatusRecord or
+    // SharedStatusSegment must bump SHARED_STATUS_VERSION.
+    constexpr uint32_t SHARED_STATUS_VERSION = 1;
+    constexpr char SHARED_STATUS_MAGIC[8] = "SHSTAT";
+
+    struct SharedStatusRecord {
+        static constexpr int NAME_LENGTH = 48;
+        static constexpr int RESOURCE_NAME_LENGTH = 16;
+        static constexpr int MAX_RESOURCES = 8;
+        static constexpr int CLASS_COUNT = 4;
+        static constexpr int BUILDING_TYPES = 5;
+
+        struct ResourceLevel {
+            char name[RESOURCE_NAME_LENGTH];
+            int64_t quantity;
+        };
+
+        int64_t publishedAtNanos;       // system clock, nanoseconds since the epoch
+        int64_t updates;                // records published by this writer
+        int64_t turn;
+        int64_t population;
+        int64_t classPopulation[CLASS_COUNT];
+        int64_t capitalPopulation;
+        int64_t provinces;
+        int64_t starvingProvinces;
+        int64_t restlessProvinces;
+        int64_t plagueInfectedPercent;
+        int64_t buildings[BUILDING_TYPES];
+        int64_t underConstruction;
+        int64_t armySize;
+        int64_t armyTraining;
+        int64_t armyMorale;
+        int64_t corruptionLevel;
+        int64_t stability;
+        int64_t resourceCount;
+        double happiness;
+        double treasury;
+        double loanAmount;
+        double maintenanceCost;
+        uint32_t gameOver;
+        uint32_t atWar;
+        uint32_t civilUnrest;
+        uint32_t plague;
+        char kingdomName[NAME_LENGTH];
+        char kingName[NAME_LENGTH];
+        ResourceLevel resources[MAX_RESOURCES];
+    };
+
+    struct SharedStatusSegment {
+        enum State : uint32_t { STARTING = 0, LIVE = 1, CLOSED = 2 };
+
+        char magic[8];
+        uint32_t layoutVersion;
+        uint32_t recordSize;
+        int64_t writerPid;
+        atomic<uint32_t> state;         // CLOSED once the writer has gone and unlinked the segment
+        Seqlock<SharedStatusRecord> status;
+    };
+
+    static_assert(atomic<uint64_t>::is_always_lock_free && atomic<uint32_t>::is_always_lock_free,
+        "the shared status segment needs address-free atomics");
+
+    // Publishes kingdom status into a POSIX shared-memory segment. Readers
+    // poll it with plain loads, so watching a game costs it nothing beyond
+    // one copy per published snapshot. The segment is created here, failing
+    // if a running game already exports under the name, and is unlinked and
+    // marked closed on destruction.
+    class SharedStatusExport {
+    private:
+        string segmentName;
+        SharedStatusSegment* segment;
+        SharedStatusRecord record;
+
+    public:
+        explicit SharedStatusExport(const string& segmentName);    // e.g. "/stronghold-status"
+        SharedStatusExport(const SharedStatusExport&) = delete;
+        SharedStatusExport& operator=(const SharedStatusExport&) = delete;
+        ~SharedStatusExport();
+        void publish(const KingdomSnapshot& status);
+        const string& getSegmentName() const;
+    };
+
+    // Actions that Kingdom::apply() takes in a batch
+    enum class CommandType : uint8_t {
+        BUY,        // quantity of resource from the market, paid from the treasury
+        SELL,       // quantity of resource to the market
+        RECRUIT,    // quantity soldiers from the peasants
+        TAX,        // taxes collected at rate
+        LOAN,       // amount borrowed at rate, due in term turns
+        BUILD       // a building in province location, 0 being the capital
+    };
+
+    struct Command {
+        CommandType type = CommandType::TAX;
+        Name resource;
+        BuildingType building = BuildingType::FARM;
+        int quantity = 0;
+        double amount = 0.0;
+        double rate = 0.0;
+        int term = 0;
+        size_t location = 0;
+
+        static Command buy(const Name& resource, int quantity);
+        static Command sell(const Name& resource, int quantity);
+        static Command recruit(int soldiers);
+        static Command tax(double rate);
+        static Command loan(double amount, double rate, int term);
+        static Command build(BuildingType building, size_t location = 0);
+    };
+
+    // Why a command was not applied. The checks are those of the matching
+    // single actions, which throw instead.
+    enum class CommandStatus : uint8_t {
+        APPLIED,
+        INVALID_ARGUMENT,       // a non-positive quantity, amount, rate or term, or a tax rate outside [0, 1]
+        UNKNOWN_RESOURCE,
+        NO_SUCH_PROVINCE,
+        MARKET_CLOSED,
+        NOT_ENOUGH_GOLD,
+        NOT_ENOUGH_GOODS,       // to sell, or to build with
+        NOT_ENOUGH_STORAGE,
+        TOO_MANY_RECRUITS,      // more than 20% of the population
+        NOT_ENOUGH_PEASANTS,    // to recruit from
+        LOAN_OUTSTANDING
+    };
+
+    const char* describeCommandStatus(CommandStatus status);
+
+    // What a command did: the gold paid for a purchase, the gold received
+    // for a sale, a loan or taxes, the soldiers recruited or the turn a
+    // building will be finished
+    struct CommandResult {
+        CommandStatus status = CommandStatus::APPLIED;
+        double value = 0.0;
+
+        bool applied() const { return status == CommandStatus::APPLIED; }
+    };
+
+    // Kingdom class - the main game class
+    class Kingdom : public Pooled<Kingdom> {
+    private:
+        Name name;
+        Population population;
+        vector<Province> provinces;
+        BuildingTable buildings;
+        ConstructionQueue construction;
+        Epidemic epidemic;
+        unique_ptr<Army> army;
+        unique_ptr<Bank> bank;
+        unique_ptr<Market> market;
+        unique_ptr<Politics> politics;
+        map<string, Resource<int>> resources;
+        TurnArena turnArena;
+        unique_ptr<SaveWriter> autosaver;
+        string autosaveFile;
+        string autosaveBuffer;
+        int autosaveInterval;
+        bool gameOver;
+        int currentTurn;
+        Seqlock<KingdomSnapshot> publishedStatus;
+        SharedStatusExport* statusExport;
+        InstrumentationReport turnCosts;
+        uint64_t randomSeed;
+        uint32_t battlesThisTurn;
+
+        // What earlier phases of the turn in progress hand on to later ones
+        struct TurnState {
+            int eventChance = 100;
+            bool hasFood = false;
+            bool hasHealthcare = false;
+        };
+        TurnState turnState;
+
+        // Helper methods
+        void randomEvent();
+        void autosave();
+        void rollEvents();
+        void runProduction();
+        void advanceEpidemic();
+        void growPopulation();
+        void consumeFood();
+        void updateProvinces();
+        void updateArmy();
+        void updatePolitics();
+        size_t countTurnTaskItems(size_t task) const;
+        void runTurnTask(size_t task, size_t begin, size_t end);
+        void runTurnGraph();
+        Province& addProvince(const string& provinceName, int initialPopulation);
+        void applySave(const SaveContents& contents);
+
+    public:
+        Kingdom(const Name& name, Diplomacy* diplomacy = nullptr);
+        ~Kingdom();
+
+        void initializeResources();
+        void update();                               // every phase from EVENTS to POLITICS, see TurnScheduling
+        bool usesTurnGraph() const;
+        void updatePhase(TurnPhase phase);           // one of those phases
+        void updateEvents(uint32_t chanceDraw);      // EVENTS, given the turn's first EVENT_CHANCE draw
+        void updateBank();                           // the two halves of ECONOMY, which share nothing
+        void updateMarket();
+        void updateMarket(const uint32_t* draws);    // given the turn's MARKET draws
+        void advanceProvinces(size_t begin, size_t end);   // PROVINCES is these two: the provinces'
+        void reviewProvinces();                      // own updates, then the realm's reaction to them
+        void finishTurn();                           // advances the turn and publishes a new status snapshot
+        void displayStatus() const;
+        void processTurn();                          // update() and finishTurn()
+        bool isGameOver() const;
+        int getCurrentTurn() const { return currentTurn; }
+
+        // Simplified methods that would handle files in a full implementation
+        void saveGameState(const string& filename) const;
+        void loadGameState(const string& filename);
+        static bool validateSaveFile(const string& filename);
+        void writeSaveData(string& buffer) const;    // appends the save file contents
+
+        // Status snapshots. readStatus() may be called from any thread and
+        // never waits for the simulation; the rest belong to the game thread.
+        KingdomSnapshot captureStatus() const;
+        void publishStatus();
+        KingdomSnapshot readStatus() const;
+        uint64_t getStatusVersion() const;
+        void setStatusExport(SharedStatusExport* target);  // also published to, not owned
+        SharedStatusExport* getStatusExport() const;
+
+        // Random draws of the turn are keyed by this seed, taken from
+        // gameRandom() when the kingdom is created, and the kingdom's id
+        void setRandomSeed(uint64_t seed);
+        uint64_t getRandomSeed() const;
+        CounterRandom getRandom(RandomSlot slot, int turn, uint32_t sequence = 0) const;
+
+        // Instrumentation counts of the last completed turn
+        const InstrumentationReport& getTurnCosts() const;
+
+        // Saves in the background every interval turns
+        void enableAutosave(const string& filename, int interval);
+        void disableAutosave();                      // waits for a save in progress
+        const SaveWriter* getAutosaver() const;
+
+        // Getters
+        string_view getName() const;
+        const Name& getNameHandle() const;
+        Population& getPopulation();
+        const Epidemic& getEpidemic() const;
+        TurnArena& getTurnArena();
+        RealmTotals getRealmTotals() const;
+        const BuildingTable& getBuildings() const;
+        const ConstructionQueue& getConstruction() const;
+        size_t getProvinceCount() const;
+        Province& getProvince(size_t index);
+        Province& foundProvince(const string& provinceName, int settlers);
+        Army* getArmy() const;
+        Bank* getBank() const;
+        Market* getMarket() const;
+        Politics* getPolitics() const;
+        Resource<int>* getResource(const string& name);
+
+        // Game actions
+        void collectTaxes(double taxRate);
+        void buildStructure(const string& structureName, size_t location = 0);
+        void buildStructure(BuildingType type, size_t location = 0);
+        void cancelConstruction(const string& structureName, size_t location = 0);  // refunds the reserved costs
+        void cancelConstruction(BuildingType type, size_t location = 0);
+
+        // Runs commands in order, each seeing what the ones before it did,
+        // and writes one result per command instead of throwing. A command
+        // that fails its checks changes nothing and the rest still run.
+        // Returns how many were applied.
+        size_t apply(const Command* commands, size_t count, CommandResult* results);
+        vector<CommandResult> apply(const vector<Command>& commands);
+        void handleWar(Kingdom& enemyKingdom);
+        void manageResources();   // Runs the production of every building
+    };
+
+    // Kingdoms that share one Diplomacy and take their turns together.
+    // Sequential turns run each kingdom's processTurn() in turn. Staged turns
+    // run each phase of update() across every kingdom before starting the
+    // next, so a subsystem's code and data stay in cache from one kingdom to
+    // the next, and the bank and market halves of ECONOMY run in parallel on
+    // the shared WorkerPool. Kingdoms draw their random numbers from
+    // counter-based streams keyed by the world's seed, so both modes play
+    // out exactly the same turns; staged turns make the event rolls and
+    // market shocks of all kingdoms in one RandomBatch.
+    class World {
+    private:
+        Diplomacy diplomacy;
+        vector<unique_ptr<Kingdom>> kingdoms;
+        bool staged;
+        int currentTurn;
+        uint64_t seed;
+        RandomBatch randomDraws;
+        InstrumentationReport turnCosts;
+
+    public:
+        explicit World(bool staged = true);
+        World(const World&) = delete;
+        World& operator=(const World&) = delete;
+
+        Kingdom& addKingdom(const Name& name);       // names must be unique
+        size_t getKingdomCount() const;
+        Kingdom& getKingdom(size_t index);
+        Diplomacy& getDiplomacy();
+        void setSeed(uint64_t seed);                 // the random seed of every kingdom
+        uint64_t getSeed() const;
+        void setStaged(bool staged);
+        bool isStaged() const;
+        int getCurrentTurn() const;
+
+        void processTurn();                          // kingdoms whose game is over sit it out
+        const InstrumentationReport& getTurnCosts() const;   // of the whole last turn
+    };
+
+    // Settings for the ruler policy search
+    struct OptimizerSettings {
+        int populationSize = 32;
+        int generations = 20;          // run by run(), counted from a resumed checkpoint
+        int turnsPerEvaluation = 100;
+        int seedsPerPolicy = 4;
+        int eliteCount = 2;
+        int tournamentSize = 3;
+        double mutationRate = 0.2;
+        double mutationScale = 0.1;
+        unsigned int seed = 1;
+        string checkpointFile;
+    };
+
+    struct ScoredPolicy {
+        RulerPolicy policy;
+        double fitness = 0.0;
+    };
+
+    // Genetic algorithm that searches for ruler policies which keep a kingdom
+    // alive, scoring each candidate in headless simulations run in parallel
+    class PolicyOptimizer {
+    private:
+        OptimizerSettings settings;
+        vector<ScoredPolicy> candidates;
+        mt19937 rng;
+        int generation;
+        int firstGeneration;        // where this run started, after any checkpoint
+        long long simulatedTurns;
+        double simulationSeconds;
+
+        RulerPolicy randomPolicy();
+        RulerPolicy crossover(const RulerPolicy& first, const RulerPolicy& second);
+        void mutate(RulerPolicy& policy);
+        const ScoredPolicy& tournament();
+
+    public:
+        explicit PolicyOptimizer(const OptimizerSettings& settings);
+        void evaluateCandidates();
+        void evolve();
+        void run();
+        int getGeneration() const;
+        const ScoredPolicy& getBest() const;
+        long long getSimulatedTurns() const;
+        double getTurnsPerSecond() const;
+        void saveCheckpoint(const string& filename) const;
+        bool loadCheckpoint(const string& filename);
+
+        // Runs one headless game and returns its fitness
+        static double simulate(const RulerPolicy& policy, unsigned int seed, int turns, int& turnsPlayed);
+    };
+
+    // Settings for hosting many kingdoms in one process
+    struct ServerSettings {
+        string unixPath;            // listen on this Unix socket when set
+        int tcpPort = 7777;         // otherwise listen on 127.0.0.1 at this port
+        size_t maxSessions = 10000;
+        size_t maxLineLength = 4096;
+        size_t maxNamesPerSession = 4096;   // kingdom, ruler, province and other names a session may add
+    };
+
+    // Line-protocol server that hosts one Kingdom per connection. A single
+    // epoll loop does all socket I/O; after each wakeup the commands of every
+    // session with complete lines are run on the shared WorkerPool, one
+    // session per task, so a session's commands execute in order while
+    // different sessions run in parallel.
+    class GameServer {
+    private:
+        struct Session;
+
+        ServerSettings settings;
+        int listenFd;
+        int epollFd;
+        int wakeFd;
+        unordered_map<int, unique_ptr<Session>> sessions;
+        vector<Session*> ready;
+        atomic<bool> stopping;
+        atomic<long long> commandsHandled;
+
+        void openListener();
+        void acceptSessions();
+        void readSession(Session& session);
+        void writeSession(Session& session);
+        void watchSession(Session& session);
+        static void sendOutput(Session& session);
+        void closeSession(Session& session);
+        void runReadySessions();
+        void executeLines(Session& session);
+
+    public:
+        explicit GameServer(const ServerSettings& settings);
+        GameServer(const GameServer&) = delete;
+        GameServer& operator=(const GameServer&) = delete;
+        ~GameServer();
+        void run();                 // serves until stop() is called
+        void stop();                // safe to call from other threads and signal handlers
+        size_t getSessionCount() const;
+        long long getCommandsHandled() const;
+
+        // Executes one protocol line for a session and returns the reply
+        // line. Kingdom-level errors come back as "ERR <message>".
+        static string handleCommand(unique_ptr<Kingdom>& kingdom, string_view line, bool& closeAfterReply);
+    };
+
+    // Runs one kingdom continuously. A simulation thread processes a turn
+    // every tick and, between ticks, executes the command lines other threads
+    // queue with submit(), so whoever reads the player's input never waits
+    // for a turn. Commands are the GameServer protocol plus PAUSE, RESUME
+    // and RATE <ticks per second>.
+    //
+    // All output goes through a render thread: the simulation hands replies
+    // over a lock-free queue and publishes a status snapshot after every turn
+    // and command, and the render thread passes both to the report callback.
+    // A slow terminal therefore never holds up a turn.
+    class RealtimeGame {
+    private:
+        static constexpr size_t QUEUE_CAPACITY = 256;
+
+        unique_ptr<Kingdom> kingdom;
+        function<void(const string&)> report;
+        SpscQueue<string, QUEUE_CAPACITY> commands;
+        SpscQueue<string, QUEUE_CAPACITY> replies;
+        Seqlock<KingdomSnapshot> view;      // outlives kingdoms replaced by NEW
+        thread simulation;
+        thread renderer;
+        mutex wakeMutex;
+        condition_variable wake;
+        mutex renderMutex;
+        condition_variable renderWake;
+        double ticksPerSecond;
+        double statusSeconds;
+        bool paused;
+        bool rescheduled;       // the next tick is one full interval from now
+        atomic<bool> stopping;
+        atomic<bool> renderStopping;
+        atomic<bool> running;
+        atomic<long long> ticks;
+        atomic<long long> lateTicks;
+        atomic<long long> commandsHandled;
+        atomic<long long> droppedReplies;
+
+        void simulationLoop();
+        void renderLoop();
+        string runCommand(const string& line);
+        void tick();
+        void post(string line);
+        void publishView();
+
+    public:
+        // While turns are running, reports a status line every statusSeconds,
+        // or never when 0
+        RealtimeGame(unique_ptr<Kingdom> kingdom, double ticksPerSecond, function<void(const string&)> report, double statusSeconds = 0.0);
+        RealtimeGame(const RealtimeGame&) = delete;
+        RealtimeGame& operator=(const RealtimeGame&) = delete;
+        ~RealtimeGame();
+        void start();
+        bool submit(string line);       // false when the queue is full or the game has stopped
+        unique_ptr<Kingdom> stop();     // runs the queued commands, reports everything, then hands the kingdom back
+        bool isRunning() const;         // false once QUIT has run
+        KingdomSnapshot readStatus() const;
+        long long getTicks() const;
+        long long getLateTicks() const; // ticks started after the next one was already due
+        long long getCommandsHandled() const;
+        long long getDroppedReplies() const;    // replies lost because the render thread fell a full queue behind
+    };
+}  // namespace std
+
 #endif // STRONGHOLD_H
\ No newline at end of file